@@ -0,0 +1,20 @@
+QT       += core gui widgets
+
+CONFIG += c++17
+
+TARGET = InputMonitor
+TEMPLATE = app
+
+SOURCES += \
+    main.cpp \
+    mainwindow.cpp \
+    activitychart.cpp \
+    heatmapview.cpp
+
+HEADERS += \
+    mainwindow.h \
+    activitychart.h \
+    heatmapview.h
+
+# The tracking engine and libevdev
+include(engine/engine.pri)
@@ -1,17 +1,23 @@
-QT       += core gui widgets
+TEMPLATE = subdirs
 
-CONFIG += c++11
+# engine is the Qt-free tracking library. InputMonitor is the GUI and
+# TrackerDaemon the headless collector, both clients of the engine;
+# TrackerBench replays synthetic and recorded event streams through the
+# pipeline without hardware or root. TrackerStat reads the counters a
+# running tracker exports.
+SUBDIRS += \
+    engine \
+    app \
+    daemon \
+    reader \
+    bench
 
-TARGET = InputMonitor
-TEMPLATE = app
+app.file = InputMonitor.pro
+daemon.subdir = daemon
+reader.subdir = reader
+bench.subdir = bench
 
-SOURCES += \
-    main.cpp \
-    mainwindow.cpp
-
-HEADERS += \
-    mainwindow.h
-
-# Link against libevdev
-INCLUDEPATH += /usr/include/libevdev-1.0
-unix:!macx: LIBS += -levdev
+app.depends = engine
+daemon.depends = engine
+reader.depends = engine
+bench.depends = engine
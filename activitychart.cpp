@@ -0,0 +1,155 @@
+#include "activitychart.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QPolygonF>
+#include <QResizeEvent>
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+
+constexpr int COLUMN_WIDTH = 3;
+constexpr double MIN_SCALE = 10.0;
+
+namespace {
+
+const QColor BACKGROUND(0xF5, 0xF5, 0xF5);
+const QColor FILL(0xA9, 0xDF, 0xBF);
+const QColor LINE(0x27, 0xAE, 0x60);
+
+} // namespace
+
+ActivityChart::ActivityChart(QWidget *parent)
+    : QWidget(parent)
+{
+    // Every pixel comes from the buffer, so Qt need not clear the exposed
+    // strip first; this is what lets scroll() reuse the old pixels.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumHeight(60);
+}
+
+int ActivityChart::visibleColumns() const
+{
+    return width() / COLUMN_WIDTH + 1;
+}
+
+// 1, 2 or 5 times a power of ten, at least `value`
+double ActivityChart::niceScale(double value) const
+{
+    if (value <= MIN_SCALE) {
+        return MIN_SCALE;
+    }
+    double magnitude = std::pow(10.0, std::floor(std::log10(value)));
+    for (double step : {1.0, 2.0, 5.0, 10.0}) {
+        if (value <= step * magnitude) {
+            return step * magnitude;
+        }
+    }
+    return 10.0 * magnitude;
+}
+
+void ActivityChart::appendSample(double value)
+{
+    samples.push_back(value);
+    while (samples.size() > static_cast<std::size_t>(visibleColumns())) {
+        samples.pop_front();
+    }
+    if (buffer.isNull()) {
+        return;
+    }
+
+    // Grow as soon as a sample would be clipped; shrink once the visible
+    // peak has fallen well below the scale
+    double peak = *std::max_element(samples.begin(), samples.end());
+    if (value > scaleMax || (scaleMax > MIN_SCALE && peak < scaleMax / 4)) {
+        scaleMax = niceScale(peak);
+        redrawAll();
+        update();
+        return;
+    }
+
+    // QPixmap::scroll() moves device pixels; at a fractional ratio a column
+    // is no whole number of them, so redraw instead
+    const qreal columnPixels = COLUMN_WIDTH * buffer.devicePixelRatioF();
+    if (columnPixels != std::floor(columnPixels)) {
+        redrawAll();
+        update();
+        return;
+    }
+    buffer.scroll(-static_cast<int>(columnPixels), 0, buffer.rect());
+    {
+        QPainter painter(&buffer);
+        double previous = samples.size() >= 2 ? samples[samples.size() - 2] : 0.0;
+        drawColumn(painter, width() - COLUMN_WIDTH, previous, value);
+    }
+    // Moves the on-screen pixels and repaints only the exposed column
+    scroll(-COLUMN_WIDTH, 0);
+}
+
+void ActivityChart::clear()
+{
+    samples.clear();
+    scaleMax = MIN_SCALE;
+    redrawAll();
+    update();
+}
+
+void ActivityChart::drawColumn(QPainter &painter, int x, double previous, double value)
+{
+    const int h = height();
+    auto y = [this, h](double v) { return h - 1 - std::min(v, scaleMax) / scaleMax * (h - 2); };
+
+    painter.setClipRect(x, 0, COLUMN_WIDTH, h);
+    painter.fillRect(x, 0, COLUMN_WIDTH, h, BACKGROUND);
+
+    QPolygonF area;
+    area << QPointF(x, y(previous)) << QPointF(x + COLUMN_WIDTH, y(value))
+         << QPointF(x + COLUMN_WIDTH, h) << QPointF(x, h);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(FILL);
+    painter.drawPolygon(area);
+
+    painter.setPen(QPen(LINE, 1));
+    painter.drawLine(QPointF(x, y(previous)), QPointF(x + COLUMN_WIDTH, y(value)));
+}
+
+void ActivityChart::redrawAll()
+{
+    if (buffer.isNull()) {
+        return;
+    }
+    buffer.fill(BACKGROUND);
+    QPainter painter(&buffer);
+    const int n = static_cast<int>(samples.size());
+    for (int i = 1; i < n; ++i) {
+        drawColumn(painter, width() - (n - i) * COLUMN_WIDTH, samples[i - 1], samples[i]);
+    }
+}
+
+// In device pixels; painting on it still uses widget coordinates
+void ActivityChart::allocateBuffer()
+{
+    const qreal ratio = devicePixelRatioF();
+    buffer = QPixmap(size() * ratio);
+    buffer.setDevicePixelRatio(ratio);
+    redrawAll();
+}
+
+void ActivityChart::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    allocateBuffer();
+}
+
+void ActivityChart::paintEvent(QPaintEvent *event)
+{
+    // Moved to a screen with another ratio
+    if (buffer.devicePixelRatioF() != devicePixelRatioF()) {
+        allocateBuffer();
+    }
+    const qreal ratio = buffer.devicePixelRatioF();
+    const QRect target = event->rect();
+    const QRectF source(QPointF(target.topLeft()) * ratio, QSizeF(target.size()) * ratio);
+    QPainter painter(this);
+    painter.drawPixmap(QRectF(target), buffer, source);
+}
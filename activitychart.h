@@ -0,0 +1,44 @@
+#ifndef ACTIVITYCHART_H
+#define ACTIVITYCHART_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <deque>
+
+// Scrolling sparkline of events per second. The chart is kept in an
+// off-screen pixmap; appending a sample scrolls the pixmap and the widget
+// by one column and paints only that column, so the window system moves
+// the old pixels and Qt repaints a few pixels wide strip. Everything is
+// redrawn only when the scale changes or the widget is resized. The pixmap
+// is kept at the screen's device pixel ratio so HiDPI screens get a sharp
+// chart.
+class ActivityChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ActivityChart(QWidget *parent = nullptr);
+
+    void appendSample(double value);
+    void clear();
+
+    // Value at the top edge
+    double scale() const { return scaleMax; }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    int visibleColumns() const;
+    void allocateBuffer();
+    double niceScale(double value) const;
+    void redrawAll();
+    void drawColumn(QPainter &painter, int x, double previous, double value);
+
+    QPixmap buffer;
+    std::deque<double> samples;   // newest last, one per visible column
+    double scaleMax = 10.0;
+};
+
+#endif // ACTIVITYCHART_H
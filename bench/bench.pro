@@ -0,0 +1,21 @@
+CONFIG += c++17 console
+CONFIG -= qt app_bundle
+
+TARGET = TrackerBench
+TEMPLATE = app
+
+SOURCES += \
+    main.cpp \
+    benchutil.cpp \
+    dispatchbench.cpp \
+    exportbench.cpp \
+    logbench.cpp \
+    maskbench.cpp \
+    pipelinebench.cpp \
+    rollupbench.cpp
+
+HEADERS += \
+    benchutil.h
+
+# The tracking engine and libevdev (uinput benchmark)
+include(../engine/engine.pri)
@@ -0,0 +1,132 @@
+#include "benchutil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+} // namespace
+
+// Counting allocator for the "allocations per event" figures
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+uint64_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+namespace {
+
+input_event makeEvent(uint16_t type, uint16_t code, int32_t value, uint64_t timeUs)
+{
+    input_event ev{};
+    ev.input_event_sec = static_cast<decltype(ev.input_event_sec)>(timeUs / 1000000);
+    ev.input_event_usec = static_cast<decltype(ev.input_event_usec)>(timeUs % 1000000);
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    return ev;
+}
+
+} // namespace
+
+std::vector<input_event> makeMouseStream(std::size_t frames)
+{
+    std::vector<input_event> events;
+    events.reserve(frames * 4);
+    uint64_t timeUs = 0;
+    for (std::size_t i = 0; i < frames; ++i, timeUs += 125) {   // 8 kHz polling
+        events.push_back(makeEvent(EV_REL, REL_X, static_cast<int>(i % 7) - 3, timeUs));
+        events.push_back(makeEvent(EV_REL, REL_Y, static_cast<int>(i % 5) - 2, timeUs));
+        if (i % 500 == 0) {
+            events.push_back(makeEvent(EV_KEY, BTN_LEFT, (i / 500) % 2 == 0 ? 1 : 0, timeUs));
+        } else if (i % 97 == 0) {
+            events.push_back(makeEvent(EV_REL, REL_WHEEL, 1, timeUs));
+        }
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0, timeUs));
+    }
+    return events;
+}
+
+std::vector<input_event> makeKeyboardStream(std::size_t presses)
+{
+    static const uint16_t keys[] = {KEY_T, KEY_H, KEY_E, KEY_SPACE, KEY_Q, KEY_U, KEY_I, KEY_C, KEY_K, KEY_ENTER};
+    std::vector<input_event> events;
+    events.reserve(presses * 7);
+    uint64_t timeUs = 0;
+    for (std::size_t i = 0; i < presses; ++i, timeUs += 80000) {
+        uint16_t key = keys[i % (sizeof(keys) / sizeof(keys[0]))];
+        events.push_back(makeEvent(EV_MSC, MSC_SCAN, 0x70000 + key, timeUs));
+        events.push_back(makeEvent(EV_KEY, key, 1, timeUs));
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0, timeUs));
+        if (i % 50 == 0) {
+            events.push_back(makeEvent(EV_KEY, key, 2, timeUs + 30000));
+            events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0, timeUs + 30000));
+        }
+        events.push_back(makeEvent(EV_KEY, key, 0, timeUs + 40000));
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0, timeUs + 40000));
+    }
+    return events;
+}
+
+LatencySummary summarize(std::vector<double>& samples)
+{
+    LatencySummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q) {
+        std::size_t index = static_cast<std::size_t>(q * (samples.size() - 1));
+        return samples[index];
+    };
+    summary.p50 = at(0.50);
+    summary.p90 = at(0.90);
+    summary.p99 = at(0.99);
+    summary.p999 = at(0.999);
+    summary.max = samples.back();
+    return summary;
+}
+
+void printLatency(const char* label, const LatencySummary& summary, const char* unit)
+{
+    std::printf("  %-26s p50 %8.2f  p90 %8.2f  p99 %8.2f  p99.9 %8.2f  max %9.2f %s\n", label,
+                summary.p50, summary.p90, summary.p99, summary.p999, summary.max, unit);
+}
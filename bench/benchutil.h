@@ -0,0 +1,30 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <linux/input.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Heap allocations made by this process so far (operator new is counted)
+uint64_t allocationCount();
+
+// A high-rate mouse: motion on every frame, occasional clicks and wheel ticks
+std::vector<input_event> makeMouseStream(std::size_t frames);
+// A keyboard: press, autorepeat now and then, release
+std::vector<input_event> makeKeyboardStream(std::size_t presses);
+
+struct LatencySummary {
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+};
+
+// Sorts `samples` in place
+LatencySummary summarize(std::vector<double>& samples);
+
+void printLatency(const char* label, const LatencySummary& summary, const char* unit);
+
+#endif // BENCHUTIL_H
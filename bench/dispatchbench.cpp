@@ -0,0 +1,460 @@
+// Table dispatch against the branch cascade it replaced, and the new device
+// classes on synthetic streams.
+//
+//   dispatch [frames]  keyboard and mouse through both, then a touchpad, a
+//                      tablet and a gamepad through EventProcessor
+//
+// The cascade is the per-event type/code test sequence EventProcessor used
+// for keyboards and mice before the dispatch tables, kept here verbatim as
+// a reference. Both run without typing, heatmap, rate or latency slots so
+// mostly dispatch and counting are timed; each is run several times and the
+// best time is reported. Counters must agree exactly, the keyboard and mouse
+// switches must match their tables for every type and code, and the
+// synthetic streams of the new classes must produce the counts they were
+// built with, or the benchmark fails.
+
+#include "benchutil.h"
+#include "eventdispatch.h"
+#include "eventjournal.h"
+#include "eventprocessor.h"
+#include "heatmap.h"
+#include "activityrates.h"
+#include "latencyhistogram.h"
+#include "logger.h"
+#include "statistics.h"
+#include "typingstats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <time.h>
+
+namespace {
+
+constexpr int RUNS = 5;
+
+// EventProcessor::process() for keyboards and mice as it was before the
+// dispatch tables, with the same optional consumers (left unset here)
+class CascadeProcessor
+{
+public:
+    CascadeProcessor(DeviceType type, StatsSlot* slot) : deviceType(type), slot(slot), deviceName("cascade") {}
+
+    void process(const input_event* events, std::size_t count) {
+        if (journal) {
+            journal->append(journalDevice, events, count);
+        }
+
+        const char* name = deviceName.c_str();
+        const bool isMouse = deviceType == DeviceType::Mouse;
+        const int64_t second = currentSecond();
+        int64_t nowUs = 0;
+        if (latency) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            nowUs = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const input_event& ev = events[i];
+
+            if (dropping) {
+                if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+                    dropping = false;
+                    resyncPending = true;
+                }
+                continue;
+            }
+
+            switch (ev.type) {
+            case EV_KEY:
+                if (ev.value == 1 && countsAsPress(ev.code)) {
+                    if (isMouse) {
+                        pending.mouse_count++;
+                        if (heatmap) {
+                            heatmap->click();
+                        }
+                        Logger::log(LogLevel::Debug, "[mouse] Button click detected on", name);
+                    } else {
+                        pending.keyboard_count++;
+                        if (typing) {
+                            typing->recordPress(ev.code, ev.input_event_sec * 1000000LL + ev.input_event_usec,
+                                                second);
+                        }
+                        Logger::log(LogLevel::Debug, "[keyboard] Key press detected on", name);
+                    }
+                }
+                if (ev.value != 2) {
+                    setKeyDown(ev.code, ev.value != 0);
+                }
+                break;
+            case EV_REL:
+                if (!isMouse) {
+                    break;
+                }
+                if (ev.code == REL_X) {
+                    frame_dx += ev.value;
+                    Logger::trace("[mouse] Movement X detected on", name, ev.value);
+                } else if (ev.code == REL_Y) {
+                    frame_dy += ev.value;
+                    Logger::trace("[mouse] Movement Y detected on", name, ev.value);
+                } else if ((ev.code == REL_WHEEL || ev.code == REL_HWHEEL) && countScroll) {
+                    pending.scroll_count += std::abs(ev.value);
+                    Logger::log(LogLevel::Debug, "[mouse] Scroll detected on", name, ev.value);
+                }
+                break;
+            case EV_SYN:
+                if (ev.code == SYN_REPORT) {
+                    endFrame();
+                    if (latency) {
+                        int64_t waited = nowUs - (ev.input_event_sec * 1000000LL + ev.input_event_usec);
+                        latency->record(waited > 0 ? static_cast<uint64_t>(waited) : 0);
+                    }
+                } else if (ev.code == SYN_DROPPED) {
+                    Logger::log(LogLevel::Info, "[engine] Events dropped by the kernel, resyncing", name);
+                    frame_dx = frame_dy = 0;
+                    dropping = true;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        pending.event_count += count;
+        if (heatmap) {
+            heatmap->flush();
+        }
+        if (rates) {
+            rates->publish(pending, second);
+        }
+        slot->publish(pending, second);
+        pending = StatsSnapshot();
+        for (std::size_t i = 0; i < changedCount; ++i) {
+            changed[i]->raise();
+        }
+    }
+
+private:
+    bool countsAsPress(uint16_t code) const {
+        if (deviceType == DeviceType::Keyboard) {
+            return countKeys;
+        }
+        return countClicks && (code == BTN_LEFT || code == BTN_RIGHT || code == BTN_MIDDLE);
+    }
+    void endFrame() {
+        if ((frame_dx != 0 || frame_dy != 0) && countMovement) {
+            double dx = frame_dx;
+            double dy = frame_dy;
+            pending.mouse_distance += std::sqrt(dx * dx + dy * dy);
+            if (heatmap) {
+                heatmap->move(frame_dx, frame_dy);
+            }
+        }
+        frame_dx = frame_dy = 0;
+    }
+    void setKeyDown(uint16_t code, bool down) {
+        if (code >= KEY_CNT) {
+            return;
+        }
+        if (down) {
+            keyState[code / 8] |= static_cast<uint8_t>(1u << (code % 8));
+        } else {
+            keyState[code / 8] &= static_cast<uint8_t>(~(1u << (code % 8)));
+        }
+    }
+
+    DeviceType deviceType;
+    StatsSlot* slot;
+    std::string deviceName;
+    EventJournal* journal = nullptr;
+    uint16_t journalDevice = 0;
+    TypingSlot* typing = nullptr;
+    HeatmapSlot* heatmap = nullptr;
+    RateSlot* rates = nullptr;
+    LatencyHistogram* latency = nullptr;
+    ChangeSignal* changed[MAX_CHANGE_SIGNALS] = {};
+    std::size_t changedCount = 0;
+    bool countKeys = true;
+    bool countClicks = true;
+    bool countScroll = true;
+    bool countMovement = true;
+    StatsSnapshot pending;
+    int frame_dx = 0;
+    int frame_dy = 0;
+    bool dropping = false;
+    bool resyncPending = false;
+    uint8_t keyState[KEY_STATE_BYTES] = {};
+};
+
+input_event makeEvent(uint16_t type, uint16_t code, int32_t value)
+{
+    input_event ev{};
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    return ev;
+}
+
+struct Synthetic {
+    std::vector<input_event> events;
+    StatsSnapshot expected;     // event_count is filled in from the size
+};
+
+// One finger gliding, a click now and then, and every fourth gesture a
+// two-finger scroll of exactly `steps` wheel steps at the default resolution
+Synthetic makeTouchpadStream(std::size_t frames)
+{
+    Synthetic stream;
+    auto& events = stream.events;
+    const int step = TOUCHPAD_SCROLL_STEP_MM * TOUCHPAD_DEFAULT_RESOLUTION;
+    int id = 0;
+    for (std::size_t done = 0, gesture = 0; done < frames; ++gesture) {
+        const bool scroll = gesture % 4 == 3;
+        const int fingers = scroll ? 2 : 1;
+        for (int slot = 0; slot < fingers; ++slot) {
+            events.push_back(makeEvent(EV_ABS, ABS_MT_SLOT, slot));
+            events.push_back(makeEvent(EV_ABS, ABS_MT_TRACKING_ID, id++));
+            events.push_back(makeEvent(EV_ABS, ABS_MT_POSITION_X, 1000 + 300 * slot));
+            events.push_back(makeEvent(EV_ABS, ABS_MT_POSITION_Y, 2000));
+        }
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+        ++done;
+
+        // 3 units a frame, so a scroll gesture of 4 steps is 4 * step / 3 frames
+        const int moves = scroll ? 4 * step / 3 : 200;
+        for (int i = 1; i <= moves; ++i, ++done) {
+            for (int slot = 0; slot < fingers; ++slot) {
+                events.push_back(makeEvent(EV_ABS, ABS_MT_SLOT, slot));
+                if (scroll) {
+                    events.push_back(makeEvent(EV_ABS, ABS_MT_POSITION_Y, 2000 - 3 * i));
+                } else {
+                    events.push_back(makeEvent(EV_ABS, ABS_MT_POSITION_X, 1000 + 3 * i));
+                    events.push_back(makeEvent(EV_ABS, ABS_MT_POSITION_Y, 2000 + 4 * i));
+                }
+            }
+            events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+        }
+        if (scroll) {
+            stream.expected.scroll_count += 4;
+        } else {
+            stream.expected.mouse_distance += 5.0 * moves;
+        }
+
+        if (gesture % 8 == 0) {
+            events.push_back(makeEvent(EV_KEY, BTN_LEFT, 1));
+            events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+            events.push_back(makeEvent(EV_KEY, BTN_LEFT, 0));
+            events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+            stream.expected.mouse_count++;
+            done += 2;
+        }
+        for (int slot = 0; slot < fingers; ++slot) {
+            events.push_back(makeEvent(EV_ABS, ABS_MT_SLOT, slot));
+            events.push_back(makeEvent(EV_ABS, ABS_MT_TRACKING_ID, -1));
+        }
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+        ++done;
+    }
+    return stream;
+}
+
+// Strokes of 100 reports each with pressure and tilt, a barrel button click
+// every tenth stroke
+Synthetic makeTabletStream(std::size_t frames)
+{
+    Synthetic stream;
+    auto& events = stream.events;
+    for (std::size_t done = 0, stroke = 0; done < frames; ++stroke) {
+        events.push_back(makeEvent(EV_KEY, BTN_TOOL_PEN, 1));
+        events.push_back(makeEvent(EV_KEY, BTN_TOUCH, 1));
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+        for (int i = 0; i < 100; ++i) {
+            events.push_back(makeEvent(EV_ABS, ABS_X, 5000 + 10 * i));
+            events.push_back(makeEvent(EV_ABS, ABS_Y, 3000 + 7 * i));
+            events.push_back(makeEvent(EV_ABS, ABS_PRESSURE, 400 + i));
+            events.push_back(makeEvent(EV_ABS, ABS_TILT_X, i % 20));
+            events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+        }
+        if (stroke % 10 == 0) {
+            events.push_back(makeEvent(EV_KEY, BTN_STYLUS, 1));
+            events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+            events.push_back(makeEvent(EV_KEY, BTN_STYLUS, 0));
+            stream.expected.mouse_count++;
+        }
+        events.push_back(makeEvent(EV_KEY, BTN_TOUCH, 0));
+        events.push_back(makeEvent(EV_KEY, BTN_TOOL_PEN, 0));
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+        stream.expected.stroke_count++;
+        done += 103;
+    }
+    return stream;
+}
+
+// Sticks and triggers moving on three reports out of four, buttons and the
+// d-pad hat pressed now and then
+Synthetic makeGamepadStream(std::size_t frames)
+{
+    Synthetic stream;
+    auto& events = stream.events;
+    static const uint16_t buttons[] = {BTN_SOUTH, BTN_EAST, BTN_NORTH, BTN_WEST, BTN_TL, BTN_TR, BTN_START};
+    for (std::size_t i = 0; i < frames; ++i) {
+        if (i % 4 != 3) {
+            events.push_back(makeEvent(EV_ABS, ABS_X, static_cast<int>(i % 512) - 256));
+            events.push_back(makeEvent(EV_ABS, ABS_RY, static_cast<int>(i % 300)));
+            if (i % 8 == 0) {
+                events.push_back(makeEvent(EV_ABS, ABS_RZ, static_cast<int>(i % 256)));
+            }
+            stream.expected.axis_count++;
+        }
+        if (i % 40 == 0) {
+            uint16_t button = buttons[(i / 40) % (sizeof(buttons) / sizeof(buttons[0]))];
+            bool down = (i / 40) % 2 == 0;
+            events.push_back(makeEvent(EV_KEY, button, down ? 1 : 0));
+            if (down) {
+                stream.expected.gamepad_count++;
+            }
+        }
+        if (i % 100 == 50) {
+            // Left, then straight over to right: two presses; then centred
+            int phase = static_cast<int>((i / 100) % 3);
+            events.push_back(makeEvent(EV_ABS, ABS_HAT0X, phase == 0 ? -1 : phase == 1 ? 1 : 0));
+            if (phase != 2) {
+                stream.expected.gamepad_count++;
+            }
+        }
+        if (events.empty() || events.back().type == EV_SYN) {
+            continue;   // idle, the pad sends nothing
+        }
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+    }
+    return stream;
+}
+
+template <class Processor>
+double bestNsPerEvent(const std::vector<input_event>& stream, DeviceType type, StatsSnapshot& counts)
+{
+    double best = 0.0;
+    for (int run = 0; run < RUNS; ++run) {
+        StatsCore stats;
+        Processor processor(type, stats.acquireSlot());
+        auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < stream.size(); i += EVENT_BATCH_SIZE) {
+            processor.process(stream.data() + i, std::min(EVENT_BATCH_SIZE, stream.size() - i));
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        if (run == 0 || ns < best) {
+            best = ns;
+        }
+        counts = stats.snapshot();
+    }
+    return best / stream.size();
+}
+
+// EventProcessor with the constructor shape the template expects
+class TableProcessor : public EventProcessor
+{
+public:
+    TableProcessor(DeviceType type, StatsSlot* slot) : EventProcessor(type, slot, "table") {}
+};
+
+bool sameCounts(const StatsSnapshot& a, const StatsSnapshot& b)
+{
+    return a.keyboard_count == b.keyboard_count && a.mouse_count == b.mouse_count &&
+           a.scroll_count == b.scroll_count && a.stroke_count == b.stroke_count &&
+           a.gamepad_count == b.gamepad_count && a.axis_count == b.axis_count && a.event_count == b.event_count &&
+           std::fabs(a.mouse_distance - b.mouse_distance) <= 1e-9 * std::max(1.0, b.mouse_distance);
+}
+
+void printCounts(const StatsSnapshot& counts)
+{
+    std::printf("    keys %llu  clicks %llu  scroll %llu  strokes %llu  gamepad %llu  axes %llu  distance %.0f  "
+                "events %llu\n",
+                static_cast<unsigned long long>(counts.keyboard_count),
+                static_cast<unsigned long long>(counts.mouse_count),
+                static_cast<unsigned long long>(counts.scroll_count),
+                static_cast<unsigned long long>(counts.stroke_count),
+                static_cast<unsigned long long>(counts.gamepad_count),
+                static_cast<unsigned long long>(counts.axis_count), counts.mouse_distance,
+                static_cast<unsigned long long>(counts.event_count));
+}
+
+// The direct switch must mean what the table says, or the kernel mask would
+// drop events it counts
+template <DeviceType Type>
+bool directMatchesTable()
+{
+    for (uint16_t type = 0; type <= EV_MAX; ++type) {
+        for (uint16_t code = 0; code < DISPATCH_ROW + 64; ++code) {
+            if (directAction<Type>(type, code) != DISPATCH_TABLE<Type>.lookup(type, code)) {
+                std::printf("  %s: direct switch and table differ at type %u code %u\n", deviceTypeName(Type),
+                            type, code);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int runDispatchBenchmark(int argc, char* argv[])
+{
+    std::size_t frames = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 2000000;
+    int failures = 0;
+    failures += !directMatchesTable<DeviceType::Keyboard>();
+    failures += !directMatchesTable<DeviceType::Mouse>();
+
+    struct Classic {
+        const char* name;
+        DeviceType type;
+        std::vector<input_event> events;
+    };
+    const Classic classics[] = {
+        {"mouse", DeviceType::Mouse, makeMouseStream(frames)},
+        {"keyboard", DeviceType::Keyboard, makeKeyboardStream(frames / 4)},
+    };
+    std::printf("best of %d runs, ns per event\n", RUNS);
+    for (const Classic& stream : classics) {
+        StatsSnapshot cascadeCounts;
+        StatsSnapshot tableCounts;
+        double cascade = bestNsPerEvent<CascadeProcessor>(stream.events, stream.type, cascadeCounts);
+        double table = bestNsPerEvent<TableProcessor>(stream.events, stream.type, tableCounts);
+        bool same = sameCounts(tableCounts, cascadeCounts);
+        failures += !same;
+        std::printf("  %-9s cascade %6.2f  engine %6.2f  (%+.1f%%, %zu events)  %s\n", stream.name, cascade, table,
+                    100.0 * (table - cascade) / cascade, stream.events.size(),
+                    same ? "counts match" : "COUNTS DIFFER");
+    }
+
+    struct Added {
+        const char* name;
+        DeviceType type;
+        Synthetic stream;
+    };
+    Added added[] = {
+        {"touchpad", DeviceType::Touchpad, makeTouchpadStream(frames)},
+        {"tablet", DeviceType::Tablet, makeTabletStream(frames)},
+        {"gamepad", DeviceType::Gamepad, makeGamepadStream(frames)},
+    };
+    for (Added& entry : added) {
+        entry.stream.expected.event_count = entry.stream.events.size();
+        StatsSnapshot counts;
+        double table = bestNsPerEvent<TableProcessor>(entry.stream.events, entry.type, counts);
+        bool same = sameCounts(counts, entry.stream.expected);
+        failures += !same;
+        std::printf("  %-9s table   %6.2f  (%zu events)  %s\n", entry.name, table, entry.stream.events.size(),
+                    same ? "counts as built" : "COUNTS DIFFER");
+        printCounts(counts);
+        if (!same) {
+            printCounts(entry.stream.expected);
+        }
+    }
+
+    std::printf("%s\n", failures == 0 ? "OK: every class counts what it should" : "FAILED: wrong counts");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// Checks the shared-memory export under contention and measures its cost.
+//
+// One writer publishes as fast as it can into a private segment; every word
+// of publish n holds n, so a reader that ever copies two different words
+// saw a torn snapshot. Several readers copy concurrently for the whole run.
+// Reports publishes/sec, reads/sec per reader, retries forced on readers
+// (seen as repeated generations) and the torn count; exits 1 if any copy
+// was torn.
+
+#include "sharedstats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+struct ReaderResult {
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t stale = 0;   // same publish as the previous read
+};
+
+SharedStatsValues valuesFor(uint64_t n)
+{
+    uint64_t words[SHARED_STATS_WORDS];
+    for (auto& word : words) {
+        word = n;
+    }
+    SharedStatsValues values;
+    std::memcpy(&values, words, sizeof(words));
+    return values;
+}
+
+void readLoop(const std::string& name, const std::atomic<bool>& done, ReaderResult& result)
+{
+    SharedStatsSegment segment;
+    if (!segment.open(name)) {
+        result.torn = ~0ULL;
+        return;
+    }
+    SharedStatsValues values;
+    uint64_t words[SHARED_STATS_WORDS];
+    uint64_t previous = ~0ULL;
+    while (!done.load(std::memory_order_relaxed)) {
+        if (segment.read(values) != SharedStatsRead::Ok) {
+            result.torn++;
+            continue;
+        }
+        std::memcpy(words, &values, sizeof(words));
+        for (std::size_t i = 1; i < SHARED_STATS_WORDS; ++i) {
+            if (words[i] != words[0]) {
+                result.torn++;
+                break;
+            }
+        }
+        if (words[0] == previous) {
+            result.stale++;
+        }
+        previous = words[0];
+        result.reads++;
+    }
+}
+
+} // namespace
+
+int runExportBenchmark(int argc, char* argv[])
+{
+    const uint64_t publishes = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 20000000;
+    unsigned readers = std::max(2u, std::min(4u, std::thread::hardware_concurrency()));
+    const std::string name = "/knm_bench_" + std::to_string(getpid());
+
+    SharedStatsSegment writer;
+    if (!writer.create(name)) {
+        return 1;
+    }
+    writer.publish(valuesFor(0));
+
+    std::atomic<bool> done{false};
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < readers; ++i) {
+        threads.emplace_back(readLoop, name, std::cref(done), std::ref(results[i]));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t n = 1; n <= publishes; ++n) {
+        writer.publish(valuesFor(n));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::printf("Shared stats export: %zu words, %llu publishes in %.3f s (%.1f M/s, %.1f ns each)\n",
+                SHARED_STATS_WORDS, static_cast<unsigned long long>(publishes), seconds,
+                publishes / seconds / 1e6, seconds * 1e9 / publishes);
+    uint64_t torn = 0;
+    for (unsigned i = 0; i < readers; ++i) {
+        std::printf("  reader %u: %llu reads (%.1f M/s), %llu repeated, %llu torn\n", i,
+                    static_cast<unsigned long long>(results[i].reads), results[i].reads / seconds / 1e6,
+                    static_cast<unsigned long long>(results[i].stale),
+                    static_cast<unsigned long long>(results[i].torn));
+        torn += results[i].torn;
+    }
+    // create() and the initial publish count as one generation each
+    if (writer.generation() != publishes + 2) {
+        std::printf("  generation %llu, expected %llu\n", static_cast<unsigned long long>(writer.generation()),
+                    static_cast<unsigned long long>(publishes + 2));
+        torn++;
+    }
+    std::printf("%s\n", torn == 0 ? "OK: no torn snapshots" : "FAILED: torn snapshots");
+    return torn == 0 ? 0 : 1;
+}
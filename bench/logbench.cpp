@@ -0,0 +1,139 @@
+// Measures how much per-event logging costs the event hot path.
+//
+// Feeds a synthetic high-rate mouse stream (motion on every frame, a click
+// and a scroll tick now and then) through the same counting and logging
+// calls the device handler makes, and reports events/sec for:
+//   - the old style: one std::cout line per event
+//   - the async logger at off / info / debug / trace
+// Output of both styles goes to /dev/null so only the logging path is timed.
+
+#include "benchutil.h"
+#include "logger.h"
+#include "statistics.h"
+
+#include <linux/input.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const char* DEVICE_NAME = "Synthetic Gaming Mouse";
+
+struct FrameState {
+    StatsSnapshot pending;
+    int dx = 0;
+    int dy = 0;
+};
+
+inline void endFrame(FrameState& state, StatsSlot& slot)
+{
+    if (state.dx != 0 || state.dy != 0) {
+        double dx = state.dx;
+        double dy = state.dy;
+        state.pending.mouse_distance += std::sqrt(dx * dx + dy * dy);
+        state.dx = state.dy = 0;
+    }
+    slot.publish(state.pending, currentSecond());
+    state.pending = StatsSnapshot();
+}
+
+double runIostream(const std::vector<input_event>& events, StatsSlot& slot)
+{
+    std::ofstream devnull("/dev/null");
+    std::streambuf* saved = std::cout.rdbuf(devnull.rdbuf());
+    FrameState state;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (const input_event& ev : events) {
+        if (ev.type == EV_KEY && ev.value == 1) {
+            state.pending.mouse_count++;
+            std::cout << "[mouse] Button click detected on " << DEVICE_NAME << "\n";
+        } else if (ev.type == EV_REL && ev.code == REL_WHEEL) {
+            state.pending.scroll_count += std::abs(ev.value);
+            std::cout << "[mouse] Scroll detected on " << DEVICE_NAME << ": " << ev.value << "\n";
+        } else if (ev.type == EV_REL && ev.code == REL_X) {
+            state.dx += ev.value;
+            std::cout << "[mouse] Movement X detected on " << DEVICE_NAME << ": " << ev.value << "\n";
+        } else if (ev.type == EV_REL && ev.code == REL_Y) {
+            state.dy += ev.value;
+            std::cout << "[mouse] Movement Y detected on " << DEVICE_NAME << ": " << ev.value << "\n";
+        } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+            endFrame(state, slot);
+        }
+    }
+    std::cout.flush();
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout.rdbuf(saved);
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+double runLogger(const std::vector<input_event>& events, StatsSlot& slot)
+{
+    FrameState state;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (const input_event& ev : events) {
+        if (ev.type == EV_KEY && ev.value == 1) {
+            state.pending.mouse_count++;
+            Logger::log(LogLevel::Debug, "[mouse] Button click detected on", DEVICE_NAME);
+        } else if (ev.type == EV_REL && ev.code == REL_WHEEL) {
+            state.pending.scroll_count += std::abs(ev.value);
+            Logger::log(LogLevel::Debug, "[mouse] Scroll detected on", DEVICE_NAME, ev.value);
+        } else if (ev.type == EV_REL && ev.code == REL_X) {
+            state.dx += ev.value;
+            Logger::trace("[mouse] Movement X detected on", DEVICE_NAME, ev.value);
+        } else if (ev.type == EV_REL && ev.code == REL_Y) {
+            state.dy += ev.value;
+            Logger::trace("[mouse] Movement Y detected on", DEVICE_NAME, ev.value);
+        } else if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+            endFrame(state, slot);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+void report(const char* label, std::size_t events, double seconds)
+{
+    std::printf("%-22s %12.0f events/s  (%.1f ns/event)\n", label, events / seconds, seconds * 1e9 / events);
+}
+
+} // namespace
+
+int runLoggingBenchmark(int argc, char* argv[])
+{
+    std::size_t frames = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 1000000;
+    std::vector<input_event> events = makeMouseStream(frames);
+    StatsCore stats(1);
+    StatsSlot& slot = *stats.acquireSlot();
+
+    std::printf("=== Logging benchmark: %zu events ===\n", events.size());
+    report("iostream per event", events.size(), runIostream(events, slot));
+
+    int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    Logger& logger = Logger::instance();
+    logger.setOutputFd(devnull);
+    logger.start();
+
+    const LogLevel levels[] = {LogLevel::Off, LogLevel::Info, LogLevel::Debug, LogLevel::Trace};
+    for (LogLevel level : levels) {
+        Logger::setLevel(level);
+        char label[32];
+        std::snprintf(label, sizeof(label), "async logger (%s)", logLevelName(level));
+        report(label, events.size(), runLogger(events, slot));
+    }
+
+    logger.stop();
+    std::printf("Records dropped because a ring was full: %llu\n",
+                static_cast<unsigned long long>(logger.droppedRecords()));
+    ::close(devnull);
+    return 0;
+}
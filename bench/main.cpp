@@ -0,0 +1,54 @@
+#include "logger.h"
+
+#include <cstdio>
+#include <cstring>
+
+int runDispatchBenchmark(int argc, char* argv[]);
+int runExportBenchmark(int argc, char* argv[]);
+int runLoggingBenchmark(int argc, char* argv[]);
+int runMaskBenchmark(int argc, char* argv[]);
+int runPipelineBenchmark(int argc, char* argv[]);
+int runReplayBenchmark(int argc, char* argv[]);
+int runRollupBenchmark(int argc, char* argv[]);
+int runUinputBenchmark(int argc, char* argv[]);
+
+namespace {
+
+struct Benchmark {
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+    const char* usage;
+};
+
+const Benchmark benchmarks[] = {
+    {"pipeline", runPipelineBenchmark, "[frames]          synthetic streams through EventProcessor"},
+    {"replay", runReplayBenchmark, "<segment> [repeat] a recorded journal segment"},
+    {"uinput", runUinputBenchmark, "[frames]          virtual mouse through the epoll engine"},
+    {"logging", runLoggingBenchmark, "[frames]          cost of per-event logging"},
+    {"export", runExportBenchmark, "[publishes]       shared-memory seqlock under reader contention"},
+    {"rollup", runRollupBenchmark, "[days] [keep]     history store size and range queries"},
+    {"dispatch", runDispatchBenchmark, "[frames]          dispatch tables against the old branch cascade"},
+    {"mask", runMaskBenchmark, "[frames]          events and wakeups saved by kernel event masks"},
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const char* name = argc > 1 ? argv[1] : "pipeline";
+    for (const Benchmark& benchmark : benchmarks) {
+        if (std::strcmp(name, benchmark.name) == 0) {
+            // Pipeline numbers should not include logging unless asked for
+            if (benchmark.run != runLoggingBenchmark) {
+                Logger::setLevel(LogLevel::Off);
+            }
+            return benchmark.run(argc > 2 ? argc - 2 : 0, argv + 2);
+        }
+    }
+
+    std::fprintf(stderr, "usage: %s <benchmark> [args]\n", argv[0]);
+    for (const Benchmark& benchmark : benchmarks) {
+        std::fprintf(stderr, "  %-9s %s\n", benchmark.name, benchmark.usage);
+    }
+    return 2;
+}
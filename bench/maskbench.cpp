@@ -0,0 +1,166 @@
+// What the kernel event masks save, and a check that they lose nothing.
+//
+//   mask [frames]     a keyboard and a gaming mouse under several --metrics
+//
+// Each stream is passed through the filter the kernel applies for a mask
+// (EventMask::delivers, and frames left with nothing but their SYN_REPORT
+// are not delivered at all). Reports the events and frames that still reach
+// the process; with the reader keeping up, every delivered frame costs an
+// epoll wakeup and a read(). The delivered events are then processed with
+// the same metrics, and the counters of every enabled metric must equal an
+// unmasked run's, or the benchmark fails.
+
+#include "benchutil.h"
+#include "eventmask.h"
+#include "eventprocessor.h"
+#include "statistics.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+input_event makeEvent(uint16_t type, uint16_t code, int32_t value)
+{
+    input_event ev{};
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    return ev;
+}
+
+// What a current mouse sends: high-resolution wheel events next to the
+// classic ones, a scancode before each button, and side buttons nobody counts
+std::vector<input_event> makeGamingMouseStream(std::size_t frames)
+{
+    std::vector<input_event> events;
+    events.reserve(frames * 4);
+    for (std::size_t i = 0; i < frames; ++i) {
+        if (i % 4 != 3) {
+            events.push_back(makeEvent(EV_REL, REL_X, static_cast<int>(i % 7) - 3));
+            events.push_back(makeEvent(EV_REL, REL_Y, static_cast<int>(i % 5) - 2));
+        }
+        if (i % 500 == 0) {
+            events.push_back(makeEvent(EV_MSC, MSC_SCAN, 0x90001));
+            events.push_back(makeEvent(EV_KEY, BTN_LEFT, (i / 500) % 2 == 0 ? 1 : 0));
+        } else if (i % 1500 == 250) {
+            events.push_back(makeEvent(EV_MSC, MSC_SCAN, 0x90004));
+            events.push_back(makeEvent(EV_KEY, BTN_SIDE, (i / 1500) % 2 == 0 ? 1 : 0));
+        } else if (i % 97 == 0) {
+            events.push_back(makeEvent(EV_REL, REL_WHEEL, 1));
+            events.push_back(makeEvent(EV_REL, REL_WHEEL_HI_RES, 120));
+        }
+        if (events.empty() || events.back().type == EV_SYN) {
+            continue;   // idle frame, the device sends nothing
+        }
+        events.push_back(makeEvent(EV_SYN, SYN_REPORT, 0));
+    }
+    return events;
+}
+
+struct Delivery {
+    std::vector<input_event> events;
+    std::size_t frames = 0;
+};
+
+// The kernel's per-client filter applied to a whole stream
+Delivery deliver(const std::vector<input_event>& stream, const EventMask& mask)
+{
+    Delivery delivered;
+    delivered.events.reserve(stream.size());
+    std::size_t frameStart = 0;
+    for (const input_event& ev : stream) {
+        if (!mask.delivers(ev.type, ev.code)) {
+            continue;
+        }
+        if (ev.type == EV_SYN && ev.code == SYN_REPORT) {
+            if (delivered.events.size() == frameStart) {
+                continue;
+            }
+            ++delivered.frames;
+            delivered.events.push_back(ev);
+            frameStart = delivered.events.size();
+            continue;
+        }
+        delivered.events.push_back(ev);
+    }
+    return delivered;
+}
+
+StatsSnapshot count(const std::vector<input_event>& events, DeviceType type, MetricSet metrics)
+{
+    StatsCore stats;
+    EventProcessor processor(type, stats.acquireSlot(), "bench");
+    processor.setMetrics(metrics);
+    for (std::size_t i = 0; i < events.size(); i += EVENT_BATCH_SIZE) {
+        std::size_t n = events.size() - i < EVENT_BATCH_SIZE ? events.size() - i : EVENT_BATCH_SIZE;
+        processor.process(events.data() + i, n);
+    }
+    return stats.snapshot();
+}
+
+// Distance is summed per batch, and the batches fall differently once events
+// are filtered, so it only matches up to rounding
+bool sameCounts(const StatsSnapshot& masked, const StatsSnapshot& full, MetricSet metrics)
+{
+    return (!(metrics & METRIC_KEYS) || masked.keyboard_count == full.keyboard_count) &&
+           (!(metrics & METRIC_CLICKS) || masked.mouse_count == full.mouse_count) &&
+           (!(metrics & METRIC_SCROLL) || masked.scroll_count == full.scroll_count) &&
+           (!(metrics & METRIC_STROKES) || masked.stroke_count == full.stroke_count) &&
+           (!(metrics & METRIC_GAMEPAD) ||
+            (masked.gamepad_count == full.gamepad_count && masked.axis_count == full.axis_count)) &&
+           (!(metrics & METRIC_MOVEMENT) || std::fabs(masked.mouse_distance - full.mouse_distance) <=
+                                                1e-9 * full.mouse_distance);
+}
+
+} // namespace
+
+int runMaskBenchmark(int argc, char* argv[])
+{
+    std::size_t frames = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 1000000;
+
+    struct Stream {
+        const char* name;
+        DeviceType type;
+        std::vector<input_event> events;
+    };
+    const Stream streams[] = {
+        {"keyboard", DeviceType::Keyboard, makeKeyboardStream(frames / 10)},
+        {"mouse", DeviceType::Mouse, makeGamingMouseStream(frames)},
+    };
+    const MetricSet configs[] = {
+        ALL_METRICS,
+        METRIC_KEYS | METRIC_CLICKS | METRIC_SCROLL,
+        METRIC_KEYS | METRIC_CLICKS,
+        METRIC_MOVEMENT,
+    };
+
+    EventMask everything;
+    std::memset(everything.types, 0xff, sizeof(everything.types));
+    std::memset(everything.keys, 0xff, sizeof(everything.keys));
+    std::memset(everything.relative, 0xff, sizeof(everything.relative));
+
+    int failures = 0;
+    for (const Stream& stream : streams) {
+        Delivery unmasked = deliver(stream.events, everything);
+        StatsSnapshot full = count(stream.events, stream.type, ALL_METRICS);
+        std::printf("%s: %zu events in %zu frames without a mask\n", stream.name, unmasked.events.size(),
+                    unmasked.frames);
+        for (MetricSet metrics : configs) {
+            Delivery masked = deliver(stream.events, compileEventMask(metrics, stream.type, false));
+            StatsSnapshot counts = count(masked.events, stream.type, metrics);
+            bool same = sameCounts(counts, full, metrics);
+            failures += !same;
+            std::printf("  %-26s %9zu events (%5.1f%%)  %8zu wakeups (%5.1f%%)  %s\n", formatMetrics(metrics).c_str(),
+                        masked.events.size(), 100.0 * masked.events.size() / unmasked.events.size(), masked.frames,
+                        unmasked.frames ? 100.0 * masked.frames / unmasked.frames : 0.0,
+                        same ? "counts match" : "COUNTS DIFFER");
+        }
+    }
+
+    std::printf("%s\n", failures == 0 ? "OK: masked streams count the same" : "FAILED: a mask lost counted events");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+// Throughput and latency of the event pipeline without real hardware.
+//
+//   pipeline [frames]     synthetic mouse and keyboard streams from memory
+//   replay <segment>      every device in a journal segment (--record output)
+//   uinput [frames]       a virtual mouse through /dev/uinput, read back via
+//                         the real epoll engine; needs write access to uinput
+//
+// Reports events/sec, per-event processing time percentiles (timed per
+// 64-event batch and divided by the batch size, since timing single events
+// would cost more than processing them) and heap allocations per event.
+
+#include "benchutil.h"
+#include "eventengine.h"
+#include "eventprocessor.h"
+#include "eventsource.h"
+#include "logger.h"
+#include "statistics.h"
+#include "typingstats.h"
+#include "activityrates.h"
+#include "heatmap.h"
+#include "latencyhistogram.h"
+
+#include <libevdev/libevdev.h>
+#include <libevdev/libevdev-uinput.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include <initializer_list>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+struct RunResult {
+    uint64_t events = 0;
+    double seconds = 0.0;
+    uint64_t allocations = 0;
+    std::vector<double> perEventNs;
+};
+
+RunResult timedReplay(EventSource& source, EventProcessor& processor, std::size_t expectedEvents)
+{
+    RunResult result;
+    result.perEventNs.reserve(expectedEvents / EVENT_BATCH_SIZE + 1);
+    input_event buffer[EVENT_BATCH_SIZE];
+    const uint64_t allocationsBefore = allocationCount();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t n = source.read(buffer, EVENT_BATCH_SIZE); n > 0; n = source.read(buffer, EVENT_BATCH_SIZE)) {
+        auto t0 = std::chrono::steady_clock::now();
+        processor.process(buffer, n);
+        auto t1 = std::chrono::steady_clock::now();
+        if (result.perEventNs.size() < result.perEventNs.capacity()) {
+            result.perEventNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / n);
+        }
+        result.events += n;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.allocations = allocationCount() - allocationsBefore;
+    return result;
+}
+
+void printResult(const char* label, RunResult& result)
+{
+    std::printf("%s\n", label);
+    std::printf("  %-26s %.0f events/s (%llu events in %.3f s)\n", "throughput",
+                result.events / result.seconds, static_cast<unsigned long long>(result.events), result.seconds);
+    LatencySummary summary = summarize(result.perEventNs);
+    printLatency("processing per event", summary, "ns");
+    std::printf("  %-26s %.4f\n", "allocations per event",
+                result.events ? static_cast<double>(result.allocations) / result.events : 0.0);
+}
+
+RunResult replayStream(const std::vector<input_event>& stream, std::size_t repeat, DeviceType type, StatsCore& stats,
+                       TypingStats& typing, ActivityRates& activity, HeatmapStats& heatmaps)
+{
+    EventProcessor processor(type, stats.acquireSlot(), "bench");
+    processor.setRateSlot(activity.acquireSlot());
+    if (type == DeviceType::Keyboard) {
+        processor.setTypingSlot(typing.acquireSlot());
+    } else {
+        processor.setHeatmapSlot(heatmaps.acquireSlot(HEATMAP_DEFAULT_WIDTH, HEATMAP_DEFAULT_HEIGHT));
+    }
+    MemorySource source(stream, repeat);
+    return timedReplay(source, processor, stream.size() * repeat);
+}
+
+} // namespace
+
+int runPipelineBenchmark(int argc, char* argv[])
+{
+    std::size_t frames = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 2000000;
+    StatsCore stats;
+    TypingStats typing;
+    ActivityRates activity;
+    HeatmapStats heatmaps;
+
+    std::vector<input_event> mouse = makeMouseStream(frames);
+    RunResult mouseRun = replayStream(mouse, 1, DeviceType::Mouse, stats, typing, activity, heatmaps);
+    printResult("synthetic mouse (8 kHz frames)", mouseRun);
+
+    std::vector<input_event> keyboard = makeKeyboardStream(frames / 4);
+    RunResult keyboardRun = replayStream(keyboard, 1, DeviceType::Keyboard, stats, typing, activity, heatmaps);
+    printResult("synthetic keyboard", keyboardRun);
+
+    // Reading the typing tables is the export path; time it too
+    auto begin = std::chrono::steady_clock::now();
+    TypingSnapshot keys = typing.snapshot();
+    double snapshotUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("  %-26s %.1f us (%llu presses, median interval %.0f ms)\n", "typing snapshot", snapshotUs,
+                static_cast<unsigned long long>(keys.totalPresses), keys.medianIntervalMs());
+
+    begin = std::chrono::steady_clock::now();
+    RateSnapshot rates = activity.snapshot();
+    double ratesUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("  %-26s %.1f us (%llu keys in the last minute)\n", "rate snapshot", ratesUs,
+                static_cast<unsigned long long>(rates.lastMinute().keyboard_count));
+
+    // A view reads one pyramid level; the coarse ones cost next to nothing
+    for (std::size_t level : {std::size_t(0), std::size_t(3)}) {
+        begin = std::chrono::steady_clock::now();
+        HeatmapGrid grid = heatmaps.snapshot(HeatmapKind::Movement, level);
+        double gridUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+        std::string label = "heatmap level " + std::to_string(level);
+        std::printf("  %-26s %.1f us (%zux%zu cells, %llu motion reports, peak %llu)\n", label.c_str(), gridUs,
+                    grid.size, grid.size, static_cast<unsigned long long>(grid.total()),
+                    static_cast<unsigned long long>(grid.peak()));
+    }
+
+    // Totals are summed over the device table on every read; time it full
+    StatsCore table;
+    std::vector<StatsSlot*> rows;
+    for (int i = 0; i < 256; ++i) {
+        DeviceLabel label;
+        label.key = label.name = "device " + std::to_string(i);
+        rows.push_back(table.acquireSlot(label));
+    }
+    StatsSnapshot one;
+    one.keyboard_count = one.event_count = 1;
+    for (StatsSlot* row : rows) {
+        row->publish(one, currentSecond());
+    }
+    const int reads = 1000;
+    begin = std::chrono::steady_clock::now();
+    uint64_t check = 0;
+    for (int i = 0; i < reads; ++i) {
+        check += table.snapshot().keyboard_count;
+    }
+    double totalsNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / reads;
+    begin = std::chrono::steady_clock::now();
+    std::size_t listed = table.devices().size();
+    double breakdownUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("  %-26s %.0f ns totals, %.1f us breakdown (%zu devices, %llu keys)\n", "device table", totalsNs,
+                breakdownUs, listed, static_cast<unsigned long long>(check / reads));
+
+    StatsSnapshot totals = stats.snapshot();
+    std::printf("totals: %llu keys, %llu clicks, %llu scroll, %.0f distance\n",
+                static_cast<unsigned long long>(totals.keyboard_count),
+                static_cast<unsigned long long>(totals.mouse_count),
+                static_cast<unsigned long long>(totals.scroll_count), totals.mouse_distance);
+    return 0;
+}
+
+int runReplayBenchmark(int argc, char* argv[])
+{
+    if (argc < 1) {
+        std::fprintf(stderr, "usage: TrackerBench replay <segment.knmj> [repeat]\n");
+        return 2;
+    }
+    const std::string path = argv[0];
+    std::size_t repeat = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+
+    JournalSource probe;
+    if (!probe.open(path, 0)) {
+        return 1;
+    }
+    std::vector<std::string> names = probe.deviceNames();
+    std::printf("%s: %llu records, %zu device(s)\n", path.c_str(),
+                static_cast<unsigned long long>(probe.recordCount()), names.size());
+
+    StatsCore stats;
+    TypingStats typing;
+    ActivityRates activity;
+    HeatmapStats heatmaps;
+    for (uint16_t device = 0; device < names.size(); ++device) {
+        // Load the device's stream into memory so file access is not timed
+        JournalSource source;
+        if (!source.open(path, device)) {
+            return 1;
+        }
+        std::vector<input_event> stream;
+        input_event buffer[EVENT_BATCH_SIZE];
+        bool hasMotion = false;
+        for (std::size_t n = source.read(buffer, EVENT_BATCH_SIZE); n > 0; n = source.read(buffer, EVENT_BATCH_SIZE)) {
+            for (std::size_t i = 0; i < n; ++i) {
+                hasMotion = hasMotion || buffer[i].type == EV_REL;
+            }
+            stream.insert(stream.end(), buffer, buffer + n);
+        }
+        if (stream.empty()) {
+            continue;
+        }
+
+        RunResult run = replayStream(stream, repeat, hasMotion ? DeviceType::Mouse : DeviceType::Keyboard, stats, typing, activity, heatmaps);
+        std::string label = "device " + std::to_string(device) + ": " + names[device];
+        printResult(label.c_str(), run);
+    }
+    return 0;
+}
+
+int runUinputBenchmark(int argc, char* argv[])
+{
+    std::size_t frames = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 200000;
+
+    libevdev* dev = libevdev_new();
+    libevdev_set_name(dev, "KnM Tracker bench mouse");
+    libevdev_enable_event_type(dev, EV_REL);
+    libevdev_enable_event_code(dev, EV_REL, REL_X, nullptr);
+    libevdev_enable_event_code(dev, EV_REL, REL_Y, nullptr);
+    libevdev_enable_event_code(dev, EV_REL, REL_WHEEL, nullptr);
+    libevdev_enable_event_type(dev, EV_KEY);
+    libevdev_enable_event_code(dev, EV_KEY, BTN_LEFT, nullptr);
+
+    libevdev_uinput* uidev = nullptr;
+    int rc = libevdev_uinput_create_from_device(dev, LIBEVDEV_UINPUT_OPEN_MANAGED, &uidev);
+    if (rc < 0) {
+        std::fprintf(stderr, "uinput unavailable: %s (needs write access to /dev/uinput)\n", strerror(-rc));
+        libevdev_free(dev);
+        return 1;
+    }
+
+    const char* node = libevdev_uinput_get_devnode(uidev);
+    int fd = node ? ::open(node, O_RDONLY | O_NONBLOCK | O_CLOEXEC) : -1;
+    if (fd < 0) {
+        std::fprintf(stderr, "cannot open virtual device %s: %s\n", node ? node : "(none)", strerror(errno));
+        libevdev_uinput_destroy(uidev);
+        libevdev_free(dev);
+        return 1;
+    }
+
+    // Same clock as the engine uses on live devices
+    int clock = CLOCK_MONOTONIC;
+    const bool monotonic = ioctl(fd, EVIOCSCLOCKID, &clock) >= 0;
+    const clockid_t eventClock = monotonic ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+
+    StatsCore stats;
+    EventProcessor processor(DeviceType::Mouse, stats.acquireSlot(), "uinput");
+    LatencyHistogram histogram;
+    if (monotonic) {
+        processor.setLatencyHistogram(&histogram);
+    }
+    std::vector<double> deliveryUs;
+    deliveryUs.reserve(frames * 3);
+    std::atomic<uint64_t> received{0};
+    std::atomic<int64_t> lastReceiveNs{0};
+
+    // Same path as a live device, plus an exact kernel-timestamp delivery
+    // latency per event to check the histogram against.
+    EventEngine engine(1);
+    engine.start();
+    engine.addSource(fd, [&](int readyFd) {
+        input_event buffer[EVENT_BATCH_SIZE];
+        for (;;) {
+            ssize_t bytes = ::read(readyFd, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                return bytes < 0 && errno == EAGAIN;
+            }
+            std::size_t n = static_cast<std::size_t>(bytes) / sizeof(input_event);
+            timespec now;
+            clock_gettime(eventClock, &now);
+            double nowUs = now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+            for (std::size_t i = 0; i < n && deliveryUs.size() < deliveryUs.capacity(); ++i) {
+                deliveryUs.push_back(nowUs - (buffer[i].input_event_sec * 1e6 + buffer[i].input_event_usec));
+            }
+            processor.process(buffer, n);
+            lastReceiveNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now().time_since_epoch()).count(),
+                                std::memory_order_relaxed);
+            received.fetch_add(n, std::memory_order_release);
+        }
+    });
+
+    // Give the engine a moment to arm the fd before the burst
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    const uint64_t allocationsBefore = allocationCount();
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+    for (std::size_t i = 0; i < frames; ++i) {
+        libevdev_uinput_write_event(uidev, EV_REL, REL_X, static_cast<int>(i % 7) - 3);
+        libevdev_uinput_write_event(uidev, EV_REL, REL_Y, static_cast<int>(i % 5) - 2);
+        libevdev_uinput_write_event(uidev, EV_SYN, SYN_REPORT, 0);
+        sent += 3;
+    }
+
+    // Zero-value REL events are filtered by the kernel, so wait for quiet
+    // rather than for an exact count.
+    uint64_t last = 0;
+    for (int idle = 0; idle < 20; ++idle) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t now = received.load(std::memory_order_acquire);
+        if (now != last) {
+            idle = 0;
+            last = now;
+        }
+    }
+    auto end = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(lastReceiveNs.load()));
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    engine.stop();
+    uint64_t allocations = allocationCount() - allocationsBefore;
+
+    std::printf("uinput mouse via epoll engine\n");
+    std::printf("  %-26s %llu written, %llu received in %.3f s (%.0f events/s)\n", "events",
+                static_cast<unsigned long long>(sent), static_cast<unsigned long long>(last), seconds,
+                last / seconds);
+    LatencySummary summary = summarize(deliveryUs);
+    printLatency("kernel to processed", summary, "us");
+    if (monotonic) {
+        LatencyCounts counts;
+        histogram.copyTo(counts);
+        LatencyPercentiles histogramSummary = counts.percentiles();
+        std::printf("  %-26s p50 %8.2f  p99 %8.2f  max %9.2f us (%llu reports)\n", "histogram per report",
+                    histogramSummary.p50, histogramSummary.p99, histogramSummary.max,
+                    static_cast<unsigned long long>(histogramSummary.count));
+    }
+    std::printf("  %-26s %.4f\n", "allocations per event", last ? static_cast<double>(allocations) / last : 0.0);
+    std::printf("  %-26s %llu\n", "engine wakeups", static_cast<unsigned long long>(engine.wakeups()));
+
+    ::close(fd);
+    libevdev_uinput_destroy(uidev);
+    libevdev_free(dev);
+    return 0;
+}
@@ -0,0 +1,349 @@
+// Measures the history store on synthetic data and checks its answers.
+//
+// Writes `days` of office-hours activity minute by minute for a keyboard, a
+// mouse and the all-devices totals, flushing every simulated hour as the
+// tracker does. Reports the file size, how long reopening (indexing) takes,
+// and the latency of range queries from an hour to a year with ragged
+// ends; every answer is compared with a sum over the raw minutes and the
+// run fails on any difference. With a minute retention, ranges reaching
+// behind it are checked against the whole hours the store reports. A
+// minute flushed by one run and again by the next (a restart within the
+// minute) must still count as one active minute in every tier, and a
+// flush cut short anywhere must leave minutes, hours and days agreeing.
+
+#include "rollupstore.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+constexpr int64_t DAY = 86400;
+constexpr int QUERIES_PER_SPAN = 200;
+
+struct Lcg {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint32_t next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state >> 33);
+    }
+    uint32_t below(uint32_t limit) { return next() % limit; }
+};
+
+// Prefix sums over every minute of the run, one array per series column
+struct Reference {
+    int64_t start = 0;
+    std::vector<std::array<uint64_t, 5>> prefix;   // keys, clicks, scroll, events, distance
+
+    void append(const StatsSnapshot& counts) {
+        std::array<uint64_t, 5> row = prefix.empty() ? std::array<uint64_t, 5>{} : prefix.back();
+        row[0] += counts.keyboard_count;
+        row[1] += counts.mouse_count;
+        row[2] += counts.scroll_count;
+        row[3] += counts.event_count;
+        row[4] += static_cast<uint64_t>(counts.mouse_distance);
+        prefix.push_back(row);
+    }
+    // Minutes [from, to) of the run, clamped
+    std::array<uint64_t, 5> sum(int64_t from, int64_t to) const {
+        auto index = [this](int64_t second) {
+            int64_t minute = (second - start) / 60;
+            return static_cast<std::size_t>(std::max<int64_t>(0, std::min<int64_t>(minute, prefix.size())));
+        };
+        std::size_t a = index(from);
+        std::size_t b = index(to);
+        std::array<uint64_t, 5> result{};
+        for (std::size_t i = 0; i < result.size() && b > a; ++i) {
+            result[i] = prefix[b - 1][i] - (a > 0 ? prefix[a - 1][i] : 0);
+        }
+        return result;
+    }
+};
+
+double elapsedUs(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Stops and restarts a store within one minute; returns the mismatches
+uint64_t checkRepeatedMinute(const RollupOptions& options, int64_t minute)
+{
+    StatsSnapshot counts;
+    counts.keyboard_count = 10;
+    counts.event_count = 20;
+    {
+        RollupStore store(options);
+        if (!store.open()) {
+            return 1;
+        }
+        store.add(ROLLUP_TOTAL_SERIES, minute, counts);
+    }
+
+    RollupStore store(options);
+    if (!store.open()) {
+        return 1;
+    }
+    store.add(ROLLUP_TOTAL_SERIES, minute, counts);
+    uint64_t mismatches = 0;
+    auto check = [&](const char* when) {
+        const RollupTier tiers[] = {RollupTier::Minutes, RollupTier::Hours, RollupTier::Days};
+        for (RollupTier tier : tiers) {
+            int64_t period = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(tier)];
+            int64_t from = minute - minute % period;
+            RollupSummary summary = store.query(from, from + period);
+            std::vector<RollupRow> rows = store.rows(tier, from, from + period);
+            bool right = summary.activeMinutes == 1 && summary.totals.keyboard_count == 20 && rows.size() == 1 &&
+                         rows[0].activeMinutes == 1 && rows[0].counts.keyboard_count == 20;
+            if (!right && mismatches++ < 5) {
+                std::printf("  mismatch: minute flushed twice, %s: %llu active minute(s) over %lld s\n", when,
+                            static_cast<unsigned long long>(summary.activeMinutes), static_cast<long long>(period));
+            }
+        }
+    };
+    check("pending");
+    store.flush();
+    check("flushed");
+    return mismatches;
+}
+
+bool readFile(const std::string& path, std::string& data)
+{
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char buffer[65536];
+    data.clear();
+    for (std::size_t got; (got = std::fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+        data.append(buffer, got);
+    }
+    std::fclose(file);
+    return true;
+}
+
+bool writeFile(const std::string& path, const std::string& data)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+// Cuts the second of two flushes short at many points; every tier must
+// then still report only the first. Returns the mismatches.
+uint64_t checkTornFlush(const RollupOptions& options, int64_t day)
+{
+    const std::string path = options.directory + "/" + ROLLUP_FILE_NAME;
+    StatsSnapshot counts;
+    counts.keyboard_count = 7;
+    counts.event_count = 9;
+    uint64_t committed = 0;
+    {
+        RollupStore store(options);
+        if (!store.open()) {
+            return 1;
+        }
+        store.add(ROLLUP_TOTAL_SERIES, day + 600, counts);
+        store.flush();
+        committed = store.fileBytes();
+        // Another minute of the same hour and one of a new hour
+        store.add(ROLLUP_TOTAL_SERIES, day + 660, counts);
+        store.add(ROLLUP_TOTAL_SERIES, day + 7200, counts);
+        store.flush();
+    }
+    std::string full;
+    if (!readFile(path, full) || full.size() <= committed) {
+        return 1;
+    }
+
+    uint64_t mismatches = 0;
+    const uint64_t step = std::max<uint64_t>(1, (full.size() - committed) / 16);
+    for (uint64_t cut = committed; cut < full.size(); cut += step) {
+        if (!writeFile(path, full.substr(0, cut))) {
+            return mismatches + 1;
+        }
+        RollupStore store(options);
+        if (!store.open()) {
+            return mismatches + 1;
+        }
+        // Answered from the minute, hour and day tier respectively
+        const int64_t ranges[][2] = {{day + 600, day + 720}, {day, day + 3600}, {day, day + DAY}};
+        for (const auto& range : ranges) {
+            RollupSummary summary = store.query(range[0], range[1]);
+            if ((summary.totals.keyboard_count != 7 || summary.activeMinutes != 1) && mismatches++ < 5) {
+                std::printf("  mismatch: flush cut at byte %llu of %zu: %llu keys over %lld s, expected 7\n",
+                            static_cast<unsigned long long>(cut), full.size(),
+                            static_cast<unsigned long long>(summary.totals.keyboard_count),
+                            static_cast<long long>(range[1] - range[0]));
+            }
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int runRollupBenchmark(int argc, char* argv[])
+{
+    const int days = argc > 0 ? std::max(1, std::atoi(argv[0])) : 365;
+    const std::string directory = "/tmp/knm_rollup_bench_" + std::to_string(getpid());
+    const int64_t start = (static_cast<int64_t>(time(nullptr)) / DAY - days) * DAY;
+
+    RollupOptions options;
+    options.directory = directory;
+    options.minuteRetentionDays = argc > 1 ? std::atoi(argv[1]) : 0;
+    Reference total;
+    Reference keyboard;
+    Reference mouse;
+    total.start = keyboard.start = mouse.start = start;
+    uint64_t activeMinutes = 0;
+
+    auto writeBegin = std::chrono::steady_clock::now();
+    uint64_t fileBytes = 0;
+    uint64_t deadBytes = 0;
+    {
+        RollupStore store(options);
+        if (!store.open()) {
+            return 1;
+        }
+        store.setSeriesName("kbd", "Bench keyboard");
+        store.setSeriesName("mouse", "Bench mouse");
+        Lcg random;
+        for (int64_t minute = start; minute < start + days * DAY; minute += 60) {
+            StatsSnapshot keys;
+            StatsSnapshot pointer;
+            int hour = static_cast<int>((minute % DAY) / 3600);
+            bool weekday = (minute / DAY + 4) % 7 < 5;
+            if (weekday && hour >= 8 && hour < 18 && random.below(10) < 7) {
+                keys.keyboard_count = random.below(150);
+                keys.event_count = keys.keyboard_count * 2 + random.below(10);
+                pointer.mouse_count = random.below(30);
+                pointer.scroll_count = random.below(40);
+                pointer.mouse_distance = random.below(20000);
+                pointer.event_count = pointer.mouse_count * 2 + pointer.scroll_count + random.below(3000);
+            }
+            StatsSnapshot both = keys;
+            both += pointer;
+            keyboard.append(keys);
+            mouse.append(pointer);
+            total.append(both);
+            if (!both.empty()) {
+                ++activeMinutes;
+                store.add(ROLLUP_TOTAL_SERIES, minute, both);
+                store.add("kbd", minute, keys);
+                store.add("mouse", minute, pointer);
+            }
+            if ((minute + 60) % 3600 == 0) {
+                store.flush();
+            }
+        }
+        store.flush();
+        fileBytes = store.fileBytes();
+        deadBytes = store.deadBytes();
+    }
+    double writeUs = elapsedUs(writeBegin);
+
+    std::printf("History store: %d days, %llu active minutes x 3 series, written in %.2f s\n", days,
+                static_cast<unsigned long long>(activeMinutes), writeUs / 1e6);
+    std::printf("  file %.2f MB (%.1f%% dead after the last automatic compaction), %.1f bytes per minute row\n",
+                fileBytes / 1048576.0, fileBytes ? 100.0 * deadBytes / fileBytes : 0.0,
+                activeMinutes ? static_cast<double>(fileBytes - deadBytes) / (activeMinutes * 3) : 0.0);
+
+    {
+        RollupStore store(options);
+        auto compactBegin = std::chrono::steady_clock::now();
+        if (!store.open() || !store.compact()) {
+            return 1;
+        }
+        std::printf("  compacted to %.2f MB in %.1f ms\n", store.fileBytes() / 1048576.0,
+                    elapsedUs(compactBegin) / 1000.0);
+    }
+
+    options.readOnly = true;
+    RollupStore reader(options);
+    auto openBegin = std::chrono::steady_clock::now();
+    if (!reader.open()) {
+        return 1;
+    }
+    std::printf("  reopened read-only in %.2f ms (%zu series)\n", elapsedUs(openBegin) / 1000.0,
+                reader.series().size());
+
+    struct Span {
+        const char* name;
+        int64_t seconds;
+    };
+    const Span spans[] = {{"1 hour", 3600}, {"1 day", DAY}, {"30 days", 30 * DAY}, {"365 days", 365 * DAY}};
+    const Reference* references[] = {&total, &keyboard, &mouse};
+    const char* keys[] = {ROLLUP_TOTAL_SERIES, "kbd", "mouse"};
+
+    Lcg random;
+    uint64_t mismatches = 0;
+    for (const Span& span : spans) {
+        if (span.seconds > days * DAY) {
+            continue;
+        }
+        std::vector<double> times;
+        std::size_t summed = 0;
+        std::size_t decoded = 0;
+        for (int i = 0; i < QUERIES_PER_SPAN; ++i) {
+            int64_t from = start + random.below(static_cast<uint32_t>(days * DAY - span.seconds + 1));
+            int64_t to = from + span.seconds;
+            std::size_t series = i % 3;
+            auto begin = std::chrono::steady_clock::now();
+            RollupSummary summary = reader.query(from, to, keys[series]);
+            times.push_back(elapsedUs(begin));
+            summed += summary.blocksSummed;
+            decoded += summary.blocksDecoded;
+            // An hour and a minute block for each of the two end days
+            if (summary.blocksDecoded > 4 && mismatches++ < 5) {
+                std::printf("  query decoded %zu blocks\n", summary.blocksDecoded);
+            }
+
+            std::array<uint64_t, 5> expected = references[series]->sum(summary.from, summary.to);
+            if (summary.totals.keyboard_count != expected[0] || summary.totals.mouse_count != expected[1] ||
+                summary.totals.scroll_count != expected[2] || summary.totals.event_count != expected[3] ||
+                static_cast<uint64_t>(summary.totals.mouse_distance) != expected[4]) {
+                if (mismatches++ < 5) {
+                    std::printf("  mismatch: series '%s' [%lld, %lld): %llu keys, expected %llu\n", keys[series],
+                                static_cast<long long>(summary.from), static_cast<long long>(summary.to),
+                                static_cast<unsigned long long>(summary.totals.keyboard_count),
+                                static_cast<unsigned long long>(expected[0]));
+                }
+            }
+        }
+        std::sort(times.begin(), times.end());
+        std::printf("  query %-9s p50 %7.1f us  max %7.1f us  (%.1f blocks from totals, %.1f decoded)\n", span.name,
+                    times[times.size() / 2], times.back(), static_cast<double>(summed) / QUERIES_PER_SPAN,
+                    static_cast<double>(decoded) / QUERIES_PER_SPAN);
+    }
+
+    auto rowsBegin = std::chrono::steady_clock::now();
+    std::vector<RollupRow> daily = reader.rows(RollupTier::Days, start, start + days * DAY);
+    std::printf("  %zu daily rows in %.1f us\n", daily.size(), elapsedUs(rowsBegin));
+
+    reader.close();
+    unlink((directory + "/" + ROLLUP_FILE_NAME).c_str());
+
+    options.readOnly = false;
+    uint64_t repeated = checkRepeatedMinute(options, start + days * DAY + 600);
+    mismatches += repeated;
+    std::printf("  minute flushed again after a restart: %s\n", repeated == 0 ? "one active minute" : "COUNTED TWICE");
+    unlink((directory + "/" + ROLLUP_FILE_NAME).c_str());
+    uint64_t torn = checkTornFlush(options, start + (days + 2) * DAY);
+    mismatches += torn;
+    std::printf("  flush cut short: %s\n", torn == 0 ? "tiers agree" : "TIERS DISAGREE");
+
+    unlink((directory + "/" + ROLLUP_FILE_NAME).c_str());
+    rmdir(directory.c_str());
+    std::printf("%s\n", mismatches == 0 ? "OK: every query matches the raw minutes" : "FAILED: wrong totals");
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+CONFIG += c++17 console
+CONFIG -= qt app_bundle
+
+TARGET = TrackerDaemon
+TEMPLATE = app
+
+SOURCES += \
+    main.cpp
+
+include(../engine/engine.pri)
@@ -0,0 +1,212 @@
+// Headless tracker: the same engine as the GUI without Qt, for kiosks and
+// shared machines. Prints the totals every --interval seconds and once more
+// on SIGINT/SIGTERM. SIGUSR1 marks a lap, SIGUSR2 pauses or resumes.
+
+#include "trackerengine.h"
+#include "eventmask.h"
+#include "logger.h"
+#include "sharedstats.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <pthread.h>
+
+namespace {
+
+void printSummary(const TrackerEngine& engine)
+{
+    EngineSnapshot snapshot = engine.snapshot();
+    RateSnapshot rates = engine.rates();
+    EngineDiagnostics diagnostics = engine.diagnostics();
+    StatsSnapshot minute = rates.lastMinute();
+    std::printf("elapsed %.0f s  devices %zu  keys %llu  clicks %llu  scroll %llu  distance %.0f  wpm %.0f\n",
+                snapshot.elapsedSeconds, snapshot.devices,
+                static_cast<unsigned long long>(snapshot.totals.keyboard_count),
+                static_cast<unsigned long long>(snapshot.totals.mouse_count),
+                static_cast<unsigned long long>(snapshot.totals.scroll_count),
+                snapshot.totals.mouse_distance, engine.wordsPerMinute());
+    if (snapshot.totals.stroke_count != 0 || snapshot.totals.gamepad_count != 0 || snapshot.totals.axis_count != 0) {
+        std::printf("  pen strokes %llu  gamepad presses %llu  axis reports %llu\n",
+                    static_cast<unsigned long long>(snapshot.totals.stroke_count),
+                    static_cast<unsigned long long>(snapshot.totals.gamepad_count),
+                    static_cast<unsigned long long>(snapshot.totals.axis_count));
+    }
+    std::printf("  last minute: keys %llu  clicks %llu  scroll %llu  distance %.0f\n",
+                static_cast<unsigned long long>(minute.keyboard_count),
+                static_cast<unsigned long long>(minute.mouse_count),
+                static_cast<unsigned long long>(minute.scroll_count), minute.mouse_distance);
+    for (const DeviceStats& device : engine.deviceStats()) {
+        char firstSeen[16];
+        char lastSeen[16] = "-";
+        time_t when = static_cast<time_t>(device.firstSeen);
+        std::strftime(firstSeen, sizeof(firstSeen), "%H:%M:%S", std::localtime(&when));
+        if (device.lastSeen != 0) {
+            when = static_cast<time_t>(device.lastSeen);
+            std::strftime(lastSeen, sizeof(lastSeen), "%H:%M:%S", std::localtime(&when));
+        }
+        std::printf("  [%2u] %-32s %04x:%04x:%04x%s  keys %llu  clicks %llu  scroll %llu  distance %.0f"
+                    "  first %s  last %s\n",
+                    device.id, device.label.name.c_str(), device.label.bustype, device.label.vendor,
+                    device.label.product, device.attached ? "" : " (gone)",
+                    static_cast<unsigned long long>(device.counts.keyboard_count),
+                    static_cast<unsigned long long>(device.counts.mouse_count),
+                    static_cast<unsigned long long>(device.counts.scroll_count), device.counts.mouse_distance,
+                    firstSeen, lastSeen);
+    }
+    std::printf("  tracker: cpu %.2f s (%.3f%%)  wakeups %.1f/s  latency p50 %.0f us  p99 %.0f us  max %.0f us\n",
+                diagnostics.cpuSeconds, diagnostics.cpuPercent, diagnostics.wakeupsPerSecond,
+                diagnostics.latency.p50, diagnostics.latency.p99, diagnostics.latency.max);
+    for (const DeviceDiagnostics& device : diagnostics.devices) {
+        std::printf("    %-32s p50 %6.0f us  p99 %6.0f us  max %6.0f us  (%llu reports)\n", device.name.c_str(),
+                    device.latency.p50, device.latency.p99, device.latency.max,
+                    static_cast<unsigned long long>(device.latency.count));
+    }
+    std::fflush(stdout);
+}
+
+void printLaps(const TrackerEngine& engine)
+{
+    for (const LapRecord& lap : engine.laps()) {
+        std::printf("lap %u%s  from %.0f s  %.0f s  keys %llu  clicks %llu  scroll %llu  distance %.0f\n", lap.number,
+                    lap.current ? " (current)" : "", lap.startSeconds, lap.seconds,
+                    static_cast<unsigned long long>(lap.counts.keyboard_count),
+                    static_cast<unsigned long long>(lap.counts.mouse_count),
+                    static_cast<unsigned long long>(lap.counts.scroll_count), lap.counts.mouse_distance);
+    }
+    std::fflush(stdout);
+}
+
+// Full-resolution maps; reading them is a copy of the pyramid's base level
+void writeHeatmaps(const TrackerEngine& engine, const std::string& prefix)
+{
+    if (prefix.empty()) {
+        return;
+    }
+    if (!writeHeatmapPgm(engine.heatmap(HeatmapKind::Movement, 0), prefix + "-moves.pgm") ||
+        !writeHeatmapPgm(engine.heatmap(HeatmapKind::Clicks, 0), prefix + "-clicks.pgm")) {
+        std::cerr << "Cannot write heatmaps to " << prefix << "-*.pgm\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Log level: --log-level=<off|info|debug|trace>, or TRACKER_LOG_LEVEL
+    // Raw event recording: --record=<directory>
+    // Summary period: --interval=<seconds>, 0 prints only on exit
+    // Shared-memory export: --shm[=<name>]; Prometheus socket: --metrics-socket=<path>
+    // Heatmaps: --screen=<width>x<height> virtual screen, --heatmap=<prefix>
+    // writes <prefix>-moves.pgm and <prefix>-clicks.pgm with every summary
+    // Long-term per-minute history: --history=<dir>
+    // What to count: --metrics=<keys,clicks,scroll,movement,strokes,gamepad|all>
+    LogLevel level = LogLevel::Info;
+    const char* requested = std::getenv("TRACKER_LOG_LEVEL");
+    EngineOptions options;
+    long interval = 60;
+    std::string heatmapPrefix;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--log-level=", 12) == 0) {
+            requested = argv[i] + 12;
+        } else if (std::strncmp(argv[i], "--record=", 9) == 0) {
+            options.journalDirectory = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--interval=", 11) == 0) {
+            interval = std::strtol(argv[i] + 11, nullptr, 10);
+        } else if (std::strcmp(argv[i], "--shm") == 0) {
+            options.sharedStatsName = SHARED_STATS_DEFAULT_NAME;
+        } else if (std::strncmp(argv[i], "--shm=", 6) == 0) {
+            options.sharedStatsName = argv[i] + 6;
+        } else if (std::strncmp(argv[i], "--metrics-socket=", 17) == 0) {
+            options.metricsSocket = argv[i] + 17;
+        } else if (std::strncmp(argv[i], "--history=", 10) == 0) {
+            options.historyDirectory = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--metrics=", 10) == 0) {
+            if (!parseMetrics(argv[i] + 10, options.metrics)) {
+                std::cerr << "Expected --metrics=<keys,clicks,scroll,movement,strokes,gamepad|all>, got '"
+                          << argv[i] + 10 << "'.\n";
+                return 2;
+            }
+        } else if (std::strncmp(argv[i], "--heatmap=", 10) == 0) {
+            heatmapPrefix = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--screen=", 9) == 0) {
+            if (std::sscanf(argv[i] + 9, "%dx%d", &options.screenWidth, &options.screenHeight) != 2) {
+                std::cerr << "Expected --screen=<width>x<height>, got '" << argv[i] + 9 << "'.\n";
+                return 2;
+            }
+        } else {
+            std::cerr << "usage: TrackerDaemon [--log-level=<level>] [--record=<dir>] [--interval=<seconds>]\n"
+                         "                     [--shm[=<name>]] [--metrics-socket=<path>]\n"
+                         "                     [--screen=<width>x<height>] [--heatmap=<prefix>]\n"
+                         "                     [--history=<dir>] [--metrics=<list>]\n";
+            return 2;
+        }
+    }
+    if (requested && !parseLogLevel(requested, level)) {
+        std::cerr << "Unknown log level '" << requested << "', using info.\n";
+    }
+
+    // Block the stop, lap and pause signals before any thread exists, the
+    // logger's drain thread included, so every thread inherits the mask and
+    // the main thread alone collects them. A thread left without it would
+    // take the signal's default action and end the process.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    Logger::setLevel(level);
+    Logger::instance().start();
+
+    int rc = 0;
+    {
+        TrackerEngine engine(options);
+        if (!engine.start()) {
+            rc = 1;
+        } else {
+            // The main thread sleeps in sigtimedwait() between summaries
+            for (;;) {
+                int signal;
+                if (interval > 0) {
+                    timespec timeout{interval, 0};
+                    signal = sigtimedwait(&signals, nullptr, &timeout);
+                } else {
+                    signal = sigwaitinfo(&signals, nullptr);
+                }
+                if (signal == SIGINT || signal == SIGTERM) {
+                    break;
+                }
+                if (signal == SIGUSR1) {
+                    engine.markLap();
+                    printLaps(engine);
+                } else if (signal == SIGUSR2) {
+                    if (engine.isPaused()) {
+                        engine.resume();
+                    } else {
+                        engine.pause();
+                    }
+                }
+                if (signal < 0 && errno == EAGAIN) {
+                    printSummary(engine);
+                    writeHeatmaps(engine, heatmapPrefix);
+                }
+            }
+            // Before stopping, while the per-device diagnostics still exist
+            printSummary(engine);
+            printLaps(engine);
+            writeHeatmaps(engine, heatmapPrefix);
+            engine.stop();
+        }
+    }
+
+    Logger::instance().stop();
+    return rc;
+}
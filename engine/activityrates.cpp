@@ -0,0 +1,152 @@
+#include "activityrates.h"
+
+#include <algorithm>
+
+StatsSnapshot RateSnapshot::window(RateTier tier, std::size_t periods) const
+{
+    const StatsSnapshot* buckets = seconds.data();
+    std::size_t count = SECOND_BUCKETS;
+    if (tier == RateTier::Minutes) {
+        buckets = minutes.data();
+        count = MINUTE_BUCKETS;
+    } else if (tier == RateTier::Hours) {
+        buckets = hours.data();
+        count = HOUR_BUCKETS;
+    }
+
+    StatsSnapshot total;
+    for (std::size_t i = 0; i < std::min(periods, count); ++i) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+RateSlot::RateSlot()
+{
+    reset();
+}
+
+void RateSlot::add(Bucket& bucket, int64_t period, const StatsSnapshot& delta)
+{
+    if (bucket.period.load(std::memory_order_relaxed) != period) {
+        // Invalidate while the bucket is recycled for the new period
+        bucket.period.store(-1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        clearRelaxed(bucket);
+        bucket.period.store(period, std::memory_order_release);
+    }
+
+    addRelaxed(bucket, delta);
+}
+
+void RateSlot::publish(const StatsSnapshot& delta, int64_t nowSecond)
+{
+    if (delta.empty()) {
+        return;
+    }
+    add(seconds[nowSecond % SECOND_BUCKETS], nowSecond, delta);
+    int64_t minute = nowSecond / 60;
+    add(minutes[minute % MINUTE_BUCKETS], minute, delta);
+    int64_t hour = nowSecond / 3600;
+    add(hours[hour % HOUR_BUCKETS], hour, delta);
+}
+
+// Adds every bucket still inside its ring's window to out[age], where age 0
+// is the current period.
+void RateSlot::collect(const Bucket* buckets, std::size_t count, int64_t periodSeconds, int64_t nowSecond,
+                       StatsSnapshot* out)
+{
+    const int64_t now = nowSecond / periodSeconds;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Bucket& bucket = buckets[i];
+        int64_t period = bucket.period.load(std::memory_order_acquire);
+        int64_t age = now - period;
+        if (period < 0 || age < 0 || age >= static_cast<int64_t>(count)) {
+            continue;
+        }
+
+        StatsSnapshot values = loadRelaxed(bucket);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (bucket.period.load(std::memory_order_relaxed) == period) {
+            out[age] += values;
+        }
+    }
+}
+
+void RateSlot::addTo(RateSnapshot& snapshot, int64_t nowSecond) const
+{
+    collect(seconds, SECOND_BUCKETS, 1, nowSecond, snapshot.seconds.data());
+    collect(minutes, MINUTE_BUCKETS, 60, nowSecond, snapshot.minutes.data());
+    collect(hours, HOUR_BUCKETS, 3600, nowSecond, snapshot.hours.data());
+}
+
+void RateSlot::clear(Bucket& bucket)
+{
+    bucket.period.store(-1, std::memory_order_relaxed);
+    clearRelaxed(bucket);
+}
+
+void RateSlot::reset()
+{
+    for (Bucket& bucket : seconds) {
+        clear(bucket);
+    }
+    for (Bucket& bucket : minutes) {
+        clear(bucket);
+    }
+    for (Bucket& bucket : hours) {
+        clear(bucket);
+    }
+}
+
+ActivityRates::ActivityRates(std::size_t capacity)
+    : capacity(capacity)
+{
+}
+
+RateSlot* ActivityRates::acquireSlot()
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    if (!freeSlots.empty()) {
+        RateSlot* slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if (allSlots.size() >= capacity) {
+        return nullptr;
+    }
+    allSlots.emplace_back(new RateSlot);
+    return allSlots.back().get();
+}
+
+void ActivityRates::releaseSlot(RateSlot* slot)
+{
+    if (slot) {
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        freeSlots.push_back(slot);
+    }
+}
+
+RateSnapshot ActivityRates::snapshot() const
+{
+    RateSnapshot result;
+    int64_t now = currentSecond();
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        slot->addTo(result, now);
+    }
+    return result;
+}
+
+void ActivityRates::reset()
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        slot->reset();
+    }
+    freeSlots.clear();
+    for (const auto& slot : allSlots) {
+        freeSlots.push_back(slot.get());
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef ACTIVITYRATES_H
+#define ACTIVITYRATES_H
+
+#include "statistics.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Three rings of time buckets per producer: the last minute by second, the
+// last hour by minute and the last day by hour.
+enum class RateTier {
+    Seconds,
+    Minutes,
+    Hours
+};
+
+constexpr std::size_t SECOND_BUCKETS = 60;
+constexpr std::size_t MINUTE_BUCKETS = 60;
+constexpr std::size_t HOUR_BUCKETS = 24;
+
+// Aggregated windows. Index 0 is the current, still filling period, index 1
+// the one before, and so on; periods without activity are zero.
+struct RateSnapshot {
+    std::array<StatsSnapshot, SECOND_BUCKETS> seconds;
+    std::array<StatsSnapshot, MINUTE_BUCKETS> minutes;
+    std::array<StatsSnapshot, HOUR_BUCKETS> hours;
+
+    // Sum of the most recent `periods` buckets of a tier
+    StatsSnapshot window(RateTier tier, std::size_t periods) const;
+
+    StatsSnapshot lastMinute() const { return window(RateTier::Seconds, SECOND_BUCKETS); }
+    StatsSnapshot lastHour() const { return window(RateTier::Minutes, MINUTE_BUCKETS); }
+    StatsSnapshot lastDay() const { return window(RateTier::Hours, HOUR_BUCKETS); }
+};
+
+// Rate rings of one producer. Buckets are tagged with the period they hold
+// and recycled lazily: the producer clears a bucket when it first writes to
+// it in a new period, and readers skip buckets whose tag is too old. No
+// timers, a fixed footprint, and every publish touches one bucket per tier.
+//
+// Single writer, like StatsSlot. A reader rechecks a bucket's tag after
+// copying it, so a bucket recycled meanwhile is never mixed into the wrong
+// period.
+class RateSlot
+{
+public:
+    RateSlot();
+
+    RateSlot(const RateSlot&) = delete;
+    RateSlot& operator=(const RateSlot&) = delete;
+
+    // Producer side, once per batch. `nowSecond` is currentSecond().
+    void publish(const StatsSnapshot& delta, int64_t nowSecond);
+
+    // Reader side. Adds this slot's buckets to `snapshot`.
+    void addTo(RateSnapshot& snapshot, int64_t nowSecond) const;
+
+    void reset();
+
+private:
+    struct Bucket {
+        std::atomic<int64_t> period{-1};
+        std::atomic<uint64_t> keyboard_count{0};
+        std::atomic<uint64_t> mouse_count{0};
+        std::atomic<uint64_t> scroll_count{0};
+        std::atomic<uint64_t> stroke_count{0};
+        std::atomic<uint64_t> gamepad_count{0};
+        std::atomic<uint64_t> axis_count{0};
+        std::atomic<double> mouse_distance{0.0};
+        std::atomic<uint64_t> event_count{0};
+    };
+
+    static void add(Bucket& bucket, int64_t period, const StatsSnapshot& delta);
+    static void collect(const Bucket* buckets, std::size_t count, int64_t periodSeconds, int64_t nowSecond,
+                        StatsSnapshot* out);
+    static void clear(Bucket& bucket);
+
+    Bucket seconds[SECOND_BUCKETS];
+    Bucket minutes[MINUTE_BUCKETS];
+    Bucket hours[HOUR_BUCKETS];
+};
+
+// Pool of rate slots, one per device, allocated as devices attach. Released
+// slots keep their buckets and are handed out again, like StatsCore.
+class ActivityRates
+{
+public:
+    explicit ActivityRates(std::size_t capacity = 256);
+
+    ActivityRates(const ActivityRates&) = delete;
+    ActivityRates& operator=(const ActivityRates&) = delete;
+
+    // Returns nullptr when every slot is taken
+    RateSlot* acquireSlot();
+    void releaseSlot(RateSlot* slot);
+
+    RateSnapshot snapshot() const;
+
+    // Zeroes every slot and releases them. Only call while no producer runs.
+    void reset();
+
+private:
+    std::size_t capacity;
+    mutable std::mutex slotsMutex;
+    std::vector<std::unique_ptr<RateSlot>> allSlots;
+    std::vector<RateSlot*> freeSlots;
+};
+
+#endif // ACTIVITYRATES_H
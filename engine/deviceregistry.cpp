@@ -0,0 +1,391 @@
+#include "deviceregistry.h"
+
+#include <libevdev/libevdev.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+constexpr unsigned MAX_PROBE_THREADS = 8;
+// First line of the cache file; entries written by an older classifier
+// are probed again
+constexpr const char* CACHE_HEADER = "# knm capabilities 2";
+
+namespace {
+
+// Cache lines are tab separated, so keep tabs and newlines out of the key
+std::string sanitize(const char* text)
+{
+    std::string result(text);
+    std::replace(result.begin(), result.end(), '\t', ' ');
+    std::replace(result.begin(), result.end(), '\n', ' ');
+    return result;
+}
+
+// The tracker usually runs as root: only use a cache directory that is
+// ours, is not a link and that nobody else can write to, or another user
+// could swap the cache for a link and have root overwrite its target
+bool trustedDirectory(const std::string& directory)
+{
+    struct stat info;
+    return lstat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode) && info.st_uid == geteuid() &&
+           !(info.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+std::string directoryOf(const std::string& path)
+{
+    std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+DeviceIdentity readIdentity(int fd)
+{
+    DeviceIdentity identity;
+
+    input_id id;
+    if (ioctl(fd, EVIOCGID, &id) >= 0) {
+        identity.bustype = id.bustype;
+        identity.vendor = id.vendor;
+        identity.product = id.product;
+        identity.version = id.version;
+    }
+
+    char buffer[256];
+    std::memset(buffer, 0, sizeof(buffer));
+    if (ioctl(fd, EVIOCGNAME(sizeof(buffer) - 1), buffer) >= 0) {
+        identity.name = sanitize(buffer);
+    }
+    std::memset(buffer, 0, sizeof(buffer));
+    if (ioctl(fd, EVIOCGPHYS(sizeof(buffer) - 1), buffer) >= 0) {
+        identity.phys = sanitize(buffer);
+    }
+    std::memset(buffer, 0, sizeof(buffer));
+    if (ioctl(fd, EVIOCGUNIQ(sizeof(buffer) - 1), buffer) >= 0) {
+        identity.uniq = sanitize(buffer);
+    }
+    return identity;
+}
+
+bool isKeyboard(libevdev* dev)
+{
+    return libevdev_has_event_type(dev, EV_KEY) &&
+           (libevdev_has_event_code(dev, EV_KEY, KEY_A) ||
+            libevdev_has_event_code(dev, EV_KEY, KEY_SPACE) ||
+            libevdev_has_event_code(dev, EV_KEY, KEY_ENTER));
+}
+
+// Touchpads report contacts with the multitouch protocol and a finger tool;
+// touchscreens (INPUT_PROP_DIRECT) have no cursor to track
+bool isTouchpad(libevdev* dev)
+{
+    return libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_X) &&
+           libevdev_has_event_code(dev, EV_KEY, BTN_TOOL_FINGER) &&
+           !libevdev_has_event_code(dev, EV_KEY, BTN_TOOL_PEN) && !libevdev_has_property(dev, INPUT_PROP_DIRECT);
+}
+
+bool isTablet(libevdev* dev)
+{
+    return libevdev_has_event_code(dev, EV_KEY, BTN_TOOL_PEN) && libevdev_has_event_code(dev, EV_ABS, ABS_X);
+}
+
+bool isGamepad(libevdev* dev)
+{
+    return libevdev_has_event_code(dev, EV_KEY, BTN_GAMEPAD) || libevdev_has_event_code(dev, EV_KEY, BTN_JOYSTICK);
+}
+
+bool isMouse(libevdev* dev)
+{
+    bool has_mouse_buttons = libevdev_has_event_type(dev, EV_KEY) &&
+                             (libevdev_has_event_code(dev, EV_KEY, BTN_LEFT) ||
+                              libevdev_has_event_code(dev, EV_KEY, BTN_RIGHT) ||
+                              libevdev_has_event_code(dev, EV_KEY, BTN_MIDDLE));
+
+    bool has_scroll = libevdev_has_event_type(dev, EV_REL) &&
+                      libevdev_has_event_code(dev, EV_REL, REL_WHEEL);
+
+    bool has_motion = libevdev_has_event_type(dev, EV_REL) &&
+                      (libevdev_has_event_code(dev, EV_REL, REL_X) ||
+                       libevdev_has_event_code(dev, EV_REL, REL_Y));
+
+    return has_mouse_buttons || has_scroll || has_motion;
+}
+
+} // namespace
+
+std::string DeviceIdentity::key() const
+{
+    char id[32];
+    std::snprintf(id, sizeof(id), "%04x:%04x:%04x:%04x", bustype, vendor, product, version);
+    return std::string(id) + "|" + name + "|" + phys + "|" + uniq;
+}
+
+InputDevice::~InputDevice()
+{
+    if (dev) {
+        libevdev_free(dev);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+DeviceRegistry::DeviceRegistry(std::string cachePath)
+    : cachePath(std::move(cachePath))
+{
+    load();
+}
+
+std::string DeviceRegistry::defaultCachePath()
+{
+    // Root's cache stays out of the invoking user's home
+    if (geteuid() == 0) {
+        return "/var/cache/knm_tracker/devices.cache";
+    }
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome) {
+        return std::string(cacheHome) + "/knm_tracker/devices.cache";
+    }
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        return std::string(home) + "/.cache/knm_tracker/devices.cache";
+    }
+    return std::string();
+}
+
+bool DeviceRegistry::load()
+{
+    if (cachePath.empty() || !trustedDirectory(directoryOf(cachePath))) {
+        return false;
+    }
+    std::ifstream in(cachePath);
+    if (!in) {
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(in, line) || line != CACHE_HEADER) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    while (std::getline(in, line)) {
+        if (line.size() < 3 || line[1] != '\t') {
+            continue;
+        }
+        char c = line[0];
+        switch (static_cast<Capability>(c)) {
+        case Capability::Keyboard:
+        case Capability::Mouse:
+        case Capability::Touchpad:
+        case Capability::Tablet:
+        case Capability::Gamepad:
+        case Capability::Other:
+            cache[line.substr(2)] = static_cast<Capability>(c);
+            break;
+        }
+    }
+    return true;
+}
+
+bool DeviceRegistry::save()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!dirty || cachePath.empty()) {
+        return true;
+    }
+
+    // mkdir -p for the cache directory
+    for (std::size_t slash = cachePath.find('/', 1); slash != std::string::npos;
+         slash = cachePath.find('/', slash + 1)) {
+        mkdir(cachePath.substr(0, slash).c_str(), 0755);
+    }
+    const std::string directory = directoryOf(cachePath);
+    if (!trustedDirectory(directory)) {
+        std::cerr << "[registry] Not writing capability cache: " << directory
+                  << " is not a plain directory writable only by this user\n";
+        return false;
+    }
+
+    std::string contents = CACHE_HEADER;
+    contents += '\n';
+    for (const auto& entry : cache) {
+        contents += static_cast<char>(entry.second);
+        contents += '\t';
+        contents += entry.first;
+        contents += '\n';
+    }
+
+    // A fresh file (O_EXCL, so never through a planted link), renamed over
+    // the old cache
+    std::string tmpPath = cachePath + ".XXXXXX";
+    int fd = mkostemp(&tmpPath[0], O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[registry] Cannot write capability cache " << tmpPath << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    bool written = fchmod(fd, 0644) == 0;
+    for (std::size_t done = 0; written && done < contents.size();) {
+        ssize_t n = ::write(fd, contents.data() + done, contents.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        written = n > 0;
+        done += written ? static_cast<std::size_t>(n) : 0;
+    }
+    if (::close(fd) != 0) {
+        written = false;
+    }
+    if (!written) {
+        std::cerr << "[registry] Cannot write capability cache " << tmpPath << ": " << strerror(errno) << "\n";
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        std::cerr << "[registry] Cannot replace capability cache " << cachePath << ": " << strerror(errno) << "\n";
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+std::unique_ptr<InputDevice> DeviceRegistry::open(const std::string& path, bool& fromCache)
+{
+    fromCache = false;
+
+    std::unique_ptr<InputDevice> device(new InputDevice);
+    device->path = path;
+    device->fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (device->fd < 0) {
+        std::cerr << "Failed to open " << path << ": " << strerror(errno) << "\n";
+        return nullptr;
+    }
+    device->identity = readIdentity(device->fd);
+    const std::string key = device->identity.key();
+
+    Capability capability = Capability::Other;
+    bool known = false;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            capability = it->second;
+            known = true;
+        }
+    }
+
+    if (known) {
+        fromCache = true;
+    } else {
+        int rc = libevdev_new_from_fd(device->fd, &device->dev);
+        if (rc < 0) {
+            std::cerr << "libevdev init failed for " << path << ": " << strerror(-rc) << "\n";
+            device->dev = nullptr;
+            return nullptr;
+        }
+        // Touchpads and tablets also have mouse buttons, so they go first
+        if (isKeyboard(device->dev)) {
+            capability = Capability::Keyboard;
+        } else if (isTablet(device->dev)) {
+            capability = Capability::Tablet;
+        } else if (isTouchpad(device->dev)) {
+            capability = Capability::Touchpad;
+        } else if (isGamepad(device->dev)) {
+            capability = Capability::Gamepad;
+        } else if (isMouse(device->dev)) {
+            capability = Capability::Mouse;
+        }
+
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache[key] = capability;
+        dirty = true;
+    }
+
+    switch (capability) {
+    case Capability::Keyboard:
+        device->type = DeviceType::Keyboard;
+        return device;
+    case Capability::Mouse:
+        device->type = DeviceType::Mouse;
+        return device;
+    case Capability::Touchpad:
+        device->type = DeviceType::Touchpad;
+        return device;
+    case Capability::Tablet:
+        device->type = DeviceType::Tablet;
+        return device;
+    case Capability::Gamepad:
+        device->type = DeviceType::Gamepad;
+        return device;
+    case Capability::Other:
+        break;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<InputDevice> DeviceRegistry::probe(const std::string& path)
+{
+    bool fromCache;
+    return open(path, fromCache);
+}
+
+std::vector<std::unique_ptr<InputDevice>> DeviceRegistry::probe(const std::vector<std::string>& paths,
+                                                                ProbeReport* report)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::unique_ptr<InputDevice>> results(paths.size());
+    std::unique_ptr<bool[]> fromCache(new bool[paths.size()]());
+    std::atomic<std::size_t> next{0};
+
+    auto worker = [&]() {
+        for (std::size_t i = next.fetch_add(1); i < paths.size(); i = next.fetch_add(1)) {
+            results[i] = open(paths[i], fromCache[i]);
+        }
+    };
+
+    // Opening a node and building a libevdev context is mostly syscalls, so
+    // a handful of threads hides the latency on hosts with many nodes.
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t threadCount = std::min<std::size_t>(paths.size(), std::min(MAX_PROBE_THREADS, cores));
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::vector<std::unique_ptr<InputDevice>> devices;
+    ProbeReport summary;
+    summary.nodes = paths.size();
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        if (fromCache[i]) {
+            summary.cached++;
+        } else {
+            summary.probed++;
+        }
+        if (results[i]) {
+            devices.push_back(std::move(results[i]));
+        }
+    }
+    summary.monitored = devices.size();
+    summary.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    if (report) {
+        *report = summary;
+    }
+    return devices;
+}
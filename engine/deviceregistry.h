@@ -0,0 +1,94 @@
+#ifndef DEVICEREGISTRY_H
+#define DEVICEREGISTRY_H
+
+#include "eventprocessor.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct libevdev;
+
+// What the kernel tells us about a node without building a libevdev context
+struct DeviceIdentity {
+    uint16_t bustype = 0;
+    uint16_t vendor = 0;
+    uint16_t product = 0;
+    uint16_t version = 0;
+    std::string name;
+    std::string phys;
+    std::string uniq;
+
+    // Stable across reboots and re-plugs of the same hardware
+    std::string key() const;
+};
+
+// An opened input node. Owns the fd (and the libevdev handle, if probing
+// needed one) until it is destroyed.
+struct InputDevice {
+    std::string path;
+    DeviceIdentity identity;
+    DeviceType type = DeviceType::Keyboard;
+    int fd = -1;
+    libevdev* dev = nullptr;
+
+    InputDevice() = default;
+    InputDevice(const InputDevice&) = delete;
+    InputDevice& operator=(const InputDevice&) = delete;
+    ~InputDevice();
+};
+
+struct ProbeReport {
+    std::size_t nodes = 0;
+    std::size_t cached = 0;     // classified from the capability cache
+    std::size_t probed = 0;     // needed a full libevdev probe
+    std::size_t monitored = 0;  // devices of a known class handed back
+    double milliseconds = 0.0;
+};
+
+// Opens every node exactly once and classifies it. Capability results are
+// cached by device identity, in memory and in a small file, so a warm start
+// only costs open() plus a few ioctls per node. Nodes missing from the
+// cache get a full libevdev probe, run in parallel.
+class DeviceRegistry
+{
+public:
+    explicit DeviceRegistry(std::string cachePath = defaultCachePath());
+
+    // Returns the keyboards, mice, touchpads, tablets and gamepads among
+    // `paths`, opened and ready to be read. Everything else is closed again.
+    std::vector<std::unique_ptr<InputDevice>> probe(const std::vector<std::string>& paths,
+                                                    ProbeReport* report = nullptr);
+    std::unique_ptr<InputDevice> probe(const std::string& path);
+
+    // Refuses a cache directory that is a link, belongs to another user
+    // or is writable by others
+    bool save();
+
+    // /var/cache/knm_tracker when run as root, else under $XDG_CACHE_HOME
+    // or ~/.cache
+    static std::string defaultCachePath();
+
+private:
+    enum class Capability : char {
+        Keyboard = 'k',
+        Mouse = 'm',
+        Touchpad = 't',
+        Tablet = 'p',
+        Gamepad = 'g',
+        Other = '-'
+    };
+
+    bool load();
+    std::unique_ptr<InputDevice> open(const std::string& path, bool& fromCache);
+
+    std::string cachePath;
+    std::mutex cacheMutex;
+    std::map<std::string, Capability> cache;
+    bool dirty = false;
+};
+
+#endif // DEVICEREGISTRY_H
@@ -0,0 +1,88 @@
+#include "devicewatcher.h"
+#include "eventengine.h"
+#include "logger.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+DeviceWatcher::DeviceWatcher(std::string directory, AddedHandler onAdded)
+    : directory(std::move(directory)),
+    onAdded(std::move(onAdded))
+{
+    if (!this->directory.empty() && this->directory.back() != '/') {
+        this->directory += '/';
+    }
+}
+
+DeviceWatcher::~DeviceWatcher()
+{
+    stop();
+}
+
+bool DeviceWatcher::start(EventEngine& engine)
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "[hotplug] inotify_init1 failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    // IN_ATTRIB catches udev fixing up permissions after the node appears
+    if (inotify_add_watch(inotifyFd, directory.c_str(), IN_CREATE | IN_ATTRIB | IN_MOVED_TO) < 0) {
+        std::cerr << "[hotplug] Cannot watch " << directory << ": " << strerror(errno) << "\n";
+        stop();
+        return false;
+    }
+
+    if (!engine.addSource(inotifyFd, [this](int fd) { return handleNotifications(fd); })) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void DeviceWatcher::stop()
+{
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+        inotifyFd = -1;
+    }
+}
+
+bool DeviceWatcher::handleNotifications(int fd)
+{
+    alignas(inotify_event) char buffer[4096];
+
+    for (;;) {
+        ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN;
+        }
+        if (bytes == 0) {
+            return true;
+        }
+
+        for (ssize_t offset = 0; offset < bytes;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                Logger::log(LogLevel::Info, "[hotplug] inotify queue overflowed, some devices may be missed");
+                continue;
+            }
+            if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+            if (std::strncmp(event->name, "event", 5) != 0) {
+                continue;
+            }
+            onAdded(directory + event->name);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef DEVICEWATCHER_H
+#define DEVICEWATCHER_H
+
+#include <functional>
+#include <string>
+
+class EventEngine;
+
+// Watches the input device directory with inotify and reports event nodes
+// as they appear. The inotify fd is just another source on the event
+// engine, so hotplug needs no thread of its own and costs nothing while
+// nothing is plugged in.
+//
+// Removal is not reported here: when a device goes away the kernel wakes
+// its readers and read() fails with ENODEV, which detaches the device on
+// the worker that owns it.
+class DeviceWatcher
+{
+public:
+    // Called on an engine worker with the absolute path of the node. It may
+    // fire more than once per node (creation, then permission changes made
+    // by udev), so the callback must ignore paths it already handles.
+    using AddedHandler = std::function<void(const std::string& path)>;
+
+    DeviceWatcher(std::string directory, AddedHandler onAdded);
+    ~DeviceWatcher();
+
+    DeviceWatcher(const DeviceWatcher&) = delete;
+    DeviceWatcher& operator=(const DeviceWatcher&) = delete;
+
+    bool start(EventEngine& engine);
+    void stop();
+
+private:
+    bool handleNotifications(int fd);
+
+    std::string directory;
+    AddedHandler onAdded;
+    int inotifyFd = -1;
+};
+
+#endif // DEVICEWATCHER_H
@@ -0,0 +1,9 @@
+# Included by every target that links the tracking engine
+INCLUDEPATH += $$PWD /usr/include/libevdev-1.0
+DEPENDPATH += $$PWD
+
+ENGINE_OUT = $$shadowed($$PWD)
+LIBS += -L$$ENGINE_OUT -ltrackerengine
+PRE_TARGETDEPS += $$ENGINE_OUT/libtrackerengine.a
+
+unix:!macx: LIBS += -levdev -lpthread -lrt
@@ -0,0 +1,50 @@
+CONFIG += c++17 staticlib
+CONFIG -= qt
+
+TARGET = trackerengine
+TEMPLATE = lib
+
+# Everything that tracks input, free of Qt so the GUI, the daemon and the
+# benchmarks all link the same code.
+SOURCES += \
+    trackerengine.cpp \
+    typingstats.cpp \
+    activityrates.cpp \
+    heatmap.cpp \
+    latencyhistogram.cpp \
+    sharedstats.cpp \
+    statsexporter.cpp \
+    rollupstore.cpp \
+    historyrecorder.cpp \
+    eventengine.cpp \
+    statistics.cpp \
+    logger.cpp \
+    eventprocessor.cpp \
+    eventmask.cpp \
+    devicewatcher.cpp \
+    deviceregistry.cpp \
+    eventjournal.cpp \
+    eventsource.cpp
+
+HEADERS += \
+    trackerengine.h \
+    typingstats.h \
+    activityrates.h \
+    heatmap.h \
+    latencyhistogram.h \
+    sharedstats.h \
+    statsexporter.h \
+    rollupstore.h \
+    historyrecorder.h \
+    eventengine.h \
+    statistics.h \
+    logger.h \
+    eventprocessor.h \
+    eventdispatch.h \
+    eventmask.h \
+    devicewatcher.h \
+    deviceregistry.h \
+    eventjournal.h \
+    eventsource.h
+
+INCLUDEPATH += /usr/include/libevdev-1.0
@@ -0,0 +1,193 @@
+#ifndef EVENTDISPATCH_H
+#define EVENTDISPATCH_H
+
+#include "eventprocessor.h"
+
+#include <linux/input.h>
+#include <cstddef>
+#include <cstdint>
+
+// What one (type, code) pair means to a device class. EventProcessor
+// switches on these instead of testing type and code in turn.
+enum class EventAction : uint8_t {
+    Ignore = 0,
+    Report,         // SYN_REPORT, end of a frame
+    Dropped,        // SYN_DROPPED
+    Key,            // key state only
+    KeyPress,       // keyboard key
+    Click,          // counted pointer or stylus button
+    PenTouch,       // tablet pen tip down/up: a stroke
+    PadButton,      // gamepad or joystick button
+    PadHat,         // d-pad reported as a hat axis
+    PadAxis,        // stick or trigger: an axis report per frame
+    MoveX,          // relative pointer motion
+    MoveY,
+    Wheel,          // wheel steps
+    TouchSlot,      // multitouch protocol B
+    TouchId,
+    TouchX,
+    TouchY
+};
+
+// The metrics an action feeds; the rest are bookkeeping every metric needs
+constexpr MetricSet actionMetrics(EventAction action)
+{
+    switch (action) {
+    case EventAction::KeyPress:
+        return METRIC_KEYS;
+    case EventAction::Click:
+        return METRIC_CLICKS;
+    case EventAction::PenTouch:
+        return METRIC_STROKES;
+    case EventAction::PadButton:
+    case EventAction::PadHat:
+    case EventAction::PadAxis:
+        return METRIC_GAMEPAD;
+    case EventAction::MoveX:
+    case EventAction::MoveY:
+        return METRIC_MOVEMENT;
+    case EventAction::Wheel:
+        return METRIC_SCROLL;
+    case EventAction::TouchSlot:
+    case EventAction::TouchId:
+    case EventAction::TouchX:
+    case EventAction::TouchY:
+        return METRIC_MOVEMENT | METRIC_SCROLL;
+    default:
+        return 0;
+    }
+}
+
+// Codes per type row of a DispatchTable; covers KEY_CNT, the largest
+constexpr std::size_t DISPATCH_ROW = 1024;
+
+// A flat (type, code) -> action table for one device class, one row per
+// type up to EV_ABS so that a lookup is two compares and a single load.
+// Everything outside the rows is Ignore.
+struct DispatchTable {
+    EventAction actions[(EV_ABS + 1) * DISPATCH_ROW] = {};
+
+    EventAction lookup(uint16_t type, uint16_t code) const {
+        if (type > EV_ABS || code >= DISPATCH_ROW) {
+            return EventAction::Ignore;
+        }
+        return actions[type * DISPATCH_ROW + code];
+    }
+
+    constexpr void setRange(uint16_t type, uint16_t from, uint16_t to, EventAction action) {
+        for (uint16_t code = from; code <= to; ++code) {
+            actions[type * DISPATCH_ROW + code] = action;
+        }
+    }
+};
+
+static_assert(KEY_CNT <= DISPATCH_ROW && ABS_CNT <= DISPATCH_ROW, "a type's codes must fit one row");
+static_assert(EV_SYN == 0 && EV_KEY == 1 && EV_REL == 2 && EV_ABS == 3, "rows are the first four types");
+
+constexpr DispatchTable makeDispatchTable(DeviceType type)
+{
+    DispatchTable table;
+    table.setRange(EV_SYN, SYN_REPORT, SYN_REPORT, EventAction::Report);
+    table.setRange(EV_SYN, SYN_DROPPED, SYN_DROPPED, EventAction::Dropped);
+    // Every key keeps its state for resyncs, counted or not
+    table.setRange(EV_KEY, 0, KEY_MAX, EventAction::Key);
+
+    switch (type) {
+    case DeviceType::Keyboard:
+        table.setRange(EV_KEY, 0, KEY_MAX, EventAction::KeyPress);
+        break;
+    case DeviceType::Mouse:
+        table.setRange(EV_KEY, BTN_LEFT, BTN_MIDDLE, EventAction::Click);
+        table.setRange(EV_REL, REL_X, REL_X, EventAction::MoveX);
+        table.setRange(EV_REL, REL_Y, REL_Y, EventAction::MoveY);
+        table.setRange(EV_REL, REL_HWHEEL, REL_HWHEEL, EventAction::Wheel);
+        table.setRange(EV_REL, REL_WHEEL, REL_WHEEL, EventAction::Wheel);
+        break;
+    case DeviceType::Touchpad:
+        // Physical buttons and clickpad presses; taps are a libinput feature
+        table.setRange(EV_KEY, BTN_LEFT, BTN_MIDDLE, EventAction::Click);
+        table.setRange(EV_ABS, ABS_MT_SLOT, ABS_MT_SLOT, EventAction::TouchSlot);
+        table.setRange(EV_ABS, ABS_MT_TRACKING_ID, ABS_MT_TRACKING_ID, EventAction::TouchId);
+        table.setRange(EV_ABS, ABS_MT_POSITION_X, ABS_MT_POSITION_X, EventAction::TouchX);
+        table.setRange(EV_ABS, ABS_MT_POSITION_Y, ABS_MT_POSITION_Y, EventAction::TouchY);
+        break;
+    case DeviceType::Tablet:
+        table.setRange(EV_KEY, BTN_TOUCH, BTN_TOUCH, EventAction::PenTouch);
+        table.setRange(EV_KEY, BTN_STYLUS, BTN_STYLUS2, EventAction::Click);
+        break;
+    case DeviceType::Gamepad:
+        table.setRange(EV_KEY, BTN_JOYSTICK, BTN_THUMBR, EventAction::PadButton);
+        table.setRange(EV_KEY, BTN_DPAD_UP, BTN_DPAD_RIGHT, EventAction::PadButton);
+        table.setRange(EV_KEY, BTN_TRIGGER_HAPPY1, BTN_TRIGGER_HAPPY40, EventAction::PadButton);
+        table.setRange(EV_ABS, ABS_X, ABS_BRAKE, EventAction::PadAxis);
+        table.setRange(EV_ABS, ABS_HAT0X, ABS_HAT3Y, EventAction::PadHat);
+        break;
+    }
+    return table;
+}
+
+// Built at compile time, one per class
+template <DeviceType Type>
+inline constexpr DispatchTable DISPATCH_TABLE = makeDispatchTable(Type);
+
+// Keyboards and mice send nearly every event, so their handlers test type
+// and code in turn as the old cascade did: a table load followed by a jump
+// on the action was slower for them. The tables above still decide the
+// kernel mask; TrackerBench dispatch checks that both agree.
+template <DeviceType Type>
+constexpr bool DIRECT_DISPATCH = Type == DeviceType::Keyboard || Type == DeviceType::Mouse;
+
+template <DeviceType Type>
+inline EventAction directAction(uint16_t type, uint16_t code)
+{
+    static_assert(DIRECT_DISPATCH<Type>, "other classes use their table");
+    switch (type) {
+    case EV_KEY:
+        if (code >= KEY_CNT) {
+            return EventAction::Ignore;
+        }
+        if constexpr (Type == DeviceType::Keyboard) {
+            return EventAction::KeyPress;
+        } else {
+            return code >= BTN_LEFT && code <= BTN_MIDDLE ? EventAction::Click : EventAction::Key;
+        }
+    case EV_REL:
+        if constexpr (Type == DeviceType::Mouse) {
+            if (code == REL_X) {
+                return EventAction::MoveX;
+            }
+            if (code == REL_Y) {
+                return EventAction::MoveY;
+            }
+            if (code == REL_WHEEL || code == REL_HWHEEL) {
+                return EventAction::Wheel;
+            }
+        }
+        return EventAction::Ignore;
+    case EV_SYN:
+        if (code == SYN_REPORT) {
+            return EventAction::Report;
+        }
+        return code == SYN_DROPPED ? EventAction::Dropped : EventAction::Ignore;
+    default:
+        return EventAction::Ignore;
+    }
+}
+
+inline const DispatchTable& dispatchTable(DeviceType type)
+{
+    switch (type) {
+    case DeviceType::Mouse:
+        return DISPATCH_TABLE<DeviceType::Mouse>;
+    case DeviceType::Touchpad:
+        return DISPATCH_TABLE<DeviceType::Touchpad>;
+    case DeviceType::Tablet:
+        return DISPATCH_TABLE<DeviceType::Tablet>;
+    case DeviceType::Gamepad:
+        return DISPATCH_TABLE<DeviceType::Gamepad>;
+    default:
+        return DISPATCH_TABLE<DeviceType::Keyboard>;
+    }
+}
+
+#endif // EVENTDISPATCH_H
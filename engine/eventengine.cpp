@@ -0,0 +1,216 @@
+#include "eventengine.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+constexpr int MAX_EPOLL_EVENTS = 32;
+
+EventEngine::EventEngine(unsigned workerCount)
+    : workerCount(workerCount == 0 ? 1 : workerCount)
+{
+}
+
+EventEngine::~EventEngine()
+{
+    stop();
+}
+
+bool EventEngine::start()
+{
+    if (running.load()) {
+        return true;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        std::cerr << "[engine] epoll_create1 failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    // The wake fd is registered level-triggered and never read, so once it is
+    // signalled every worker sees it and leaves its loop.
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd < 0) {
+        std::cerr << "[engine] eventfd failed: " << strerror(errno) << "\n";
+        ::close(epollFd);
+        epollFd = -1;
+        return false;
+    }
+
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) < 0) {
+        std::cerr << "[engine] Failed to register wake fd: " << strerror(errno) << "\n";
+        ::close(wakeFd);
+        ::close(epollFd);
+        wakeFd = epollFd = -1;
+        return false;
+    }
+
+    wakeupCount = 0;
+    paused = false;
+    running = true;
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&EventEngine::workerLoop, this);
+    }
+    return true;
+}
+
+void EventEngine::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    uint64_t one = 1;
+    if (::write(wakeFd, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "[engine] Failed to signal workers: " << strerror(errno) << "\n";
+    }
+
+    for (auto& t : workers) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    workers.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(sourcesMutex);
+        for (Source* source : sources) {
+            delete source;
+        }
+        sources.clear();
+    }
+
+    ::close(wakeFd);
+    ::close(epollFd);
+    wakeFd = epollFd = -1;
+}
+
+bool EventEngine::addSource(int fd, ReadyHandler handler, RemovedHandler onRemoved, ResumeHandler onResume)
+{
+    if (epollFd < 0) {
+        return false;
+    }
+
+    Source* source = new Source{fd, std::move(handler), std::move(onRemoved), std::move(onResume)};
+    {
+        std::lock_guard<std::mutex> lock(sourcesMutex);
+        sources.push_back(source);
+    }
+
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = source;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::cerr << "[engine] Failed to add fd " << fd << ": " << strerror(errno) << "\n";
+        std::lock_guard<std::mutex> lock(sourcesMutex);
+        sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+        delete source;
+        return false;
+    }
+    return true;
+}
+
+bool EventEngine::rearm(Source* source)
+{
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = source;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, source->fd, &ev) == 0;
+}
+
+void EventEngine::pause()
+{
+    paused = true;
+}
+
+void EventEngine::resume()
+{
+    // Under the mutex so a worker deciding whether to park sees either the
+    // old state (and its source is picked up here) or the new one
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    paused = false;
+    for (Source* source : sources) {
+        if (!source->parked) {
+            continue;
+        }
+        source->parked = false;
+        if (source->onResume) {
+            source->onResume(source->fd);
+        }
+        if (!rearm(source)) {
+            std::cerr << "[engine] Failed to re-arm fd " << source->fd << ": " << strerror(errno) << "\n";
+        }
+    }
+}
+
+// Leaves a ready source disarmed while paused. Returns false if the engine
+// was resumed meanwhile and the source should be handled normally.
+bool EventEngine::park(Source* source)
+{
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    if (!paused.load()) {
+        return false;
+    }
+    source->parked = true;
+    return true;
+}
+
+void EventEngine::dropSource(Source* source)
+{
+    // Remove from the set before anyone closes the fd, so a recycled fd
+    // number can never be mistaken for this source.
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, source->fd, nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(sourcesMutex);
+        sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+    }
+    if (source->onRemoved) {
+        source->onRemoved(source->fd);
+    }
+    delete source;
+}
+
+void EventEngine::workerLoop()
+{
+    epoll_event events[MAX_EPOLL_EVENTS];
+
+    while (running.load()) {
+        int n = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "[engine] epoll_wait failed: " << strerror(errno) << "\n";
+            break;
+        }
+
+        wakeupCount.fetch_add(1, std::memory_order_relaxed);
+
+        for (int i = 0; i < n; ++i) {
+            Source* source = static_cast<Source*>(events[i].data.ptr);
+            if (source == nullptr) {
+                return;
+            }
+            if (paused.load(std::memory_order_relaxed) && park(source)) {
+                continue;
+            }
+
+            if (source->handler(source->fd) && rearm(source)) {
+                continue;
+            }
+            dropSource(source);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef EVENTENGINE_H
+#define EVENTENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Waits on every registered file descriptor with a single epoll set.
+// Workers sleep in epoll_wait() until the kernel has data for one of the
+// sources, so an idle session costs no wakeups at all. Sources are armed
+// EPOLLONESHOT: a given fd is only ever handled by one worker at a time,
+// which lets handlers keep per-device state without locking.
+class EventEngine
+{
+public:
+    // Called on a worker thread when the fd becomes readable. The handler
+    // should drain the fd until EAGAIN. Returning false removes the source.
+    using ReadyHandler = std::function<bool(int fd)>;
+    // Called on the worker after a source was removed from the epoll set
+    // because its ReadyHandler returned false. The fd may be closed here.
+    using RemovedHandler = std::function<void(int fd)>;
+    // Called on the resuming thread for a source that became readable while
+    // paused, before it is armed again; no worker touches the fd meanwhile.
+    using ResumeHandler = std::function<void(int fd)>;
+
+    explicit EventEngine(unsigned workerCount = 1);
+    ~EventEngine();
+
+    EventEngine(const EventEngine&) = delete;
+    EventEngine& operator=(const EventEngine&) = delete;
+
+    bool start();
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    bool addSource(int fd, ReadyHandler handler, RemovedHandler onRemoved = RemovedHandler(),
+                   ResumeHandler onResume = ResumeHandler());
+
+    // While paused, a source that becomes readable is parked instead of
+    // handled and is not re-armed, so it costs one wakeup however much
+    // input arrives. Sources stay registered and their fds open.
+    void pause();
+    // Runs the resume handler of every parked source, then arms it again.
+    // Returns at once; nothing waits for the workers.
+    void resume();
+    bool isPaused() const { return paused.load(); }
+
+    // Number of times any worker returned from epoll_wait() with work to do.
+    uint64_t wakeups() const { return wakeupCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Source {
+        int fd;
+        ReadyHandler handler;
+        RemovedHandler onRemoved;
+        ResumeHandler onResume;
+        bool parked = false;     // guarded by sourcesMutex
+    };
+
+    void workerLoop();
+    bool rearm(Source* source);
+    bool park(Source* source);
+    void dropSource(Source* source);
+
+    unsigned workerCount;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> running{false};
+    std::atomic<bool> paused{false};
+    std::atomic<uint64_t> wakeupCount{0};
+    std::vector<std::thread> workers;
+
+    std::mutex sourcesMutex;
+    std::vector<Source*> sources;
+};
+
+#endif // EVENTENGINE_H
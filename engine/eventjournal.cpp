@@ -0,0 +1,349 @@
+#include "eventjournal.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <new>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+namespace {
+
+// Offsets are 32-bit microseconds; rotate well before they could wrap
+constexpr uint64_t MAX_SEGMENT_SPAN_US = 4000ull * 1000000ull;
+constexpr uint64_t MIN_SEGMENT_RECORDS = 1024;
+
+int64_t clockUs(clockid_t clock)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+bool isJournalled(uint16_t type)
+{
+    return type == EV_SYN || type == EV_KEY || type == EV_REL || type == EV_ABS;
+}
+
+void makeDirectories(const std::string& path)
+{
+    for (std::size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+    mkdir(path.c_str(), 0755);
+}
+
+} // namespace
+
+EventJournal::EventJournal(JournalOptions options)
+    : options(std::move(options))
+{
+}
+
+EventJournal::~EventJournal()
+{
+    close();
+}
+
+std::string EventJournal::segmentFileName(uint64_t index)
+{
+    char name[40];
+    std::snprintf(name, sizeof(name), "segment-%06llu.knmj", static_cast<unsigned long long>(index));
+    return name;
+}
+
+bool EventJournal::open()
+{
+    if (opened) {
+        return true;
+    }
+    if (options.directory.empty()) {
+        return false;
+    }
+    makeDirectories(options.directory);
+
+    // Continue numbering after whatever an earlier session left behind
+    nextIndex = 0;
+    if (DIR* dir = opendir(options.directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            unsigned long long index;
+            if (std::sscanf(entry->d_name, "segment-%llu.knmj", &index) == 1) {
+                nextIndex = std::max<uint64_t>(nextIndex, index + 1);
+            }
+        }
+        closedir(dir);
+    }
+
+    current = createSegment(nextIndex++);
+    if (!current) {
+        return false;
+    }
+    current->header->state.store(static_cast<uint32_t>(JournalState::Recording), std::memory_order_release);
+
+    stopping = false;
+    preparer = std::thread(&EventJournal::preparerLoop, this);
+    opened = true;
+    std::cout << "Recording raw events to " << options.directory << "\n";
+    return true;
+}
+
+void EventJournal::close()
+{
+    if (!opened) {
+        return;
+    }
+
+    Segment* last;
+    {
+        std::lock_guard<std::mutex> lock(appendMutex);
+        last = current;
+        current = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(prepareMutex);
+        stopping = true;
+    }
+    prepareCondition.notify_one();
+    if (preparer.joinable()) {
+        preparer.join();
+    }
+
+    for (Segment* segment : retired) {
+        finishSegment(segment, true);
+    }
+    retired.clear();
+    if (last) {
+        finishSegment(last, true);
+    }
+    if (spare) {
+        finishSegment(spare, false);
+        spare = nullptr;
+    }
+    opened = false;
+
+    std::cout << "Journal closed: " << recorded.load() << " event(s) recorded, "
+              << dropped.load() << " dropped.\n";
+}
+
+uint16_t EventJournal::registerDevice(const std::string& name, bool realtimeClock)
+{
+    std::lock_guard<std::mutex> lock(appendMutex);
+    uint16_t index = static_cast<uint16_t>(deviceNames.size());
+    deviceNames.push_back(name);
+    realtimeDevices.push_back(realtimeClock);
+    if (current) {
+        writeDeviceNames(current->header);
+    }
+    return index;
+}
+
+void EventJournal::writeDeviceNames(JournalHeader* header)
+{
+    std::size_t count = std::min(deviceNames.size(), JOURNAL_MAX_NAMED_DEVICES);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::strncpy(header->device_names[i], deviceNames[i].c_str(), JOURNAL_DEVICE_NAME_SIZE - 1);
+    }
+    header->device_count = static_cast<uint32_t>(deviceNames.size());
+}
+
+void EventJournal::append(uint16_t device, const input_event* events, std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(appendMutex);
+    if (!current) {
+        dropped.fetch_add(count, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t rotateUs = std::min<uint64_t>(options.rotateAfter.count() * 1000000ull, MAX_SEGMENT_SPAN_US);
+    // Realtime stamps are moved onto the monotonic clock, sampled once per batch
+    int64_t shiftUs = 0;
+    if (device < realtimeDevices.size() && realtimeDevices[device]) {
+        shiftUs = clockUs(CLOCK_REALTIME) - clockUs(CLOCK_MONOTONIC);
+    }
+    uint64_t written = 0;
+    uint64_t lost = 0;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const input_event& ev = events[i];
+        if (!isJournalled(ev.type)) {
+            continue;
+        }
+
+        int64_t stampUs = static_cast<int64_t>(ev.input_event_sec) * 1000000LL + ev.input_event_usec - shiftUs;
+        uint64_t timeUs = stampUs > 0 ? static_cast<uint64_t>(stampUs) : 0;
+        if (current->used == 0) {
+            current->header->base_time_us = timeUs;
+        }
+        uint64_t base = current->header->base_time_us;
+        uint64_t offset = timeUs > base ? timeUs - base : 0;
+
+        if (current->used == current->capacity || offset >= rotateUs) {
+            current->header->committed_records.store(current->used, std::memory_order_release);
+            if (activateSpare(timeUs)) {
+                offset = 0;
+            } else if (current->used == current->capacity || offset >= MAX_SEGMENT_SPAN_US) {
+                // The next segment is not ready yet and this one cannot take more
+                lost++;
+                continue;
+            }
+        }
+
+        JournalRecord& record = current->records[current->used++];
+        record.time_offset_us = static_cast<uint32_t>(offset);
+        record.device = device;
+        record.type = ev.type;
+        record.code = ev.code;
+        record.reserved = 0;
+        record.value = ev.value;
+        written++;
+    }
+
+    current->header->committed_records.store(current->used, std::memory_order_release);
+    recorded.fetch_add(written, std::memory_order_relaxed);
+    if (lost) {
+        dropped.fetch_add(lost, std::memory_order_relaxed);
+    }
+}
+
+// Called with appendMutex held. Swaps in the preallocated segment and hands
+// the current one to the background thread.
+bool EventJournal::activateSpare(uint64_t baseTimeUs)
+{
+    Segment* next;
+    {
+        std::lock_guard<std::mutex> lock(prepareMutex);
+        next = spare;
+        if (!next) {
+            return false;
+        }
+        spare = nullptr;
+        retired.push_back(current);
+    }
+    prepareCondition.notify_one();
+
+    next->header->base_time_us = baseTimeUs;
+    writeDeviceNames(next->header);
+    next->header->state.store(static_cast<uint32_t>(JournalState::Recording), std::memory_order_release);
+    current = next;
+    return true;
+}
+
+EventJournal::Segment* EventJournal::createSegment(uint64_t index)
+{
+    const std::string path = options.directory + "/" + segmentFileName(index);
+    uint64_t capacity = std::max<uint64_t>((options.segmentBytes - JOURNAL_HEADER_SIZE) / sizeof(JournalRecord),
+                                           MIN_SEGMENT_RECORDS);
+    std::size_t bytes = JOURNAL_HEADER_SIZE + capacity * sizeof(JournalRecord);
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "[journal] Cannot create " << path << ": " << strerror(errno) << "\n";
+        return nullptr;
+    }
+
+    // Reserve the blocks up front so a full disk fails here, not with
+    // SIGBUS while writing through the mapping.
+    int rc = posix_fallocate(fd, 0, static_cast<off_t>(bytes));
+    if (rc != 0 && (rc != EOPNOTSUPP || ftruncate(fd, static_cast<off_t>(bytes)) != 0)) {
+        std::cerr << "[journal] Cannot preallocate " << path << ": " << strerror(rc) << "\n";
+        ::close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "[journal] Cannot map " << path << ": " << strerror(errno) << "\n";
+        ::close(fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+    madvise(map, bytes, MADV_SEQUENTIAL);
+
+    JournalHeader* header = new (map) JournalHeader;
+    std::memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+    header->version = JOURNAL_VERSION;
+    header->record_size = sizeof(JournalRecord);
+    header->header_size = JOURNAL_HEADER_SIZE;
+    header->state.store(static_cast<uint32_t>(JournalState::Preallocated), std::memory_order_relaxed);
+    header->segment_index = index;
+    header->base_time_us = 0;
+    header->capacity = capacity;
+    header->committed_records.store(0, std::memory_order_relaxed);
+    header->device_count = 0;
+
+    Segment* segment = new Segment;
+    segment->index = index;
+    segment->path = path;
+    segment->fd = fd;
+    segment->map = map;
+    segment->mapBytes = bytes;
+    segment->header = header;
+    segment->records = reinterpret_cast<JournalRecord*>(static_cast<char*>(map) + JOURNAL_HEADER_SIZE);
+    segment->capacity = capacity;
+    return segment;
+}
+
+void EventJournal::finishSegment(Segment* segment, bool keep)
+{
+    if (keep) {
+        segment->header->committed_records.store(segment->used, std::memory_order_release);
+        segment->header->state.store(static_cast<uint32_t>(JournalState::Closed), std::memory_order_release);
+        msync(segment->map, segment->mapBytes, MS_ASYNC);
+    }
+    munmap(segment->map, segment->mapBytes);
+
+    if (keep) {
+        // Give back the preallocated space the segment never used
+        off_t used = static_cast<off_t>(JOURNAL_HEADER_SIZE + segment->used * sizeof(JournalRecord));
+        if (ftruncate(segment->fd, used) != 0) {
+            std::cerr << "[journal] Cannot trim " << segment->path << ": " << strerror(errno) << "\n";
+        }
+    } else {
+        unlink(segment->path.c_str());
+    }
+    ::close(segment->fd);
+    delete segment;
+}
+
+void EventJournal::preparerLoop()
+{
+    std::unique_lock<std::mutex> lock(prepareMutex);
+    bool lastAttemptFailed = false;
+
+    for (;;) {
+        if (lastAttemptFailed) {
+            // Disk full or similar: retry later instead of spinning
+            prepareCondition.wait_for(lock, std::chrono::seconds(5), [this] { return stopping || !retired.empty(); });
+        } else {
+            prepareCondition.wait(lock, [this] { return stopping || spare == nullptr || !retired.empty(); });
+        }
+        if (stopping) {
+            return;
+        }
+
+        std::vector<Segment*> done;
+        done.swap(retired);
+        bool needSpare = spare == nullptr;
+        uint64_t index = needSpare ? nextIndex++ : 0;
+        lock.unlock();
+
+        for (Segment* segment : done) {
+            finishSegment(segment, true);
+        }
+        Segment* created = needSpare ? createSegment(index) : nullptr;
+
+        lock.lock();
+        if (created) {
+            spare = created;
+        }
+        lastAttemptFailed = needSpare && !created;
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef EVENTJOURNAL_H
+#define EVENTJOURNAL_H
+
+#include <linux/input.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One recorded input_event. Timestamps are microseconds since the segment's
+// base time, so a segment never spans more than ~71 minutes.
+struct JournalRecord {
+    uint32_t time_offset_us;
+    uint16_t device;
+    uint16_t type;
+    uint16_t code;
+    uint16_t reserved;
+    int32_t value;
+};
+
+static_assert(sizeof(JournalRecord) == 16, "JournalRecord must stay 16 bytes");
+
+constexpr char JOURNAL_MAGIC[8] = {'K', 'N', 'M', 'J', 'R', 'N', 'L', '1'};
+constexpr uint32_t JOURNAL_VERSION = 1;
+constexpr std::size_t JOURNAL_HEADER_SIZE = 4096;
+constexpr std::size_t JOURNAL_MAX_NAMED_DEVICES = 56;
+constexpr std::size_t JOURNAL_DEVICE_NAME_SIZE = 64;
+
+enum class JournalState : uint32_t {
+    Preallocated = 0,
+    Recording = 1,
+    Closed = 2
+};
+
+// First page of every segment file. `committed_records` is bumped after the
+// records it covers have been written, so after a crash a reader can trust
+// everything below it and ignore whatever lies beyond.
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t header_size;
+    std::atomic<uint32_t> state;
+    uint64_t segment_index;
+    uint64_t base_time_us;      // CLOCK_MONOTONIC of time offset 0
+    uint64_t capacity;          // records the file has room for
+    std::atomic<uint64_t> committed_records;
+    uint32_t device_count;
+    uint32_t reserved;
+    char device_names[JOURNAL_MAX_NAMED_DEVICES][JOURNAL_DEVICE_NAME_SIZE];
+};
+
+static_assert(sizeof(JournalHeader) <= JOURNAL_HEADER_SIZE, "JournalHeader must fit in the header page");
+
+struct JournalOptions {
+    std::string directory;
+    uint64_t segmentBytes = 64ull << 20;
+    std::chrono::seconds rotateAfter{3600};
+};
+
+// Append-only recording of raw input events into preallocated,
+// memory-mapped segment files. Appending is a memcpy into the mapping under
+// a mutex all workers share, held only for the copy: no syscalls and no
+// fsync on the input path. A
+// background thread keeps the next segment created and mapped ahead of time
+// and finalises full ones, so rotation is a pointer swap.
+class EventJournal
+{
+public:
+    explicit EventJournal(JournalOptions options);
+    ~EventJournal();
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    bool open();
+    void close();
+    bool isOpen() const { return opened; }
+
+    // Gives the device a small index for its records and stores its name in
+    // the segment headers. Devices that refused CLOCK_MONOTONIC stamp their
+    // events with CLOCK_REALTIME; those are converted on append, so every
+    // record of a segment is on the one clock of base_time_us.
+    uint16_t registerDevice(const std::string& name, bool realtimeClock);
+
+    // Records the relevant events of a batch read from one device.
+    void append(uint16_t device, const input_event* events, std::size_t count);
+
+    uint64_t recordedEvents() const { return recorded.load(std::memory_order_relaxed); }
+    uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+    static std::string segmentFileName(uint64_t index);
+
+private:
+    struct Segment {
+        uint64_t index = 0;
+        std::string path;
+        int fd = -1;
+        void* map = nullptr;
+        std::size_t mapBytes = 0;
+        JournalHeader* header = nullptr;
+        JournalRecord* records = nullptr;
+        uint64_t capacity = 0;
+        uint64_t used = 0;
+    };
+
+    Segment* createSegment(uint64_t index);
+    void finishSegment(Segment* segment, bool keep);
+    bool activateSpare(uint64_t baseTimeUs);
+    void writeDeviceNames(JournalHeader* header);
+    void preparerLoop();
+
+    JournalOptions options;
+    bool opened = false;
+
+    // Input path; every worker appends under this one mutex
+    std::mutex appendMutex;
+    Segment* current = nullptr;
+    std::vector<std::string> deviceNames;
+    std::vector<bool> realtimeDevices;  // by device index
+    std::atomic<uint64_t> recorded{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Background preparation
+    std::mutex prepareMutex;
+    std::condition_variable prepareCondition;
+    Segment* spare = nullptr;
+    std::vector<Segment*> retired;
+    uint64_t nextIndex = 0;
+    bool stopping = false;
+    std::thread preparer;
+};
+
+#endif // EVENTJOURNAL_H
@@ -0,0 +1,160 @@
+#include "eventmask.h"
+#include "eventdispatch.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/ioctl.h>
+
+namespace {
+
+struct MetricName {
+    const char* name;
+    MetricSet metric;
+};
+
+const MetricName metricNames[] = {
+    {"keys", METRIC_KEYS},
+    {"clicks", METRIC_CLICKS},
+    {"scroll", METRIC_SCROLL},
+    {"movement", METRIC_MOVEMENT},
+    {"strokes", METRIC_STROKES},
+    {"gamepad", METRIC_GAMEPAD},
+};
+
+void setBit(uint8_t* bits, unsigned bit)
+{
+    // Callers pass valid event codes; the bitmaps cover every one of them
+    bits[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+}
+
+bool testBit(const uint8_t* bits, unsigned bit)
+{
+    return bits[bit / 8] & (1u << (bit % 8));
+}
+
+// Passes the codes of `type` whose action feeds one of `metrics`
+void selectCodes(uint8_t* types, uint8_t* bits, const DispatchTable& table, uint16_t type, uint16_t codes,
+                 MetricSet metrics)
+{
+    for (uint16_t code = 0; code < codes; ++code) {
+        if (actionMetrics(table.lookup(type, code)) & metrics) {
+            setBit(types, type);
+            setBit(bits, code);
+        }
+    }
+}
+
+#ifdef EVIOCSMASK
+template <std::size_t N>
+bool setMask(int fd, unsigned type, const uint8_t (&bits)[N])
+{
+    input_mask mask{};
+    mask.type = type;
+    mask.codes_size = N;
+    mask.codes_ptr = reinterpret_cast<uintptr_t>(bits);
+    return ioctl(fd, EVIOCSMASK, &mask) >= 0;
+}
+#endif
+
+} // namespace
+
+bool EventMask::delivers(uint16_t type, uint16_t code) const
+{
+    if (type == EV_SYN || type >= EV_CNT) {
+        return true;
+    }
+    if (!testBit(types, type)) {
+        return false;
+    }
+    if (type == EV_KEY && code < KEY_CNT) {
+        return testBit(keys, code);
+    }
+    if (type == EV_REL && code < REL_CNT) {
+        return testBit(relative, code);
+    }
+    if (type == EV_ABS && code < ABS_CNT) {
+        return testBit(absolute, code);
+    }
+    return true;
+}
+
+EventMask compileEventMask(MetricSet metrics, DeviceType type, bool recording)
+{
+    EventMask mask;
+    setBit(mask.types, EV_SYN);
+
+    if (recording) {
+        // What EventJournal keeps, unfiltered
+        setBit(mask.types, EV_KEY);
+        setBit(mask.types, EV_REL);
+        setBit(mask.types, EV_ABS);
+        std::memset(mask.keys, 0xff, sizeof(mask.keys));
+        std::memset(mask.relative, 0xff, sizeof(mask.relative));
+        std::memset(mask.absolute, 0xff, sizeof(mask.absolute));
+        return mask;
+    }
+
+    const DispatchTable& table = dispatchTable(type);
+    selectCodes(mask.types, mask.keys, table, EV_KEY, KEY_CNT, metrics);
+    selectCodes(mask.types, mask.relative, table, EV_REL, REL_CNT, metrics);
+    selectCodes(mask.types, mask.absolute, table, EV_ABS, ABS_CNT, metrics);
+    return mask;
+}
+
+bool applyEventMask(int fd, const EventMask& mask)
+{
+#ifdef EVIOCSMASK
+    // Code masks first, so the types switch on with their final codes
+    return setMask(fd, EV_KEY, mask.keys) && setMask(fd, EV_REL, mask.relative) &&
+           setMask(fd, EV_ABS, mask.absolute) && setMask(fd, 0, mask.types);
+#else
+    (void)fd;
+    (void)mask;
+    errno = ENOTTY;
+    return false;
+#endif
+}
+
+bool parseMetrics(const char* text, MetricSet& metrics)
+{
+    if (std::strcmp(text, "all") == 0) {
+        metrics = ALL_METRICS;
+        return true;
+    }
+    if (std::strcmp(text, "none") == 0) {
+        metrics = 0;
+        return true;
+    }
+    MetricSet parsed = 0;
+    for (const char* start = text; *start;) {
+        const char* end = std::strchr(start, ',');
+        std::size_t length = end ? static_cast<std::size_t>(end - start) : std::strlen(start);
+        bool known = false;
+        for (const MetricName& entry : metricNames) {
+            if (std::strlen(entry.name) == length && std::strncmp(start, entry.name, length) == 0) {
+                parsed |= entry.metric;
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+        start = end ? end + 1 : start + length;
+    }
+    metrics = parsed;
+    return true;
+}
+
+std::string formatMetrics(MetricSet metrics)
+{
+    std::string text;
+    for (const MetricName& entry : metricNames) {
+        if (metrics & entry.metric) {
+            if (!text.empty()) {
+                text += ',';
+            }
+            text += entry.name;
+        }
+    }
+    return text.empty() ? "none" : text;
+}
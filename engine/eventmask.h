@@ -0,0 +1,42 @@
+#ifndef EVENTMASK_H
+#define EVENTMASK_H
+
+#include "eventprocessor.h"
+
+#include <linux/input.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Which events one evdev client receives: a type bitmap plus code bitmaps
+// for the key, relative and absolute types. Set bits are delivered.
+struct EventMask {
+    uint8_t types[(EV_CNT + 7) / 8] = {};
+    uint8_t keys[KEY_STATE_BYTES] = {};
+    uint8_t relative[(REL_CNT + 7) / 8] = {};
+    uint8_t absolute[(ABS_CNT + 7) / 8] = {};
+
+    // Mirrors the kernel's per-client filter (evdev.c): EV_SYN and codes
+    // beyond a type's range always pass. A frame left with only its
+    // SYN_REPORT is then not delivered at all and wakes nobody.
+    bool delivers(uint16_t type, uint16_t code) const;
+};
+
+// The events needed for `metrics` on one device, and nothing else: the
+// codes whose action in the class's dispatch table (eventdispatch.h) feeds
+// an enabled metric. While recording, key, relative and absolute events
+// pass in full so the journal stays a faithful copy of the device;
+// scancodes, LEDs and the like are dropped either way.
+EventMask compileEventMask(MetricSet metrics, DeviceType type, bool recording);
+
+// Installs the mask on an evdev fd (EVIOCSMASK, Linux 4.4+). Returns false
+// when the kernel cannot filter; the processor still ignores what it does
+// not count, it just gets woken for it.
+bool applyEventMask(int fd, const EventMask& mask);
+
+// "keys,clicks,scroll,movement,strokes,gamepad" in any order and
+// combination, or "all" or "none"
+bool parseMetrics(const char* text, MetricSet& metrics);
+std::string formatMetrics(MetricSet metrics);
+
+#endif // EVENTMASK_H
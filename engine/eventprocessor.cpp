@@ -0,0 +1,578 @@
+#include "eventprocessor.h"
+#include "eventdispatch.h"
+#include "logger.h"
+#include "eventjournal.h"
+#include "typingstats.h"
+#include "heatmap.h"
+#include "activityrates.h"
+#include "latencyhistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <iterator>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+
+const char* deviceTypeName(DeviceType type)
+{
+    switch (type) {
+    case DeviceType::Keyboard:
+        return "keyboard";
+    case DeviceType::Mouse:
+        return "mouse";
+    case DeviceType::Touchpad:
+        return "touchpad";
+    case DeviceType::Tablet:
+        return "tablet";
+    case DeviceType::Gamepad:
+        return "gamepad";
+    }
+    return "device";
+}
+
+EventProcessor::EventProcessor(DeviceType type, StatsSlot* slot, std::string name)
+    : deviceType(type),
+    slot(slot),
+    deviceName(std::move(name))
+{
+    switch (type) {
+    case DeviceType::Keyboard:
+        handler = &EventProcessor::handleEvents<DeviceType::Keyboard>;
+        break;
+    case DeviceType::Mouse:
+        handler = &EventProcessor::handleEvents<DeviceType::Mouse>;
+        break;
+    case DeviceType::Touchpad:
+        handler = &EventProcessor::handleEvents<DeviceType::Touchpad>;
+        break;
+    case DeviceType::Tablet:
+        handler = &EventProcessor::handleEvents<DeviceType::Tablet>;
+        break;
+    case DeviceType::Gamepad:
+        handler = &EventProcessor::handleEvents<DeviceType::Gamepad>;
+        break;
+    }
+}
+
+bool EventProcessor::countsPress(EventAction action) const
+{
+    switch (action) {
+    case EventAction::KeyPress:
+        return countKeys;
+    case EventAction::Click:
+        return countClicks;
+    case EventAction::PenTouch:
+        return countStrokes;
+    case EventAction::PadButton:
+        return countGamepad;
+    default:
+        return false;
+    }
+}
+
+void EventProcessor::setMetrics(MetricSet metrics)
+{
+    countKeys = metrics & METRIC_KEYS;
+    countClicks = metrics & METRIC_CLICKS;
+    countScroll = metrics & METRIC_SCROLL;
+    countMovement = metrics & METRIC_MOVEMENT;
+    countStrokes = metrics & METRIC_STROKES;
+    countGamepad = metrics & METRIC_GAMEPAD;
+}
+
+void EventProcessor::setTouchResolution(int unitsPerMm)
+{
+    scrollStep = TOUCHPAD_SCROLL_STEP_MM * (unitsPerMm > 0 ? unitsPerMm : TOUCHPAD_DEFAULT_RESOLUTION);
+}
+
+void EventProcessor::setKeyDown(uint16_t code, bool down)
+{
+    if (code >= KEY_CNT) {
+        return;
+    }
+    if (down) {
+        keyState[code / 8] |= static_cast<uint8_t>(1u << (code % 8));
+    } else {
+        keyState[code / 8] &= static_cast<uint8_t>(~(1u << (code % 8)));
+    }
+}
+
+bool EventProcessor::isKeyDown(uint16_t code) const
+{
+    return code < KEY_CNT && (keyState[code / 8] & (1u << (code % 8)));
+}
+
+void EventProcessor::endFrame()
+{
+    // X and Y of the same report form one motion vector
+    if ((frame_dx != 0 || frame_dy != 0) && countMovement) {
+        double dx = frame_dx;
+        double dy = frame_dy;
+        pending.mouse_distance += std::sqrt(dx * dx + dy * dy);
+        if (heatmap) {
+            heatmap->move(frame_dx, frame_dy);
+        }
+    }
+    frame_dx = frame_dy = 0;
+}
+
+void EventProcessor::endTouchFrame()
+{
+    // One finger moves the pointer, two scroll; more are gestures. Motion is
+    // summed per contact over the whole report, like REL_X/REL_Y on a mouse.
+    std::size_t fingers = 0;
+    int dx = 0;
+    int dy = 0;
+    for (TouchPoint& touch : touches) {
+        if (!touch.down) {
+            touch.tracked = false;
+            continue;
+        }
+        ++fingers;
+        if (touch.tracked) {
+            dx += touch.x - touch.lastX;
+            dy += touch.y - touch.lastY;
+        }
+        touch.lastX = touch.x;
+        touch.lastY = touch.y;
+        touch.tracked = true;
+    }
+
+    if (fingers == 1 && (dx != 0 || dy != 0) && countMovement) {
+        double x = dx;
+        double y = dy;
+        pending.mouse_distance += std::sqrt(x * x + y * y);
+        if (heatmap) {
+            heatmap->move(dx, dy);
+        }
+    }
+    if (fingers != 2) {
+        scroll_dx = scroll_dy = 0;
+        return;
+    }
+    if (!countScroll) {
+        return;
+    }
+    // Both fingers travel together, so a step is twice the summed travel
+    const int step = 2 * scrollStep;
+    scroll_dx += dx;
+    scroll_dy += dy;
+    for (int* travel : {&scroll_dx, &scroll_dy}) {
+        if (std::abs(*travel) >= step) {
+            int steps = std::abs(*travel) / step;
+            pending.scroll_count += steps;
+            *travel -= (*travel > 0 ? steps : -steps) * step;
+            Logger::log(LogLevel::Debug, "[touchpad] Scroll detected on", deviceName.c_str(), steps);
+        }
+    }
+}
+
+void EventProcessor::resetTouches()
+{
+    // Positions that were lost are not motion; picked up again from the
+    // next report of each contact
+    for (TouchPoint& touch : touches) {
+        touch.tracked = false;
+    }
+    scroll_dx = scroll_dy = 0;
+}
+
+void EventProcessor::setJournal(EventJournal* journal, uint16_t device)
+{
+    this->journal = journal;
+    journalDevice = device;
+}
+
+void EventProcessor::setTypingSlot(TypingSlot* typing)
+{
+    this->typing = typing;
+}
+
+void EventProcessor::setHeatmapSlot(HeatmapSlot* heatmap)
+{
+    this->heatmap = heatmap;
+}
+
+void EventProcessor::setRateSlot(RateSlot* rates)
+{
+    this->rates = rates;
+}
+
+void EventProcessor::setLatencyHistogram(LatencyHistogram* latency)
+{
+    this->latency = latency;
+}
+
+void EventProcessor::addChangeSignal(ChangeSignal* signal)
+{
+    if (signal && changedCount < MAX_CHANGE_SIGNALS) {
+        changed[changedCount++] = signal;
+    }
+}
+
+void EventProcessor::raiseChanged()
+{
+    for (std::size_t i = 0; i < changedCount; ++i) {
+        changed[i]->raise();
+    }
+}
+
+template <DeviceType Type>
+void EventProcessor::handleEvents(const input_event* events, std::size_t count, int64_t second, int64_t nowUs)
+{
+    const DispatchTable& table = DISPATCH_TABLE<Type>;
+    const char* name = deviceName.c_str();
+
+    // A broken frame is skipped in one go, so the loop itself never asks
+    std::size_t i = dropping ? skipBrokenFrame(events, count, 0) : 0;
+    for (; i < count; ++i) {
+        const input_event& ev = events[i];
+
+        EventAction action;
+        if constexpr (DIRECT_DISPATCH<Type>) {
+            action = directAction<Type>(ev.type, ev.code);
+        } else {
+            action = table.lookup(ev.type, ev.code);
+        }
+        switch (action) {
+        case EventAction::Ignore:
+            break;
+        case EventAction::Report:
+            if constexpr (Type == DeviceType::Touchpad) {
+                endTouchFrame();
+            } else if constexpr (Type == DeviceType::Mouse) {
+                endFrame();
+            } else if constexpr (Type == DeviceType::Gamepad) {
+                // One report however many axes it moved, like a mouse frame
+                if (axisMoved) {
+                    pending.axis_count++;
+                    axisMoved = false;
+                }
+            }
+            if (latency) {
+                int64_t waited = nowUs - (ev.input_event_sec * 1000000LL + ev.input_event_usec);
+                latency->record(waited > 0 ? static_cast<uint64_t>(waited) : 0);
+            }
+            break;
+        case EventAction::Dropped:
+            Logger::log(LogLevel::Info, "[engine] Events dropped by the kernel, resyncing", name);
+            frame_dx = frame_dy = 0;
+            axisMoved = false;
+            if constexpr (Type == DeviceType::Touchpad) {
+                resetTouches();
+            }
+            if constexpr (Type == DeviceType::Gamepad) {
+                // A centring lost in the gap must not hide the next press
+                std::fill(std::begin(hats), std::end(hats), 0);
+            }
+            dropping = true;
+            i = skipBrokenFrame(events, count, i + 1) - 1;
+            break;
+        case EventAction::Key:
+            if (ev.value != 2) {
+                setKeyDown(ev.code, ev.value != 0);
+            }
+            break;
+        case EventAction::KeyPress:
+            if (ev.value == 1 && countKeys) {
+                pending.keyboard_count++;
+                if (typing) {
+                    typing->recordPress(ev.code, ev.input_event_sec * 1000000LL + ev.input_event_usec, second);
+                }
+                Logger::log(LogLevel::Debug, "[keyboard] Key press detected on", name);
+            }
+            if (ev.value != 2) {
+                setKeyDown(ev.code, ev.value != 0);
+            }
+            break;
+        case EventAction::Click:
+            if (ev.value == 1 && countClicks) {
+                pending.mouse_count++;
+                if (heatmap) {
+                    heatmap->click();
+                }
+                Logger::log(LogLevel::Debug, "[mouse] Button click detected on", name);
+            }
+            if (ev.value != 2) {
+                setKeyDown(ev.code, ev.value != 0);
+            }
+            break;
+        case EventAction::PenTouch:
+            if (ev.value == 1 && countStrokes) {
+                pending.stroke_count++;
+                Logger::log(LogLevel::Debug, "[tablet] Pen stroke detected on", name);
+            }
+            setKeyDown(ev.code, ev.value != 0);
+            break;
+        case EventAction::PadButton:
+            if (ev.value == 1 && countGamepad) {
+                pending.gamepad_count++;
+                Logger::log(LogLevel::Debug, "[gamepad] Button press detected on", name);
+            }
+            if (ev.value != 2) {
+                setKeyDown(ev.code, ev.value != 0);
+            }
+            break;
+        case EventAction::PadHat: {
+            // A d-pad direction is pressed when its axis leaves the centre
+            // or flips to the other side
+            int8_t& hat = hats[ev.code - ABS_HAT0X];
+            int8_t value = static_cast<int8_t>(ev.value > 0 ? 1 : ev.value < 0 ? -1 : 0);
+            if (value != 0 && value != hat && countGamepad) {
+                pending.gamepad_count++;
+                Logger::log(LogLevel::Debug, "[gamepad] D-pad press detected on", name);
+            }
+            hat = value;
+            break;
+        }
+        case EventAction::PadAxis:
+            if (countGamepad) {
+                axisMoved = true;
+            }
+            break;
+        case EventAction::MoveX:
+            frame_dx += ev.value;
+            Logger::trace("[mouse] Movement X detected on", name, ev.value);
+            break;
+        case EventAction::MoveY:
+            frame_dy += ev.value;
+            Logger::trace("[mouse] Movement Y detected on", name, ev.value);
+            break;
+        case EventAction::Wheel:
+            if (countScroll) {
+                pending.scroll_count += std::abs(ev.value);
+                Logger::log(LogLevel::Debug, "[mouse] Scroll detected on", name, ev.value);
+            }
+            break;
+        case EventAction::TouchSlot:
+            touchSlot = ev.value;
+            break;
+        case EventAction::TouchId:
+            if (touchSlot >= 0 && touchSlot < static_cast<int>(TOUCH_SLOTS)) {
+                // A new contact starts from wherever it lands, not as motion
+                touches[touchSlot].down = ev.value >= 0;
+                touches[touchSlot].tracked = false;
+            }
+            break;
+        case EventAction::TouchX:
+            if (touchSlot >= 0 && touchSlot < static_cast<int>(TOUCH_SLOTS)) {
+                touches[touchSlot].x = ev.value;
+            }
+            break;
+        case EventAction::TouchY:
+            if (touchSlot >= 0 && touchSlot < static_cast<int>(TOUCH_SLOTS)) {
+                touches[touchSlot].y = ev.value;
+            }
+            break;
+        default:
+            // Tables only hold the actions above; spares the range check
+            __builtin_unreachable();
+        }
+    }
+}
+
+std::size_t EventProcessor::skipBrokenFrame(const input_event* events, std::size_t count, std::size_t from)
+{
+    // Everything up to and including the next SYN_REPORT belongs to the
+    // frame the kernel could not deliver in full.
+    for (std::size_t i = from; i < count; ++i) {
+        if (events[i].type == EV_SYN && events[i].code == SYN_REPORT) {
+            dropping = false;
+            resyncPending = true;
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+void EventProcessor::process(const input_event* events, std::size_t count)
+{
+    if (journal) {
+        journal->append(journalDevice, events, count);
+    }
+
+    const int64_t second = currentSecond();
+    int64_t nowUs = 0;
+    if (latency) {
+        // One clock read per batch; every report in it was processed "now"
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        nowUs = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+    }
+
+    (this->*handler)(events, count, second, nowUs);
+
+    pending.event_count += count;
+    if (heatmap) {
+        heatmap->flush();
+    }
+    if (rates) {
+        rates->publish(pending, second);
+    }
+    slot->publish(pending, second);
+    pending = StatsSnapshot();
+    raiseChanged();
+}
+
+void EventProcessor::resyncKeys(const uint8_t (&current)[KEY_STATE_BYTES])
+{
+    // Keys that went down while events were lost count as presses
+    const DispatchTable& table = dispatchTable(deviceType);
+    for (uint16_t code = 0; code < KEY_CNT; ++code) {
+        bool down = current[code / 8] & (1u << (code % 8));
+        EventAction action = table.lookup(EV_KEY, code);
+        if (!down || isKeyDown(code) || !countsPress(action)) {
+            continue;
+        }
+        switch (action) {
+        case EventAction::KeyPress:
+            pending.keyboard_count++;
+            break;
+        case EventAction::Click:
+            pending.mouse_count++;
+            break;
+        case EventAction::PenTouch:
+            pending.stroke_count++;
+            break;
+        default:
+            pending.gamepad_count++;
+            break;
+        }
+    }
+    std::copy(current, current + KEY_STATE_BYTES, keyState);
+    resyncPending = false;
+
+    const int64_t second = currentSecond();
+    if (rates) {
+        rates->publish(pending, second);
+    }
+    slot->publish(pending, second);
+    pending = StatsSnapshot();
+    raiseChanged();
+}
+
+void EventProcessor::resyncTouches(const TouchState& current)
+{
+    touchSlot = current.slot;
+    for (std::size_t i = 0; i < TOUCH_SLOTS; ++i) {
+        touches[i].down = current.down[i];
+        touches[i].x = current.x[i];
+        touches[i].y = current.y[i];
+        touches[i].tracked = false;
+    }
+    scroll_dx = scroll_dy = 0;
+}
+
+void EventProcessor::restart(const uint8_t (&current)[KEY_STATE_BYTES])
+{
+    frame_dx = frame_dy = 0;
+    axisMoved = false;
+    resetTouches();
+    std::fill(std::begin(hats), std::end(hats), 0);
+    dropping = false;
+    resyncPending = false;
+    std::copy(current, current + KEY_STATE_BYTES, keyState);
+}
+
+// Reads the touchpad's current slot and each slot's tracking ID and
+// position. Slots past TOUCH_SLOTS are not asked for.
+static bool readTouchState(int fd, TouchState& state)
+{
+    input_absinfo slot = {};
+    if (ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &slot) < 0) {
+        return false;
+    }
+    state.slot = slot.value;
+
+    // EVIOCGMTSLOTS fills an input_mt_request_layout: the code, then one
+    // value per slot
+    int32_t request[1 + TOUCH_SLOTS];
+    for (uint32_t code : {ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y}) {
+        std::fill(std::begin(request), std::end(request), 0);
+        request[0] = static_cast<int32_t>(code);
+        if (ioctl(fd, EVIOCGMTSLOTS(sizeof(request)), request) < 0) {
+            return false;
+        }
+        for (std::size_t i = 0; i < TOUCH_SLOTS; ++i) {
+            const int32_t value = request[1 + i];
+            if (code == ABS_MT_TRACKING_ID) {
+                state.down[i] = value >= 0;
+            } else if (code == ABS_MT_POSITION_X) {
+                state.x[i] = value;
+            } else {
+                state.y[i] = value;
+            }
+        }
+    }
+    return true;
+}
+
+void discardDeviceEvents(int fd, EventProcessor& processor)
+{
+    input_event buffer[EVENT_BATCH_SIZE];
+    for (;;) {
+        ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        // Errors are left for the next read on a worker to report
+        if (bytes < static_cast<ssize_t>(sizeof(buffer))) {
+            break;
+        }
+    }
+
+    uint8_t keys[KEY_STATE_BYTES] = {};
+    if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+        processor.restart(keys);
+    }
+    TouchState touches;
+    if (processor.type() == DeviceType::Touchpad && readTouchState(fd, touches)) {
+        processor.resyncTouches(touches);
+    }
+}
+
+ReadStatus readDeviceEvents(int fd, EventProcessor& processor)
+{
+    input_event buffer[EVENT_BATCH_SIZE];
+
+    for (;;) {
+        ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return ReadStatus::Drained;
+            }
+            Logger::log(LogLevel::Info, "[engine] Read error, dropping device", processor.name().c_str(), errno);
+            return ReadStatus::Closed;
+        }
+        if (bytes == 0) {
+            return ReadStatus::Closed;
+        }
+
+        std::size_t count = static_cast<std::size_t>(bytes) / sizeof(input_event);
+        processor.process(buffer, count);
+
+        if (processor.needsKeyResync()) {
+            uint8_t keys[KEY_STATE_BYTES] = {};
+            if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+                processor.resyncKeys(keys);
+            }
+            TouchState touches;
+            if (processor.type() == DeviceType::Touchpad && readTouchState(fd, touches)) {
+                processor.resyncTouches(touches);
+            }
+        }
+
+        // evdev only returns whole events and fills the buffer when it can,
+        // so a short read means the queue is empty; skip the EAGAIN round trip.
+        if (count < EVENT_BATCH_SIZE) {
+            return ReadStatus::Drained;
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#ifndef EVENTPROCESSOR_H
+#define EVENTPROCESSOR_H
+
+#include "statistics.h"
+
+#include <linux/input.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class EventJournal;
+class TypingSlot;
+class RateSlot;
+class HeatmapSlot;
+class LatencyHistogram;
+enum class EventAction : uint8_t;
+
+enum class DeviceType {
+    Keyboard,
+    Mouse,
+    Touchpad,   // multitouch (protocol B) touchpads and clickpads
+    Tablet,     // pen tablets
+    Gamepad     // gamepads and joysticks
+};
+
+const char* deviceTypeName(DeviceType type);
+
+// What a processor counts, combined into a MetricSet. The engine also
+// compiles the set into kernel event masks (eventmask.h) so events no
+// metric needs are not delivered at all.
+enum Metric : uint32_t {
+    METRIC_KEYS = 1u << 0,      // key presses and the typing tables
+    METRIC_CLICKS = 1u << 1,    // mouse buttons and the click heatmap
+    METRIC_SCROLL = 1u << 2,    // wheel and two-finger scroll steps
+    METRIC_MOVEMENT = 1u << 3,  // pointer distance and the movement heatmap
+    METRIC_STROKES = 1u << 4,   // tablet pen strokes
+    METRIC_GAMEPAD = 1u << 5    // gamepad presses and axis reports
+};
+
+using MetricSet = uint32_t;
+constexpr MetricSet ALL_METRICS =
+    METRIC_KEYS | METRIC_CLICKS | METRIC_SCROLL | METRIC_MOVEMENT | METRIC_STROKES | METRIC_GAMEPAD;
+
+// Number of input_event structs fetched per read() syscall
+constexpr std::size_t EVENT_BATCH_SIZE = 64;
+constexpr std::size_t KEY_STATE_BYTES = (KEY_CNT + 7) / 8;
+constexpr std::size_t MAX_CHANGE_SIGNALS = 3;
+// Touchpad contacts followed at once; further fingers are ignored
+constexpr std::size_t TOUCH_SLOTS = 10;
+// Two-finger travel that counts as one wheel step, and the resolution
+// assumed when the touchpad reports none (units per mm)
+constexpr int TOUCHPAD_SCROLL_STEP_MM = 10;
+constexpr int TOUCHPAD_DEFAULT_RESOLUTION = 12;
+
+// A touchpad's current contacts as the kernel holds them (EVIOCGABS and
+// EVIOCGMTSLOTS), for picking the slots up again after lost events
+struct TouchState {
+    int slot = 0;
+    bool down[TOUCH_SLOTS] = {};
+    int x[TOUCH_SLOTS] = {};
+    int y[TOUCH_SLOTS] = {};
+};
+
+// Turns a device's raw input_event stream into statistics. Events are fed
+// in batches; changes are accumulated locally and published to the
+// device's StatsSlot once per batch. The processor knows nothing about
+// where events come from. Each device class has its own handler, compiled
+// for that class: touchpads, tablets and gamepads look events up in their
+// (type, code) table, keyboards and mice test type and code directly
+// (directAction() in eventdispatch.h). The class is picked once per batch,
+// not per event. When the stream
+// reports SYN_DROPPED it discards the rest of the broken frame and then
+// asks its owner for the device's current key and touch state (see
+// needsKeyResync()).
+class EventProcessor
+{
+public:
+    EventProcessor(DeviceType type, StatsSlot* slot, std::string name);
+
+    void process(const input_event* events, std::size_t count);
+
+    // Metrics not in the set are ignored even if their events arrive (a
+    // kernel without EVIOCSMASK, or a replayed journal). All by default.
+    void setMetrics(MetricSet metrics);
+    // Touchpads: units per mm of ABS_MT_POSITION_Y, for the scroll step
+    void setTouchResolution(int unitsPerMm);
+
+    // Raw batches are also appended to the journal while one is set
+    void setJournal(EventJournal* journal, uint16_t device);
+
+    // Keyboards also feed per-key, bigram, interval and WPM tables
+    void setTypingSlot(TypingSlot* typing);
+    // Mice and touchpads also feed the movement and click heatmaps
+    void setHeatmapSlot(HeatmapSlot* heatmap);
+    // Batches are also added to the device's per-second/minute/hour rings
+    void setRateSlot(RateSlot* rates);
+    // Records how long each report waited between the kernel stamping it and
+    // being processed. Only meaningful once the device's clock is
+    // CLOCK_MONOTONIC (EVIOCSCLOCKID).
+    void setLatencyHistogram(LatencyHistogram* latency);
+    // Raised after every batch that was published; up to
+    // MAX_CHANGE_SIGNALS consumers (the client, the stats exporter and the
+    // history recorder)
+    void addChangeSignal(ChangeSignal* changed);
+
+    // True after a SYN_DROPPED once the broken frame has been skipped. The
+    // owner should fetch the key bitmap (EVIOCGKEY) and call resyncKeys(),
+    // and on touchpads also resyncTouches().
+    bool needsKeyResync() const { return resyncPending; }
+    void resyncKeys(const uint8_t (&current)[KEY_STATE_BYTES]);
+    // Takes the contacts in `current` as down, with their positions as the
+    // base for the next motion rather than as motion
+    void resyncTouches(const TouchState& current);
+    // Forgets any partial frame and takes `current` as the key state without
+    // counting anything, for picking a stream up again after a pause
+    void restart(const uint8_t (&current)[KEY_STATE_BYTES]);
+
+    DeviceType type() const { return deviceType; }
+    const std::string& name() const { return deviceName; }
+
+private:
+    using BatchHandler = void (EventProcessor::*)(const input_event*, std::size_t, int64_t, int64_t);
+
+    // Contact state of one touchpad slot
+    struct TouchPoint {
+        int x = 0;
+        int y = 0;
+        int lastX = 0;      // position at the end of the previous frame
+        int lastY = 0;
+        bool down = false;
+        bool tracked = false;   // lastX/lastY are valid
+    };
+
+    template <DeviceType Type>
+    void handleEvents(const input_event* events, std::size_t count, int64_t second, int64_t nowUs);
+    bool countsPress(EventAction action) const;
+    // Returns the index after the broken frame's SYN_REPORT, or `count`
+    std::size_t skipBrokenFrame(const input_event* events, std::size_t count, std::size_t from);
+    void endFrame();
+    void endTouchFrame();
+    void resetTouches();
+    void setKeyDown(uint16_t code, bool down);
+    void raiseChanged();
+    bool isKeyDown(uint16_t code) const;
+
+    DeviceType deviceType;
+    BatchHandler handler;
+    StatsSlot* slot;
+    std::string deviceName;
+
+    EventJournal* journal = nullptr;
+    uint16_t journalDevice = 0;
+    TypingSlot* typing = nullptr;
+    HeatmapSlot* heatmap = nullptr;
+    RateSlot* rates = nullptr;
+    LatencyHistogram* latency = nullptr;
+    ChangeSignal* changed[MAX_CHANGE_SIGNALS] = {};
+    std::size_t changedCount = 0;
+
+    bool countKeys = true;
+    bool countClicks = true;
+    bool countScroll = true;
+    bool countMovement = true;
+    bool countStrokes = true;
+    bool countGamepad = true;
+
+    StatsSnapshot pending;
+    int frame_dx = 0;
+    int frame_dy = 0;
+    TouchPoint touches[TOUCH_SLOTS];
+    int touchSlot = 0;
+    int scrollStep = TOUCHPAD_SCROLL_STEP_MM * TOUCHPAD_DEFAULT_RESOLUTION;
+    int scroll_dx = 0;      // two-finger travel not yet worth a step
+    int scroll_dy = 0;
+    int8_t hats[8] = {};    // ABS_HAT0X..ABS_HAT3Y
+    bool axisMoved = false; // a stick or trigger moved in this frame
+    bool dropping = false;
+    bool resyncPending = false;
+    uint8_t keyState[KEY_STATE_BYTES] = {};
+};
+
+enum class ReadStatus {
+    Drained,    // fd returned EAGAIN or a short read; wait for the next wakeup
+    Closed      // device is gone or broken; stop reading it
+};
+
+// Reads whole arrays of input_event from a non-blocking evdev fd and feeds
+// them to the processor until the fd is drained. Handles key and touch
+// resync after SYN_DROPPED.
+ReadStatus readDeviceEvents(int fd, EventProcessor& processor);
+
+// Reads and drops everything queued on the fd, then restarts the processor
+// from the device's current key and touch state. Used when resuming after a pause.
+void discardDeviceEvents(int fd, EventProcessor& processor);
+
+#endif // EVENTPROCESSOR_H
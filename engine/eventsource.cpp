@@ -0,0 +1,144 @@
+#include "eventsource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+JournalSource::~JournalSource()
+{
+    close();
+}
+
+bool JournalSource::open(const std::string& path, uint16_t device)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[replay] Cannot open " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < JOURNAL_HEADER_SIZE) {
+        std::cerr << "[replay] " << path << " is too small to be a journal segment\n";
+        ::close(fd);
+        return false;
+    }
+
+    mapBytes = static_cast<std::size_t>(st.st_size);
+    map = mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "[replay] Cannot map " << path << ": " << strerror(errno) << "\n";
+        map = nullptr;
+        return false;
+    }
+    madvise(map, mapBytes, MADV_SEQUENTIAL);
+
+    header = static_cast<const JournalHeader*>(map);
+    if (std::memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+        header->version != JOURNAL_VERSION || header->record_size != sizeof(JournalRecord) ||
+        header->header_size != JOURNAL_HEADER_SIZE) {
+        std::cerr << "[replay] " << path << " is not a version " << JOURNAL_VERSION << " journal segment\n";
+        close();
+        return false;
+    }
+
+    // Only committed records are trustworthy, and never more than the file holds
+    uint64_t available = (mapBytes - header->header_size) / sizeof(JournalRecord);
+    count = std::min<uint64_t>(header->committed_records.load(std::memory_order_acquire), available);
+    records = reinterpret_cast<const JournalRecord*>(static_cast<const char*>(map) + header->header_size);
+    position = 0;
+    this->device = device;
+    return true;
+}
+
+void JournalSource::close()
+{
+    if (map) {
+        munmap(map, mapBytes);
+    }
+    map = nullptr;
+    mapBytes = 0;
+    header = nullptr;
+    records = nullptr;
+    count = position = 0;
+}
+
+std::vector<std::string> JournalSource::deviceNames() const
+{
+    std::vector<std::string> names;
+    if (!header) {
+        return names;
+    }
+    for (uint32_t i = 0; i < header->device_count; ++i) {
+        if (i < JOURNAL_MAX_NAMED_DEVICES) {
+            names.emplace_back(header->device_names[i], strnlen(header->device_names[i], JOURNAL_DEVICE_NAME_SIZE));
+        } else {
+            names.emplace_back("(unnamed)");
+        }
+    }
+    return names;
+}
+
+std::size_t JournalSource::read(input_event* events, std::size_t max)
+{
+    std::size_t filled = 0;
+    while (filled < max && position < count) {
+        const JournalRecord& record = records[position++];
+        if (record.device != device) {
+            continue;
+        }
+        uint64_t timeUs = header->base_time_us + record.time_offset_us;
+        input_event& ev = events[filled++];
+        ev.input_event_sec = static_cast<decltype(ev.input_event_sec)>(timeUs / 1000000ull);
+        ev.input_event_usec = static_cast<decltype(ev.input_event_usec)>(timeUs % 1000000ull);
+        ev.type = record.type;
+        ev.code = record.code;
+        ev.value = record.value;
+    }
+    return filled;
+}
+
+MemorySource::MemorySource(const std::vector<input_event>& events, std::size_t repeat)
+    : stream(events),
+    remainingPasses(events.empty() ? 0 : repeat)
+{
+}
+
+std::size_t MemorySource::read(input_event* events, std::size_t max)
+{
+    std::size_t filled = 0;
+    while (filled < max && remainingPasses > 0) {
+        std::size_t chunk = std::min(max - filled, stream.size() - position);
+        std::memcpy(events + filled, stream.data() + position, chunk * sizeof(input_event));
+        filled += chunk;
+        position += chunk;
+        if (position == stream.size()) {
+            position = 0;
+            remainingPasses--;
+        }
+    }
+    return filled;
+}
+
+uint64_t replayEvents(EventSource& source, EventProcessor& processor)
+{
+    input_event buffer[EVENT_BATCH_SIZE];
+    uint64_t total = 0;
+    for (std::size_t n = source.read(buffer, EVENT_BATCH_SIZE); n > 0; n = source.read(buffer, EVENT_BATCH_SIZE)) {
+        processor.process(buffer, n);
+        if (processor.needsKeyResync()) {
+            // Recordings carry no key bitmap; assume nothing stayed pressed
+            uint8_t keys[KEY_STATE_BYTES] = {};
+            processor.resyncKeys(keys);
+        }
+        total += n;
+    }
+    return total;
+}
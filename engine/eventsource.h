@@ -0,0 +1,77 @@
+#ifndef EVENTSOURCE_H
+#define EVENTSOURCE_H
+
+#include "eventjournal.h"
+#include "eventprocessor.h"
+
+#include <linux/input.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Anything that can hand the pipeline input_event batches. Live devices are
+// read straight from their fd by readDeviceEvents(); sources exist so the
+// same EventProcessor can be driven from recordings and generators without
+// hardware or root.
+class EventSource
+{
+public:
+    virtual ~EventSource() = default;
+
+    // Fills up to `max` events and returns how many were written; 0 means
+    // the stream is exhausted.
+    virtual std::size_t read(input_event* events, std::size_t max) = 0;
+};
+
+// Replays one device's events from a journal segment written by
+// EventJournal. Timestamps are rebuilt from the segment base time.
+class JournalSource : public EventSource
+{
+public:
+    JournalSource() = default;
+    ~JournalSource() override;
+
+    JournalSource(const JournalSource&) = delete;
+    JournalSource& operator=(const JournalSource&) = delete;
+
+    bool open(const std::string& path, uint16_t device);
+    void close();
+
+    std::size_t read(input_event* events, std::size_t max) override;
+
+    // Device names stored in the segment header, by journal device index
+    std::vector<std::string> deviceNames() const;
+    uint64_t recordCount() const { return count; }
+
+private:
+    void* map = nullptr;
+    std::size_t mapBytes = 0;
+    const JournalHeader* header = nullptr;
+    const JournalRecord* records = nullptr;
+    uint64_t count = 0;
+    uint64_t position = 0;
+    uint16_t device = 0;
+};
+
+// Replays a prepared event array, optionally several times over. The array
+// is not copied and must outlive the source; temporaries are refused.
+class MemorySource : public EventSource
+{
+public:
+    MemorySource(const std::vector<input_event>& events, std::size_t repeat = 1);
+    MemorySource(std::vector<input_event>&&, std::size_t = 1) = delete;
+
+    std::size_t read(input_event* events, std::size_t max) override;
+
+private:
+    const std::vector<input_event>& stream;
+    std::size_t remainingPasses;
+    std::size_t position = 0;
+};
+
+// Pumps a source through a processor as fast as it will go, in batches of
+// EVENT_BATCH_SIZE just like a live device. Returns the number of events.
+uint64_t replayEvents(EventSource& source, EventProcessor& processor);
+
+#endif // EVENTSOURCE_H
@@ -0,0 +1,194 @@
+#include "heatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+uint64_t HeatmapGrid::peak() const
+{
+    return cells.empty() ? 0 : *std::max_element(cells.begin(), cells.end());
+}
+
+uint64_t HeatmapGrid::total() const
+{
+    uint64_t sum = 0;
+    for (uint64_t cell : cells) {
+        sum += cell;
+    }
+    return sum;
+}
+
+std::size_t heatmapLevelFor(std::size_t pixels)
+{
+    std::size_t level = 0;
+    while (level + 1 < HEATMAP_LEVELS && heatmapLevelSize(level + 1) >= pixels) {
+        ++level;
+    }
+    return level;
+}
+
+HeatmapSlot::HeatmapSlot()
+    : moves(new std::atomic<uint32_t>[HEATMAP_CELLS]),
+    clicks(new std::atomic<uint32_t>[HEATMAP_CELLS])
+{
+    setScreen(width, height);
+    reset();
+}
+
+void HeatmapSlot::setScreen(int screenWidth, int screenHeight)
+{
+    flush();
+    width = std::max(1, screenWidth);
+    height = std::max(1, screenHeight);
+    // 32.32 fixed point: cell = position * scale >> 32, no division per report
+    scaleX = (static_cast<uint64_t>(HEATMAP_SIZE) << 32) / static_cast<uint64_t>(width);
+    scaleY = (static_cast<uint64_t>(HEATMAP_SIZE) << 32) / static_cast<uint64_t>(height);
+    x = width / 2;
+    y = height / 2;
+    pendingCell = cursorCell();
+}
+
+uint32_t HeatmapSlot::cursorCell() const
+{
+    uint32_t cellX = static_cast<uint32_t>((static_cast<uint64_t>(x) * scaleX) >> 32);
+    uint32_t cellY = static_cast<uint32_t>((static_cast<uint64_t>(y) * scaleY) >> 32);
+    return cellX + cellY * static_cast<uint32_t>(HEATMAP_SIZE);
+}
+
+// One increment per level: the cell's ancestors are found by shifting its
+// coordinates, so the whole pyramid stays current without any rebuild.
+void HeatmapSlot::add(std::atomic<uint32_t>* map, uint32_t cell, uint32_t count)
+{
+    uint32_t cellX = cell % HEATMAP_SIZE;
+    uint32_t cellY = cell / HEATMAP_SIZE;
+    for (std::size_t level = 0; level < HEATMAP_LEVELS; ++level) {
+        std::atomic<uint32_t>& counter =
+            map[heatmapLevelOffset(level) + (cellY >> level) * heatmapLevelSize(level) + (cellX >> level)];
+        // Single writer: plain load/store pair, saturating at the top
+        uint32_t value = counter.load(std::memory_order_relaxed);
+        uint32_t sum = value + count;
+        counter.store(sum < value ? std::numeric_limits<uint32_t>::max() : sum, std::memory_order_relaxed);
+    }
+}
+
+void HeatmapSlot::move(int dx, int dy)
+{
+    x = std::min(std::max(x + dx, 0), width - 1);
+    y = std::min(std::max(y + dy, 0), height - 1);
+    uint32_t cell = cursorCell();
+    if (cell != pendingCell) {
+        flush();
+        pendingCell = cell;
+    }
+    pendingMoves++;
+}
+
+void HeatmapSlot::click()
+{
+    add(clicks.get(), cursorCell(), 1);
+}
+
+void HeatmapSlot::flush()
+{
+    if (pendingMoves != 0) {
+        add(moves.get(), pendingCell, pendingMoves);
+        pendingMoves = 0;
+    }
+}
+
+void HeatmapSlot::addTo(HeatmapGrid& grid, HeatmapKind kind) const
+{
+    const std::atomic<uint32_t>* map = kind == HeatmapKind::Clicks ? clicks.get() : moves.get();
+    const std::atomic<uint32_t>* level = map + heatmapLevelOffset(grid.level);
+    for (std::size_t i = 0; i < grid.cells.size(); ++i) {
+        grid.cells[i] += level[i].load(std::memory_order_relaxed);
+    }
+}
+
+void HeatmapSlot::reset()
+{
+    for (std::size_t i = 0; i < HEATMAP_CELLS; ++i) {
+        moves[i].store(0, std::memory_order_relaxed);
+        clicks[i].store(0, std::memory_order_relaxed);
+    }
+    x = width / 2;
+    y = height / 2;
+    pendingCell = cursorCell();
+    pendingMoves = 0;
+}
+
+HeatmapStats::HeatmapStats(std::size_t capacity)
+    : capacity(capacity)
+{
+}
+
+HeatmapSlot* HeatmapStats::acquireSlot(int screenWidth, int screenHeight)
+{
+    HeatmapSlot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else if (allSlots.size() < capacity) {
+            allSlots.emplace_back(new HeatmapSlot);
+            slot = allSlots.back().get();
+        }
+    }
+    if (slot) {
+        slot->setScreen(screenWidth, screenHeight);
+    }
+    return slot;
+}
+
+void HeatmapStats::releaseSlot(HeatmapSlot* slot)
+{
+    if (slot) {
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        freeSlots.push_back(slot);
+    }
+}
+
+HeatmapGrid HeatmapStats::snapshot(HeatmapKind kind, std::size_t level) const
+{
+    HeatmapGrid grid;
+    grid.level = std::min(level, HEATMAP_LEVELS - 1);
+    grid.size = heatmapLevelSize(grid.level);
+    grid.cells.assign(grid.size * grid.size, 0);
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        slot->addTo(grid, kind);
+    }
+    return grid;
+}
+
+void HeatmapStats::reset()
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        slot->reset();
+    }
+    freeSlots.clear();
+    for (const auto& slot : allSlots) {
+        freeSlots.push_back(slot.get());
+    }
+}
+
+bool writeHeatmapPgm(const HeatmapGrid& grid, const std::string& path)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::fprintf(file, "P5\n%zu %zu\n255\n", grid.size, grid.size);
+    const double scale = 255.0 / std::log1p(static_cast<double>(std::max<uint64_t>(grid.peak(), 1)));
+    std::vector<unsigned char> row(grid.size);
+    for (std::size_t cellY = 0; cellY < grid.size; ++cellY) {
+        for (std::size_t cellX = 0; cellX < grid.size; ++cellX) {
+            row[cellX] = static_cast<unsigned char>(std::log1p(static_cast<double>(grid.at(cellX, cellY))) * scale);
+        }
+        std::fwrite(row.data(), 1, row.size(), file);
+    }
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,135 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The virtual screen is divided into HEATMAP_SIZE x HEATMAP_SIZE cells.
+// Above that base grid sit HEATMAP_LEVELS - 1 downsampled levels, each half
+// the size of the one below, down to a single cell: a mip pyramid of about
+// 87k counters per map whatever the session length.
+constexpr unsigned HEATMAP_LOG2_SIZE = 8;
+constexpr std::size_t HEATMAP_SIZE = std::size_t(1) << HEATMAP_LOG2_SIZE;
+constexpr std::size_t HEATMAP_LEVELS = HEATMAP_LOG2_SIZE + 1;
+
+// Cells per side of a level; level 0 is the base grid
+constexpr std::size_t heatmapLevelSize(std::size_t level) { return HEATMAP_SIZE >> level; }
+// Index of a level's first cell in the pyramid array
+constexpr std::size_t heatmapLevelOffset(std::size_t level)
+{
+    return level == 0 ? 0 : heatmapLevelOffset(level - 1) + heatmapLevelSize(level - 1) * heatmapLevelSize(level - 1);
+}
+constexpr std::size_t HEATMAP_CELLS = heatmapLevelOffset(HEATMAP_LEVELS);
+
+// Default virtual screen, in device units
+constexpr int HEATMAP_DEFAULT_WIDTH = 1920;
+constexpr int HEATMAP_DEFAULT_HEIGHT = 1080;
+
+enum class HeatmapKind {
+    Movement,   // one count per motion report at the cursor's cell
+    Clicks      // one count per button press at the cursor's cell
+};
+
+// One level of a map, built on the reader side. Row-major, y * size + x.
+struct HeatmapGrid {
+    std::size_t level = 0;
+    std::size_t size = 0;           // cells per side
+    std::vector<uint64_t> cells;
+
+    uint64_t at(std::size_t x, std::size_t y) const { return cells[y * size + x]; }
+    uint64_t peak() const;
+    uint64_t total() const;
+};
+
+// Coarsest level with at least `pixels` cells per side (level 0 if none),
+// so a view never reads more cells than it can show
+std::size_t heatmapLevelFor(std::size_t pixels);
+
+// Movement and click maps of one mouse, written by exactly one producer.
+// The producer integrates relative motion into a cursor clamped to the
+// virtual screen. Raw device units are used, without the pointer
+// acceleration the desktop applies, so the position is an approximation
+// that stays within the screen. Every sample adds to one cell on every
+// level of the pyramid, HEATMAP_LEVELS load/store pairs, so no level is
+// ever rebuilt from the one below. Consecutive reports that land in the
+// same cell are merged before touching the maps. Counters are atomics
+// read without a seqlock, like TypingSlot; they saturate instead of
+// wrapping.
+class HeatmapSlot
+{
+public:
+    HeatmapSlot();
+
+    HeatmapSlot(const HeatmapSlot&) = delete;
+    HeatmapSlot& operator=(const HeatmapSlot&) = delete;
+
+    // Before the producer starts; puts the cursor in the middle
+    void setScreen(int width, int height);
+
+    // Producer side
+    void move(int dx, int dy);
+    void click();
+    // Writes the merged run of motion reports; call at the end of a batch
+    void flush();
+
+    // Reader side. Adds this slot's counts at grid.level to `grid`.
+    void addTo(HeatmapGrid& grid, HeatmapKind kind) const;
+
+    void reset();
+
+private:
+    void add(std::atomic<uint32_t>* map, uint32_t cell, uint32_t count);
+    uint32_t cursorCell() const;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> moves;
+    std::unique_ptr<std::atomic<uint32_t>[]> clicks;
+
+    // Producer-only state
+    int width = HEATMAP_DEFAULT_WIDTH;
+    int height = HEATMAP_DEFAULT_HEIGHT;
+    uint64_t scaleX = 0;
+    uint64_t scaleY = 0;
+    int x = 0;
+    int y = 0;
+    uint32_t pendingCell = 0;    // base cell, x + y * HEATMAP_SIZE
+    uint32_t pendingMoves = 0;
+};
+
+// Pool of heatmap slots, one per mouse, allocated when a mouse attaches;
+// released slots keep their counts and are handed out again, like
+// TypingStats.
+class HeatmapStats
+{
+public:
+    explicit HeatmapStats(std::size_t capacity = 16);
+
+    HeatmapStats(const HeatmapStats&) = delete;
+    HeatmapStats& operator=(const HeatmapStats&) = delete;
+
+    // Returns nullptr when every slot is taken
+    HeatmapSlot* acquireSlot(int screenWidth, int screenHeight);
+    void releaseSlot(HeatmapSlot* slot);
+
+    // Every mouse merged, at one pyramid level
+    HeatmapGrid snapshot(HeatmapKind kind, std::size_t level) const;
+
+    // Zeroes every slot and releases them. Only call while no producer runs.
+    void reset();
+
+private:
+    std::size_t capacity;
+    mutable std::mutex slotsMutex;
+    std::vector<std::unique_ptr<HeatmapSlot>> allSlots;
+    std::vector<HeatmapSlot*> freeSlots;
+};
+
+// Writes a grid as a binary PGM image, log-scaled so sparse cells stay
+// visible. Returns false if the file cannot be written.
+bool writeHeatmapPgm(const HeatmapGrid& grid, const std::string& path);
+
+#endif // HEATMAP_H
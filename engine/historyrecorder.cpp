@@ -0,0 +1,172 @@
+#include "historyrecorder.h"
+#include "trackerengine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int64_t MINUTE_MS = 60 * 1000;
+
+int64_t realtimeMs()
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+void drain(int fd)
+{
+    uint64_t value;
+    while (::read(fd, &value, sizeof(value)) == sizeof(value)) {
+    }
+}
+
+// Counters only grow within a session; anything else restarts from zero
+StatsSnapshot difference(const StatsSnapshot& now, const StatsSnapshot& before)
+{
+    if (now.event_count < before.event_count) {
+        return now;
+    }
+    StatsSnapshot delta = now;
+    delta -= before;
+    return delta;
+}
+
+} // namespace
+
+HistoryRecorder::HistoryRecorder(const TrackerEngine& engine, RollupStore& store)
+    : engine(engine)
+    , store(store)
+{
+    changeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    // Runs on an engine worker: only wake the recorder thread
+    int fd = changeFd;
+    changed.setHandler([fd]() {
+        uint64_t one = 1;
+        if (::write(fd, &one, sizeof(one)) != sizeof(one)) {
+            // Counter saturated: the recorder is already due to wake
+        }
+    });
+}
+
+HistoryRecorder::~HistoryRecorder()
+{
+    stop();
+    if (changeFd >= 0) {
+        ::close(changeFd);
+    }
+    if (stopFd >= 0) {
+        ::close(stopFd);
+    }
+}
+
+bool HistoryRecorder::start()
+{
+    if (thread.joinable()) {
+        return true;
+    }
+    if (changeFd < 0 || stopFd < 0) {
+        std::cerr << "[history] eventfd failed: " << strerror(errno) << "\n";
+        return false;
+    }
+    drain(stopFd);
+    // The engine zeroes its counters when a session starts
+    lastTotals = StatsSnapshot();
+    lastDevices.clear();
+    lastFlushMinute = realtimeMs() / MINUTE_MS;
+    thread = std::thread(&HistoryRecorder::run, this);
+    return true;
+}
+
+void HistoryRecorder::stop()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (::write(stopFd, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "[history] cannot wake recorder thread\n";
+    }
+    thread.join();
+
+    // The minute in progress, cut short
+    sample(realtimeMs() / 1000);
+    store.flush();
+}
+
+// Sleeps until the engine reports a change, then until the end of that
+// minute; the change fd stays out of the poll set meanwhile, so a busy
+// device costs one wakeup a minute.
+void HistoryRecorder::run()
+{
+    int64_t nextSampleMs = 0;
+    bool armed = false;
+    for (;;) {
+        pollfd fds[2];
+        nfds_t count = 0;
+        fds[count++] = pollfd{stopFd, POLLIN, 0};
+        if (!armed) {
+            fds[count++] = pollfd{changeFd, POLLIN, 0};
+        }
+        int timeout = armed ? static_cast<int>(std::max<int64_t>(0, nextSampleMs - realtimeMs())) : -1;
+        int ready = poll(fds, count, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "[history] poll failed: " << strerror(errno) << "\n";
+            return;
+        }
+        if (fds[0].revents) {
+            return;
+        }
+        if (!armed && fds[1].revents) {
+            drain(changeFd);
+            armed = true;
+            nextSampleMs = (realtimeMs() / MINUTE_MS + 1) * MINUTE_MS;
+        }
+        if (armed && realtimeMs() >= nextSampleMs) {
+            armed = false;
+            // Everything since the last sample happened in the minute that
+            // just ended
+            sample(nextSampleMs / 1000 - 60);
+        }
+    }
+}
+
+// `minute` is a Unix second within the minute the counts belong to
+void HistoryRecorder::sample(int64_t minute)
+{
+    // Re-arm first so input arriving while sampling wakes us again
+    changed.consume();
+
+    StatsSnapshot totals = engine.snapshot().totals;
+    store.add(ROLLUP_TOTAL_SERIES, minute, difference(totals, lastTotals));
+    lastTotals = totals;
+
+    for (const DeviceStats& device : engine.deviceStats()) {
+        if (device.id >= lastDevices.size()) {
+            lastDevices.resize(device.id + 1);
+        }
+        StatsSnapshot delta = difference(device.counts, lastDevices[device.id]);
+        lastDevices[device.id] = device.counts;
+        if (!delta.empty()) {
+            store.setSeriesName(device.label.key, device.label.name);
+            store.add(device.label.key, minute, delta);
+        }
+    }
+
+    int64_t nowMinute = realtimeMs() / MINUTE_MS;
+    if (nowMinute - lastFlushMinute >= HISTORY_FLUSH_MINUTES) {
+        lastFlushMinute = nowMinute;
+        store.flush();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef HISTORYRECORDER_H
+#define HISTORYRECORDER_H
+
+#include "rollupstore.h"
+#include "statistics.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+class TrackerEngine;
+
+// Minutes between two writes of the pending minutes to disk
+constexpr int64_t HISTORY_FLUSH_MINUTES = 10;
+
+// Feeds a RollupStore from a running session. At each minute boundary the
+// engine's totals and per-device counters are sampled and the differences
+// since the last sample are added as that minute's row. The thread waits
+// in poll() on an eventfd raised by the engine's change signal and only
+// arms the minute timer after input, so an idle tracker costs it no
+// wakeups.
+class HistoryRecorder
+{
+public:
+    HistoryRecorder(const TrackerEngine& engine, RollupStore& store);
+    ~HistoryRecorder();
+
+    HistoryRecorder(const HistoryRecorder&) = delete;
+    HistoryRecorder& operator=(const HistoryRecorder&) = delete;
+
+    // Register with every device's processor before start()
+    ChangeSignal* changeSignal() { return &changed; }
+
+    bool start();
+    // Joins the thread, then records the minute in progress and flushes
+    void stop();
+
+private:
+    void run();
+    void sample(int64_t minute);
+
+    const TrackerEngine& engine;
+    RollupStore& store;
+
+    ChangeSignal changed;
+    int changeFd = -1;
+    int stopFd = -1;
+    std::thread thread;
+
+    // Counters at the previous sample; devices by DeviceStats::id
+    StatsSnapshot lastTotals;
+    std::vector<StatsSnapshot> lastDevices;
+    int64_t lastFlushMinute = 0;
+};
+
+#endif // HISTORYRECORDER_H
@@ -0,0 +1,72 @@
+#include "latencyhistogram.h"
+
+#include <algorithm>
+
+void LatencyCounts::merge(const LatencyCounts& other)
+{
+    for (std::size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    max = std::max(max, other.max);
+}
+
+LatencyPercentiles LatencyCounts::percentiles() const
+{
+    LatencyPercentiles result;
+    for (uint64_t count : buckets) {
+        result.count += count;
+    }
+    if (result.count == 0) {
+        return result;
+    }
+
+    // Report the middle of the bucket holding the requested rank
+    auto at = [this, &result](double q) {
+        uint64_t rank = static_cast<uint64_t>(q * (result.count - 1)) + 1;
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                double low = static_cast<double>(LatencyHistogram::bucketFloor(i));
+                double high = i + 1 < LATENCY_BUCKETS ? static_cast<double>(LatencyHistogram::bucketFloor(i + 1)) : low;
+                return std::min((low + high) / 2.0, static_cast<double>(max));
+            }
+        }
+        return static_cast<double>(max);
+    };
+    result.p50 = at(0.50);
+    result.p99 = at(0.99);
+    result.max = static_cast<double>(max);
+    return result;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+uint64_t LatencyHistogram::bucketFloor(std::size_t index)
+{
+    std::size_t tier = index / LATENCY_SUB_BUCKETS;
+    uint64_t sub = index % LATENCY_SUB_BUCKETS;
+    if (tier == 0) {
+        return sub;
+    }
+    return (LATENCY_SUB_BUCKETS + sub) << (tier - 1);
+}
+
+void LatencyHistogram::copyTo(LatencyCounts& counts) const
+{
+    for (std::size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        counts.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    counts.max = maxValue.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    maxValue.store(0, std::memory_order_relaxed);
+}
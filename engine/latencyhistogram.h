@@ -0,0 +1,75 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear buckets in the style of HdrHistogram: every power of two is
+// split into 16 linear sub-buckets, so any recorded value is known to
+// within about 6%. Values are microseconds; everything from 2^36 us (about
+// 19 hours) up lands in the last bucket. 528 counters, 4 KB, whatever the
+// range recorded. Counters are 64-bit so they cannot wrap on long runs.
+constexpr unsigned LATENCY_SUB_BUCKET_BITS = 4;
+constexpr std::size_t LATENCY_SUB_BUCKETS = std::size_t(1) << LATENCY_SUB_BUCKET_BITS;
+constexpr std::size_t LATENCY_BUCKETS = LATENCY_SUB_BUCKETS * 33;
+
+struct LatencyPercentiles {
+    uint64_t count = 0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Plain copy of a histogram, used to merge several devices
+struct LatencyCounts {
+    uint64_t buckets[LATENCY_BUCKETS] = {};
+    uint64_t max = 0;
+
+    void merge(const LatencyCounts& other);
+    LatencyPercentiles percentiles() const;
+};
+
+// Written by exactly one producer (the worker owning the device) with
+// plain load/store pairs, read from any thread.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t micros) {
+        std::atomic<uint64_t>& bucket = buckets[bucketIndex(micros)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (micros > maxValue.load(std::memory_order_relaxed)) {
+            maxValue.store(micros, std::memory_order_relaxed);
+        }
+    }
+
+    void copyTo(LatencyCounts& counts) const;
+    void reset();
+
+    static std::size_t bucketIndex(uint64_t value);
+    // Lowest value that falls into `index`
+    static uint64_t bucketFloor(std::size_t index);
+
+private:
+    std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+    std::atomic<uint64_t> maxValue{0};
+};
+
+inline std::size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS) {
+        return static_cast<std::size_t>(value);
+    }
+    unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+    std::size_t tier = msb - LATENCY_SUB_BUCKET_BITS + 1;
+    std::size_t sub = (value >> (msb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    std::size_t index = tier * LATENCY_SUB_BUCKETS + sub;
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+#endif // LATENCYHISTOGRAM_H
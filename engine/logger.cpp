@@ -0,0 +1,341 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t NANOS_PER_SECOND = 1000000000ull;
+// While there is traffic the drain thread batches output at this interval
+constexpr int DRAIN_BATCH_INTERVAL_MS = 10;
+
+uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const uint64_t processStartNs = nowNanos();
+
+} // namespace
+
+struct Logger::Ring {
+    LogRecord records[RING_CAPACITY];
+    alignas(64) std::atomic<std::size_t> head{0};   // consumer position
+    alignas(64) std::atomic<std::size_t> tail{0};   // producer position
+    std::atomic<bool> orphaned{false};
+    Ring* next = nullptr;   // set before the ring is published
+
+    // Trace rate limiting, touched only by the producing thread
+    uint64_t window_start_ns = 0;
+    uint32_t window_count = 0;
+    uint32_t suppressed = 0;
+    uint32_t clock_skips = 0;
+};
+
+namespace {
+
+// Marks the calling thread's ring as orphaned when the thread exits so the
+// drain thread can free it once it is empty.
+struct RingOwner {
+    std::atomic<bool>* orphaned = nullptr;
+    ~RingOwner() {
+        if (orphaned) {
+            orphaned->store(true, std::memory_order_release);
+        }
+    }
+};
+
+} // namespace
+
+bool parseLogLevel(const std::string& text, LogLevel& level)
+{
+    if (text == "off") {
+        level = LogLevel::Off;
+    } else if (text == "info") {
+        level = LogLevel::Info;
+    } else if (text == "debug") {
+        level = LogLevel::Debug;
+    } else if (text == "trace") {
+        level = LogLevel::Trace;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* logLevelName(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Off: return "off";
+    case LogLevel::Info: return "info";
+    case LogLevel::Debug: return "debug";
+    case LogLevel::Trace: return "trace";
+    }
+    return "unknown";
+}
+
+Logger& Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : outputFd(STDOUT_FILENO)
+{
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+Logger::~Logger()
+{
+    stop();
+    Ring* ring = rings.exchange(nullptr);
+    while (ring) {
+        Ring* next = ring->next;
+        delete ring;
+        ring = next;
+    }
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+    }
+}
+
+void Logger::setOutputFd(int fd)
+{
+    outputFd.store(fd);
+}
+
+void Logger::start()
+{
+    if (running.exchange(true)) {
+        return;
+    }
+    stopping.store(false);
+    drainThread = std::thread(&Logger::drainLoop, this);
+}
+
+void Logger::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    stopping.store(true);
+    uint64_t one = 1;
+    if (::write(wakeFd, &one, sizeof(one)) != sizeof(one)) {
+        // Counter saturated: the drainer is due to wake anyway
+    }
+    if (drainThread.joinable()) {
+        drainThread.join();
+    }
+}
+
+Logger::Ring& Logger::localRing()
+{
+    thread_local RingOwner ringOwner;
+    thread_local Ring* threadRing = nullptr;
+
+    if (threadRing == nullptr) {
+        Ring* ring = new Ring;
+        ring->next = rings.load(std::memory_order_relaxed);
+        while (!rings.compare_exchange_weak(ring->next, ring, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        ringOwner.orphaned = &ring->orphaned;
+        threadRing = ring;
+    }
+    return *threadRing;
+}
+
+void Logger::push(LogLevel level, const char* message, const char* subject, int32_t value, bool hasValue)
+{
+    Ring& ring = localRing();
+    std::size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring.records[tail % RING_CAPACITY];
+    record.timestamp_ns = nowNanos();
+    record.message = message;
+    record.value = value;
+    record.level = level;
+    record.has_value = hasValue;
+    if (subject) {
+        std::strncpy(record.subject, subject, sizeof(record.subject) - 1);
+        record.subject[sizeof(record.subject) - 1] = '\0';
+    } else {
+        record.subject[0] = '\0';
+    }
+
+    ring.tail.store(tail + 1, std::memory_order_release);
+    wakeDrainer();
+}
+
+void Logger::pushLimited(const char* message, const char* subject, int32_t value)
+{
+    Ring& ring = localRing();
+    // Over budget: only look at the clock every 64th record to notice the
+    // next window, everything else is counted and dropped right here.
+    if (ring.window_count >= TRACE_RATE_LIMIT && (++ring.clock_skips & 63u) != 0) {
+        ring.suppressed++;
+        return;
+    }
+
+    uint64_t now = nowNanos();
+    if (now - ring.window_start_ns >= NANOS_PER_SECOND) {
+        uint32_t suppressed = ring.suppressed;
+        ring.window_start_ns = now;
+        ring.window_count = 0;
+        ring.suppressed = 0;
+        if (suppressed > 0) {
+            push(LogLevel::Trace, "[logger] Trace records suppressed in the last second:", nullptr,
+                 static_cast<int32_t>(suppressed), true);
+        }
+    }
+
+    if (ring.window_count < TRACE_RATE_LIMIT) {
+        ring.window_count++;
+        push(LogLevel::Trace, message, subject, value, true);
+    } else {
+        ring.suppressed++;
+    }
+}
+
+void Logger::wakeDrainer()
+{
+    // Pairs with the fence in drainLoop(): either we see the drainer asleep,
+    // or it sees our record before it goes to sleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (drainerSleeping.load(std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        if (::write(wakeFd, &one, sizeof(one)) != sizeof(one)) {
+            // Counter saturated: the drainer is due to wake anyway
+        }
+    }
+}
+
+void Logger::waitForWake(int timeoutMs)
+{
+    if (wakeFd < 0) {
+        // No eventfd: poll() below just sleeps, so never for good
+        timeoutMs = DRAIN_BATCH_INTERVAL_MS;
+    }
+    pollfd fd{wakeFd, POLLIN, 0};
+    if (poll(&fd, 1, timeoutMs) > 0) {
+        uint64_t count;
+        if (::read(wakeFd, &count, sizeof(count)) != sizeof(count)) {
+            // Another read already reset the counter
+        }
+    }
+}
+
+bool Logger::drainOnce(std::string& buffer)
+{
+    buffer.clear();
+    bool found = false;
+    char line[160];
+
+    Ring* previous = nullptr;
+    Ring* ring = rings.load(std::memory_order_acquire);
+    while (ring) {
+        Ring* next = ring->next;
+        bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+        std::size_t head = ring->head.load(std::memory_order_relaxed);
+        std::size_t tail = ring->tail.load(std::memory_order_acquire);
+
+        for (; head != tail; ++head) {
+            const LogRecord& record = ring->records[head % RING_CAPACITY];
+            double seconds = static_cast<double>(record.timestamp_ns - processStartNs) / NANOS_PER_SECOND;
+            int length;
+            if (record.has_value) {
+                length = std::snprintf(line, sizeof(line), "[%12.6f] %s %s%s%d\n", seconds, record.message,
+                                       record.subject, record.subject[0] ? ": " : "", record.value);
+            } else {
+                length = std::snprintf(line, sizeof(line), "[%12.6f] %s %s\n", seconds, record.message,
+                                       record.subject);
+            }
+            buffer.append(line, std::min<std::size_t>(static_cast<std::size_t>(std::max(length, 0)), sizeof(line) - 1));
+            found = true;
+        }
+        ring->head.store(head, std::memory_order_release);
+
+        // Links behind the head are only ever changed here. The head itself
+        // moves when a thread registers; if one just did, the ring is freed
+        // on a later pass instead.
+        bool unlinked = false;
+        if (orphaned) {
+            if (previous) {
+                previous->next = next;
+                unlinked = true;
+            } else {
+                Ring* expected = ring;
+                unlinked = rings.compare_exchange_strong(expected, next, std::memory_order_acq_rel);
+            }
+        }
+        if (unlinked) {
+            delete ring;
+        } else {
+            previous = ring;
+        }
+        ring = next;
+    }
+
+    const int fd = outputFd.load();
+    std::size_t offset = 0;
+    while (offset < buffer.size()) {
+        ssize_t written = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += static_cast<std::size_t>(written);
+    }
+    return found;
+}
+
+void Logger::drainLoop()
+{
+    std::string buffer;
+    buffer.reserve(RING_CAPACITY * 96);
+
+    for (;;) {
+        if (drainOnce(buffer)) {
+            if (!stopping.load()) {
+                waitForWake(DRAIN_BATCH_INTERVAL_MS);
+            }
+            continue;
+        }
+
+        if (stopping.load()) {
+            while (drainOnce(buffer)) {
+            }
+            return;
+        }
+
+        // Nothing queued: announce that we are going to sleep, then check
+        // once more so a record pushed in between is not left behind.
+        drainerSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pending = false;
+        for (Ring* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+            if (ring->head.load(std::memory_order_relaxed) != ring->tail.load(std::memory_order_acquire)) {
+                pending = true;
+                break;
+            }
+        }
+        if (!pending && !stopping.load()) {
+            waitForWake(-1);
+        }
+        drainerSleeping.store(false, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+enum class LogLevel : uint8_t {
+    Off = 0,
+    Info,
+    Debug,
+    Trace
+};
+
+bool parseLogLevel(const std::string& text, LogLevel& level);
+const char* logLevelName(LogLevel level);
+
+// A log line in binary form. The hot path only fills one of these in; the
+// drain thread turns it into text. `message` must be a string literal.
+struct LogRecord {
+    uint64_t timestamp_ns;
+    const char* message;
+    int32_t value;
+    LogLevel level;
+    bool has_value;
+    char subject[38];
+};
+
+static_assert(sizeof(LogRecord) == 64, "LogRecord should stay one cache line");
+
+// Asynchronous leveled logger. Each producing thread owns a single-producer
+// single-consumer ring; a background thread drains all rings, formats the
+// records and writes them out in batches. Producers never block and never
+// take a lock: a thread's first record pushes its ring onto a lock-free
+// list, a record arriving while the drainer sleeps wakes it through an
+// eventfd, and when a ring is full the record is dropped and counted.
+class Logger
+{
+public:
+    static Logger& instance();
+
+    static LogLevel level() { return instance().currentLevel.load(std::memory_order_relaxed); }
+    static void setLevel(LogLevel level) { instance().currentLevel.store(level, std::memory_order_relaxed); }
+    static bool enabled(LogLevel level) {
+        return level != LogLevel::Off && level <= instance().currentLevel.load(std::memory_order_relaxed);
+    }
+
+    // Cheap when the level is disabled: one relaxed load and a branch.
+    static void log(LogLevel level, const char* message, const char* subject = nullptr) {
+        if (enabled(level)) {
+            instance().push(level, message, subject, 0, false);
+        }
+    }
+    static void log(LogLevel level, const char* message, const char* subject, int32_t value) {
+        if (enabled(level)) {
+            instance().push(level, message, subject, value, true);
+        }
+    }
+
+    // Trace logging for high-rate events. At most TRACE_RATE_LIMIT records
+    // per second per thread get through; the rest are summarised.
+    static void trace(const char* message, const char* subject, int32_t value) {
+        if (enabled(LogLevel::Trace)) {
+            instance().pushLimited(message, subject, value);
+        }
+    }
+
+    // Where formatted lines go. Defaults to stdout.
+    void setOutputFd(int fd);
+
+    void start();
+    // Drains everything still queued, then stops the drain thread.
+    void stop();
+
+    uint64_t droppedRecords() const { return dropped.load(std::memory_order_relaxed); }
+
+    static constexpr std::size_t RING_CAPACITY = 1024;
+    static constexpr uint32_t TRACE_RATE_LIMIT = 200;
+
+private:
+    struct Ring;
+
+    Logger();
+    ~Logger();
+
+    void push(LogLevel level, const char* message, const char* subject, int32_t value, bool hasValue);
+    void pushLimited(const char* message, const char* subject, int32_t value);
+    Ring& localRing();
+    void wakeDrainer();
+    // Waits for a wakeup, at most `timeoutMs` (-1 = no limit)
+    void waitForWake(int timeoutMs);
+    bool drainOnce(std::string& buffer);
+    void drainLoop();
+
+    std::atomic<LogLevel> currentLevel{LogLevel::Info};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<int> outputFd;
+
+    // Newest ring first. Producers only push at the head; only the drain
+    // thread unlinks rings.
+    std::atomic<Ring*> rings{nullptr};
+
+    std::thread drainThread;
+    int wakeFd = -1;
+    std::atomic<bool> drainerSleeping{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> running{false};
+};
+
+#endif // LOGGER_H
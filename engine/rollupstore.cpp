@@ -0,0 +1,1013 @@
+#include "rollupstore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Column of the minutes with any input. A minute row holds 0 or 1 however
+// often the minute was flushed; hours and days sum their minutes.
+constexpr std::size_t ACTIVE_COLUMN = 5;
+
+// Below this the file is never rewritten, whatever the dead share
+constexpr uint64_t ROLLUP_COMPACT_MIN_BYTES = 256 * 1024;
+
+enum RecordKind : uint32_t {
+    RECORD_SERIES = 1,      // body: key, NUL, name
+    RECORD_BLOCK = 2,       // body: column modes, period column, value columns
+    RECORD_HORIZON = 3,     // body: first minute block still kept, int64
+    RECORD_COMMIT = 4       // empty; the records since the previous commit count
+};
+
+
+enum ColumnMode : uint8_t {
+    COLUMN_PLAIN = 0,       // varints
+    COLUMN_DELTA = 1,       // first value, then zigzag varint differences
+    COLUMN_CONSTANT = 2     // one varint for every row
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// Precedes every record. The checksum covers the header (with the checksum
+// field zero) and the body.
+struct RecordHeader {
+    uint32_t kind;
+    uint32_t bytes;         // body bytes following the header
+    uint32_t checksum;
+    uint32_t series;
+    uint32_t tier;
+    uint32_t rows;
+    int64_t window;         // first second of the block's window
+    uint64_t totals[ROLLUP_COLUMNS];
+};
+
+static_assert(sizeof(RecordHeader) == 80, "RecordHeader layout changed");
+static_assert(ROLLUP_BLOCK_SECONDS[static_cast<std::size_t>(RollupTier::Hours)] ==
+                  ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(RollupTier::Days)],
+              "whole days are summed from hour block totals");
+
+int64_t floorTo(int64_t value, int64_t step)
+{
+    int64_t rest = value % step;
+    return rest < 0 ? value - rest - step : value - rest;
+}
+
+int64_t ceilTo(int64_t value, int64_t step)
+{
+    int64_t floor = floorTo(value, step);
+    return floor == value ? value : floor + step;
+}
+
+uint32_t checksum(const RecordHeader& header, const char* body, std::size_t bytes)
+{
+    RecordHeader copy = header;
+    copy.checksum = 0;
+    uint32_t hash = 2166136261u;
+    const unsigned char* bytesOf = reinterpret_cast<const unsigned char*>(&copy);
+    for (std::size_t i = 0; i < sizeof(copy); ++i) {
+        hash = (hash ^ bytesOf[i]) * 16777619u;
+    }
+    for (std::size_t i = 0; i < bytes; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(body[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Header and body of one record, with size and checksum filled in
+std::string encodeRecord(RecordHeader header, const std::string& body)
+{
+    header.bytes = static_cast<uint32_t>(body.size());
+    header.checksum = checksum(header, body.data(), body.size());
+    std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record += body;
+    return record;
+}
+
+std::string seriesBody(const std::string& key, const std::string& name)
+{
+    std::string body = key;
+    body += '\0';
+    body += name;
+    return body;
+}
+
+void putVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t varintSize(uint64_t value)
+{
+    std::size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+uint64_t zigzag(uint64_t from, uint64_t to)
+{
+    int64_t delta = static_cast<int64_t>(to - from);
+    return (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+}
+
+uint64_t unzigzag(uint64_t value)
+{
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+// Picks whichever coding of one column is smallest and appends it
+void encodeColumn(const std::vector<uint64_t>& values, std::string& out, uint8_t& mode)
+{
+    bool constant = true;
+    std::size_t plain = 0;
+    std::size_t delta = 0;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        constant = constant && values[i] == values[0];
+        plain += varintSize(values[i]);
+        delta += varintSize(i == 0 ? values[0] : zigzag(values[i - 1], values[i]));
+    }
+    if (constant) {
+        mode = COLUMN_CONSTANT;
+        putVarint(out, values.empty() ? 0 : values[0]);
+    } else if (delta < plain) {
+        mode = COLUMN_DELTA;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            putVarint(out, i == 0 ? values[0] : zigzag(values[i - 1], values[i]));
+        }
+    } else {
+        mode = COLUMN_PLAIN;
+        for (uint64_t value : values) {
+            putVarint(out, value);
+        }
+    }
+}
+
+void makeDirectories(const std::string& path)
+{
+    for (std::size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+    mkdir(path.c_str(), 0755);
+}
+
+bool writeAll(int fd, const std::string& data, uint64_t offset)
+{
+    std::size_t done = 0;
+    while (done < data.size()) {
+        ssize_t written = pwrite(fd, data.data() + done, data.size() - done, static_cast<off_t>(offset + done));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        done += static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, std::size_t bytes, uint64_t offset)
+{
+    std::size_t done = 0;
+    while (done < bytes) {
+        ssize_t got = pread(fd, data + done, bytes - done, static_cast<off_t>(offset + done));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        done += static_cast<std::size_t>(got);
+    }
+    return true;
+}
+
+} // namespace
+
+RollupStore::RollupStore(RollupOptions options)
+    : options(std::move(options))
+{
+}
+
+RollupStore::~RollupStore()
+{
+    close();
+}
+
+bool RollupStore::open()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd >= 0) {
+        return true;
+    }
+    if (options.directory.empty()) {
+        return false;
+    }
+    path = options.directory + "/" + ROLLUP_FILE_NAME;
+    if (options.readOnly) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+    } else {
+        makeDirectories(options.directory);
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "Cannot open history " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+            std::cerr << "History " << path << " is written by another tracker\n";
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+    if (!load()) {
+        ::close(fd);
+        fd = -1;
+        seriesList.clear();
+        seriesIds.clear();
+        return false;
+    }
+    return true;
+}
+
+void RollupStore::close()
+{
+    if (!options.readOnly) {
+        flush();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    seriesList.clear();
+    seriesIds.clear();
+    endOffset = 0;
+    dead = 0;
+    minuteHorizon = 0;
+}
+
+// Indexes every record. A short or corrupt record is where the last writer
+// stopped; the writer cuts the file there.
+bool RollupStore::load()
+{
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        return false;
+    }
+    std::string data(static_cast<std::size_t>(info.st_size), '\0');
+    if (!data.empty() && !readAll(fd, &data[0], data.size(), 0)) {
+        std::cerr << "Cannot read history " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    if (data.size() < sizeof(FileHeader)) {
+        if (options.readOnly) {
+            return false;
+        }
+        FileHeader header{};
+        std::memcpy(header.magic, ROLLUP_MAGIC, sizeof(header.magic));
+        header.version = ROLLUP_VERSION;
+        std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (ftruncate(fd, 0) < 0 || !writeAll(fd, bytes, 0)) {
+            std::cerr << "Cannot write history " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        endOffset = sizeof(header);
+        return true;
+    }
+    FileHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, ROLLUP_MAGIC, sizeof(header.magic)) != 0 || header.version != ROLLUP_VERSION) {
+        std::cerr << path << " is not a history file of this version\n";
+        return false;
+    }
+
+    // Records are checked as they are read but only indexed at their
+    // batch's commit record, so a flush cut short leaves no trace
+    uint64_t offset = sizeof(FileHeader);
+    uint64_t committed = offset;
+    std::size_t knownSeries = 0;
+    std::vector<uint64_t> batch;
+    while (data.size() - offset >= sizeof(RecordHeader)) {
+        RecordHeader record;
+        std::memcpy(&record, data.data() + offset, sizeof(record));
+        const char* body = data.data() + offset + sizeof(record);
+        if (record.bytes > data.size() - offset - sizeof(record) ||
+            checksum(record, body, record.bytes) != record.checksum) {
+            break;
+        }
+        const uint64_t next = offset + sizeof(record) + record.bytes;
+
+        if (record.kind == RECORD_SERIES) {
+            if (std::memchr(body, '\0', record.bytes) == nullptr || record.series > knownSeries) {
+                break;
+            }
+            knownSeries += record.series == knownSeries;
+        } else if (record.kind == RECORD_BLOCK) {
+            if (record.series >= knownSeries || record.tier >= ROLLUP_TIERS) {
+                break;
+            }
+        } else if (record.kind == RECORD_HORIZON) {
+            if (record.bytes != sizeof(int64_t)) {
+                break;
+            }
+        } else if (record.kind != RECORD_COMMIT) {
+            break;
+        }
+
+        if (record.kind == RECORD_COMMIT) {
+            for (uint64_t at : batch) {
+                indexRecord(data, at);
+            }
+            batch.clear();
+            committed = next;
+        } else {
+            batch.push_back(offset);
+        }
+        offset = next;
+    }
+
+    // Blocks that fell behind the horizon are no longer live
+    for (Series& series : seriesList) {
+        auto& minutes = series.blocks[static_cast<std::size_t>(RollupTier::Minutes)];
+        for (auto it = minutes.begin(); it != minutes.end() && it->first < minuteHorizon;) {
+            dead += it->second.bytes;
+            it = minutes.erase(it);
+        }
+    }
+
+    endOffset = committed;
+    if (committed < data.size() && !options.readOnly) {
+        std::cerr << "History " << path << ": dropping " << data.size() - committed
+                  << " uncommitted or unreadable byte(s) at the end\n";
+        if (ftruncate(fd, static_cast<off_t>(committed)) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds one record load() has checked to the index
+void RollupStore::indexRecord(const std::string& data, uint64_t offset)
+{
+    RecordHeader record;
+    std::memcpy(&record, data.data() + offset, sizeof(record));
+    const char* body = data.data() + offset + sizeof(record);
+    if (record.kind == RECORD_SERIES) {
+        std::string text(body, record.bytes);
+        std::size_t separator = text.find('\0');
+        if (record.series == seriesList.size()) {
+            seriesList.emplace_back();
+            seriesList.back().id = record.series;
+        }
+        Series& series = seriesList[record.series];
+        series.key = text.substr(0, separator);
+        series.name = text.substr(separator + 1);
+        series.written = true;
+        seriesIds[series.key] = record.series;
+    } else if (record.kind == RECORD_BLOCK) {
+        BlockRef& block = seriesList[record.series].blocks[record.tier][record.window];
+        dead += block.bytes;
+        block.offset = offset;
+        block.bytes = static_cast<uint32_t>(sizeof(record) + record.bytes);
+        block.rows = record.rows;
+        std::copy(record.totals, record.totals + ROLLUP_COLUMNS, block.totals.begin());
+    } else if (record.kind == RECORD_HORIZON) {
+        std::memcpy(&minuteHorizon, body, sizeof(minuteHorizon));
+    }
+}
+
+RollupStore::Series& RollupStore::seriesFor(const std::string& key)
+{
+    auto it = seriesIds.find(key);
+    if (it != seriesIds.end()) {
+        return seriesList[it->second];
+    }
+    uint32_t id = static_cast<uint32_t>(seriesList.size());
+    seriesIds[key] = id;
+    seriesList.emplace_back();
+    Series& series = seriesList.back();
+    series.id = id;
+    series.key = key;
+    series.name = key.empty() ? "all devices" : key;
+    return series;
+}
+
+const RollupStore::Series* RollupStore::findSeries(const std::string& key) const
+{
+    auto it = seriesIds.find(key);
+    return it == seriesIds.end() ? nullptr : &seriesList[it->second];
+}
+
+void RollupStore::add(const std::string& key, int64_t minute, const StatsSnapshot& counts)
+{
+    if (counts.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    seriesFor(key).pending[floorTo(minute, ROLLUP_PERIOD_SECONDS[0])] += counts;
+}
+
+void RollupStore::setSeriesName(const std::string& key, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Series& series = seriesFor(key);
+    if (series.name != name) {
+        series.name = name;
+        series.written = false;
+    }
+}
+
+// Queues a record for the next commit; `offset` is where it will land
+void RollupStore::appendRecord(const std::string& record, uint64_t* offset)
+{
+    if (offset) {
+        *offset = endOffset + batch.size();
+    }
+    batch += record;
+}
+
+// Writes the queued records and a commit record in one go. On failure
+// nothing of the batch counts: the file is cut back and re-indexed, and
+// the pending minutes are kept for the next flush.
+bool RollupStore::commitBatch()
+{
+    if (batch.empty()) {
+        return true;
+    }
+    RecordHeader header{};
+    header.kind = RECORD_COMMIT;
+    batch += encodeRecord(header, std::string());
+    bool ok = writeAll(fd, batch, endOffset) && fdatasync(fd) == 0;
+    if (ok) {
+        endOffset += batch.size();
+        batch.clear();
+        return true;
+    }
+    std::cerr << "Cannot write history " << path << ": " << strerror(errno) << "\n";
+    batch.clear();
+    if (ftruncate(fd, static_cast<off_t>(endOffset)) < 0) {
+        std::cerr << "Cannot cut history " << path << " back: " << strerror(errno) << "\n";
+    }
+
+    std::vector<Series> kept;
+    kept.swap(seriesList);
+    seriesIds.clear();
+    dead = 0;
+    minuteHorizon = 0;
+    if (!load()) {
+        std::cerr << "Cannot re-read history " << path << "\n";
+    }
+    for (Series& old : kept) {
+        Series& series = seriesFor(old.key);
+        if (series.name != old.name || !old.written) {
+            series.name = old.name;
+            series.written = false;
+        }
+        series.pending = std::move(old.pending);
+    }
+    return false;
+}
+
+void RollupStore::writeSeries(Series& series)
+{
+    RecordHeader header{};
+    header.kind = RECORD_SERIES;
+    header.series = series.id;
+    appendRecord(encodeRecord(header, seriesBody(series.key, series.name)), nullptr);
+    series.written = true;
+}
+
+bool RollupStore::readBlock(const BlockRef& block, RollupTier tier, int64_t window, RowMap& rows) const
+{
+    std::string data(block.bytes, '\0');
+    if (!readAll(fd, &data[0], data.size(), block.offset)) {
+        return false;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + sizeof(RecordHeader);
+    const unsigned char* end = reinterpret_cast<const unsigned char*>(data.data()) + data.size();
+    if (end - p < static_cast<std::ptrdiff_t>(ROLLUP_COLUMNS)) {
+        return false;
+    }
+    const unsigned char* modes = p;
+    p += ROLLUP_COLUMNS;
+
+    const int64_t period = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(tier)];
+    std::vector<int64_t> periods(block.rows);
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < block.rows; ++i) {
+        uint64_t gap;
+        if (!getVarint(p, end, gap)) {
+            return false;
+        }
+        offset += gap;
+        periods[i] = window + static_cast<int64_t>(offset) * period;
+    }
+
+    std::vector<Columns*> targets(block.rows);
+    for (uint32_t i = 0; i < block.rows; ++i) {
+        targets[i] = &rows[periods[i]];
+    }
+    for (std::size_t column = 0; column < ROLLUP_COLUMNS; ++column) {
+        uint64_t value = 0;
+        if (modes[column] == COLUMN_CONSTANT && !getVarint(p, end, value)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < block.rows; ++i) {
+            if (modes[column] != COLUMN_CONSTANT) {
+                uint64_t coded;
+                if (!getVarint(p, end, coded)) {
+                    return false;
+                }
+                value = modes[column] == COLUMN_DELTA && i > 0 ? value + unzigzag(coded) : coded;
+            }
+            (*targets[i])[column] += value;
+        }
+    }
+    return true;
+}
+
+// Adds `rows` to the block of `window`, or starts it. The merged block is
+// appended; the one it replaces becomes dead.
+void RollupStore::mergeBlock(Series& series, RollupTier tier, int64_t window, const RowMap& rows)
+{
+    auto& blocks = series.blocks[static_cast<std::size_t>(tier)];
+    auto existing = blocks.find(window);
+    RowMap merged;
+    if (existing != blocks.end() && !readBlock(existing->second, tier, window, merged)) {
+        std::cerr << "History " << path << ": cannot read a block, rewriting it from new data only\n";
+        merged.clear();
+    }
+    for (const auto& row : rows) {
+        Columns& target = merged[row.first];
+        for (std::size_t column = 0; column < ROLLUP_COLUMNS; ++column) {
+            if (column == ACTIVE_COLUMN && tier == RollupTier::Minutes) {
+                target[column] = std::max(target[column], row.second[column]);
+            } else {
+                target[column] += row.second[column];
+            }
+        }
+    }
+
+    const int64_t period = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(tier)];
+    RecordHeader header{};
+    header.kind = RECORD_BLOCK;
+    header.series = series.id;
+    header.tier = static_cast<uint32_t>(tier);
+    header.rows = static_cast<uint32_t>(merged.size());
+    header.window = window;
+
+    std::string body(ROLLUP_COLUMNS, '\0');
+    int64_t previous = 0;
+    for (const auto& row : merged) {
+        int64_t offset = (row.first - window) / period;
+        putVarint(body, static_cast<uint64_t>(offset - previous));
+        previous = offset;
+    }
+    std::vector<uint64_t> values(merged.size());
+    for (std::size_t column = 0; column < ROLLUP_COLUMNS; ++column) {
+        std::size_t i = 0;
+        for (const auto& row : merged) {
+            values[i++] = row.second[column];
+            header.totals[column] += row.second[column];
+        }
+        uint8_t mode;
+        encodeColumn(values, body, mode);
+        body[column] = static_cast<char>(mode);
+    }
+
+    uint64_t offset;
+    appendRecord(encodeRecord(header, body), &offset);
+    BlockRef& block = blocks[window];
+    dead += block.bytes;
+    block.offset = offset;
+    block.bytes = static_cast<uint32_t>(sizeof(header) + body.size());
+    block.rows = header.rows;
+    std::copy(header.totals, header.totals + ROLLUP_COLUMNS, block.totals.begin());
+}
+
+void RollupStore::dropExpiredMinutes()
+{
+    if (options.minuteRetentionDays <= 0) {
+        return;
+    }
+    const int64_t day = ROLLUP_BLOCK_SECONDS[static_cast<std::size_t>(RollupTier::Minutes)];
+    int64_t horizon = floorTo(static_cast<int64_t>(time(nullptr)), day) - options.minuteRetentionDays * day;
+    if (horizon <= minuteHorizon) {
+        return;
+    }
+    RecordHeader header{};
+    header.kind = RECORD_HORIZON;
+    std::string body(reinterpret_cast<const char*>(&horizon), sizeof(horizon));
+    appendRecord(encodeRecord(header, body), nullptr);
+    minuteHorizon = horizon;
+    for (Series& series : seriesList) {
+        auto& minutes = series.blocks[static_cast<std::size_t>(RollupTier::Minutes)];
+        for (auto it = minutes.begin(); it != minutes.end() && it->first < minuteHorizon;) {
+            dead += it->second.bytes;
+            it = minutes.erase(it);
+        }
+    }
+}
+
+// The minute a previous run stopped in was flushed then and is pending
+// again; it must not count as a second active minute
+std::set<int64_t> RollupStore::minutesOnDisk(const Series& series, int64_t from, int64_t to) const
+{
+    std::set<int64_t> result;
+    const int64_t span = ROLLUP_BLOCK_SECONDS[static_cast<std::size_t>(RollupTier::Minutes)];
+    const auto& blocks = series.blocks[static_cast<std::size_t>(RollupTier::Minutes)];
+    int64_t window = 0;
+    bool loaded = false;
+    RowMap rows;
+    for (auto it = series.pending.lower_bound(from); it != series.pending.end() && it->first < to; ++it) {
+        int64_t start = floorTo(it->first, span);
+        if (!loaded || start != window) {
+            window = start;
+            loaded = true;
+            rows.clear();
+            auto block = blocks.find(window);
+            if (block != blocks.end()) {
+                readBlock(block->second, RollupTier::Minutes, window, rows);
+            }
+        }
+        auto row = rows.find(it->first);
+        if (row != rows.end() && row->second[ACTIVE_COLUMN] != 0) {
+            result.insert(it->first);
+        }
+    }
+    return result;
+}
+
+bool RollupStore::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0 || options.readOnly) {
+        return false;
+    }
+    // One batch: the minutes and their hours and days reach the file
+    // together or not at all, so the tiers never disagree
+    dropExpiredMinutes();
+    for (Series& series : seriesList) {
+        if (!series.written) {
+            writeSeries(series);
+        }
+        if (series.pending.empty()) {
+            continue;
+        }
+        // Every pending minute goes into its minute, hour and day row
+        const std::set<int64_t> repeated = minutesOnDisk(series, INT64_MIN, INT64_MAX);
+        std::map<int64_t, RowMap> windows[ROLLUP_TIERS];
+        for (const auto& minute : series.pending) {
+            const StatsSnapshot& counts = minute.second;
+            Columns columns = {counts.keyboard_count,
+                               counts.mouse_count,
+                               counts.scroll_count,
+                               counts.event_count,
+                               static_cast<uint64_t>(std::llround(std::max(0.0, counts.mouse_distance))),
+                               repeated.count(minute.first) ? 0u : 1u};
+            for (std::size_t tier = 0; tier < ROLLUP_TIERS; ++tier) {
+                Columns& row = windows[tier][floorTo(minute.first, ROLLUP_BLOCK_SECONDS[tier])]
+                                      [floorTo(minute.first, ROLLUP_PERIOD_SECONDS[tier])];
+                for (std::size_t column = 0; column < ROLLUP_COLUMNS; ++column) {
+                    row[column] += columns[column];
+                }
+            }
+        }
+        for (std::size_t tier = 0; tier < ROLLUP_TIERS; ++tier) {
+            for (const auto& window : windows[tier]) {
+                if (tier == static_cast<std::size_t>(RollupTier::Minutes) && window.first < minuteHorizon) {
+                    continue;
+                }
+                mergeBlock(series, static_cast<RollupTier>(tier), window.first, window.second);
+            }
+        }
+    }
+    bool ok = commitBatch();
+    if (ok) {
+        for (Series& series : seriesList) {
+            series.pending.clear();
+        }
+    }
+
+    const uint64_t live = endOffset - dead;
+    if (ok && dead > live && dead > ROLLUP_COMPACT_MIN_BYTES) {
+        ok = rewrite();
+    }
+    return ok;
+}
+
+bool RollupStore::compact()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0 || options.readOnly) {
+        return false;
+    }
+    return rewrite();
+}
+
+// Copies the live records into a new file and renames it over the old one;
+// readers that opened the old file keep reading it.
+bool RollupStore::rewrite()
+{
+    FileHeader fileHeader{};
+    std::memcpy(fileHeader.magic, ROLLUP_MAGIC, sizeof(fileHeader.magic));
+    fileHeader.version = ROLLUP_VERSION;
+    std::string data(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    data.reserve(endOffset - dead);
+
+    if (minuteHorizon) {
+        RecordHeader header{};
+        header.kind = RECORD_HORIZON;
+        data += encodeRecord(header, std::string(reinterpret_cast<const char*>(&minuteHorizon), sizeof(minuteHorizon)));
+    }
+    std::vector<std::pair<BlockRef*, uint64_t>> moved;
+    for (Series& series : seriesList) {
+        RecordHeader header{};
+        header.kind = RECORD_SERIES;
+        header.series = series.id;
+        data += encodeRecord(header, seriesBody(series.key, series.name));
+        for (auto& blocks : series.blocks) {
+            for (auto& block : blocks) {
+                BlockRef& ref = block.second;
+                uint64_t offset = data.size();
+                data.resize(offset + ref.bytes);
+                if (!readAll(fd, &data[offset], ref.bytes, ref.offset)) {
+                    std::cerr << "Cannot read history " << path << ": " << strerror(errno) << "\n";
+                    return false;
+                }
+                moved.emplace_back(&ref, offset);
+            }
+        }
+    }
+
+    RecordHeader commit{};
+    commit.kind = RECORD_COMMIT;
+    data += encodeRecord(commit, std::string());
+
+    const std::string newPath = path + ".tmp";
+    int newFd = ::open(newPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (newFd < 0 || flock(newFd, LOCK_EX | LOCK_NB) < 0 || !writeAll(newFd, data, 0) || fdatasync(newFd) < 0 ||
+        rename(newPath.c_str(), path.c_str()) < 0) {
+        std::cerr << "Cannot compact history " << path << ": " << strerror(errno) << "\n";
+        if (newFd >= 0) {
+            ::close(newFd);
+            unlink(newPath.c_str());
+        }
+        return false;
+    }
+    ::close(fd);
+    fd = newFd;
+    for (auto& entry : moved) {
+        entry.first->offset = entry.second;
+    }
+    for (Series& series : seriesList) {
+        series.written = true;
+    }
+    endOffset = data.size();
+    dead = 0;
+    return true;
+}
+
+// Sums the rows of one tier with periods in [from, to), both aligned to the
+// tier's period. Blocks inside the range only contribute their totals.
+void RollupStore::sumRange(const Series& series, RollupTier tier, int64_t from, int64_t to, Columns& totals,
+                           RollupSummary& summary) const
+{
+    if (from >= to) {
+        return;
+    }
+    const int64_t span = ROLLUP_BLOCK_SECONDS[static_cast<std::size_t>(tier)];
+    const auto& blocks = series.blocks[static_cast<std::size_t>(tier)];
+    for (auto it = blocks.lower_bound(floorTo(from, span)); it != blocks.end() && it->first < to; ++it) {
+        if (it->first >= from && it->first + span <= to) {
+            for (std::size_t column = 0; column < ROLLUP_COLUMNS; ++column) {
+                totals[column] += it->second.totals[column];
+            }
+            ++summary.blocksSummed;
+            continue;
+        }
+        RowMap rows;
+        if (!readBlock(it->second, tier, it->first, rows)) {
+            continue;
+        }
+        ++summary.blocksDecoded;
+        for (auto row = rows.lower_bound(from); row != rows.end() && row->first < to; ++row) {
+            for (std::size_t column = 0; column < ROLLUP_COLUMNS; ++column) {
+                totals[column] += row->second[column];
+            }
+        }
+    }
+}
+
+// Minute-aligned range. Minutes behind the retention horizon are gone; those
+// parts are answered from their whole hours instead.
+void RollupStore::sumMinutes(const Series& series, int64_t from, int64_t to, Columns& totals,
+                             RollupSummary& summary) const
+{
+    if (from >= to) {
+        return;
+    }
+    if (from >= minuteHorizon) {
+        sumRange(series, RollupTier::Minutes, from, to, totals, summary);
+        return;
+    }
+    const int64_t hour = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(RollupTier::Hours)];
+    int64_t hoursFrom = floorTo(from, hour);
+    int64_t hoursTo = std::min(ceilTo(to, hour), minuteHorizon);
+    sumRange(series, RollupTier::Hours, hoursFrom, hoursTo, totals, summary);
+    sumRange(series, RollupTier::Minutes, minuteHorizon, to, totals, summary);
+    summary.from = std::min(summary.from, hoursFrom);
+    summary.to = std::max(summary.to, hoursTo);
+}
+
+// Whole hours from the hour tier, the ragged ends from minutes
+void RollupStore::sumHours(const Series& series, int64_t from, int64_t to, Columns& totals,
+                           RollupSummary& summary) const
+{
+    const int64_t hour = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(RollupTier::Hours)];
+    int64_t hoursFrom = ceilTo(from, hour);
+    int64_t hoursTo = floorTo(to, hour);
+    if (hoursFrom >= hoursTo) {
+        sumMinutes(series, from, to, totals, summary);
+        return;
+    }
+    sumMinutes(series, from, hoursFrom, totals, summary);
+    sumRange(series, RollupTier::Hours, hoursFrom, hoursTo, totals, summary);
+    sumMinutes(series, hoursTo, to, totals, summary);
+}
+
+// Whole days: whole windows of the day tier from their totals, the days
+// around them from the totals of their hour blocks. Nothing is decoded.
+void RollupStore::sumDays(const Series& series, int64_t from, int64_t to, Columns& totals,
+                          RollupSummary& summary) const
+{
+    const int64_t span = ROLLUP_BLOCK_SECONDS[static_cast<std::size_t>(RollupTier::Days)];
+    int64_t windowsFrom = ceilTo(from, span);
+    int64_t windowsTo = floorTo(to, span);
+    if (windowsFrom >= windowsTo) {
+        sumRange(series, RollupTier::Hours, from, to, totals, summary);
+        return;
+    }
+    sumRange(series, RollupTier::Hours, from, windowsFrom, totals, summary);
+    sumRange(series, RollupTier::Days, windowsFrom, windowsTo, totals, summary);
+    sumRange(series, RollupTier::Hours, windowsTo, to, totals, summary);
+}
+
+RollupSummary RollupStore::query(int64_t from, int64_t to, const std::string& key) const
+{
+    const int64_t minute = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(RollupTier::Minutes)];
+    const int64_t day = ROLLUP_PERIOD_SECONDS[static_cast<std::size_t>(RollupTier::Days)];
+    RollupSummary summary;
+    summary.from = floorTo(from, minute);
+    summary.to = ceilTo(to, minute);
+    if (summary.to <= summary.from) {
+        summary.to = summary.from;
+        return summary;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const Series* series = findSeries(key);
+    if (!series) {
+        return summary;
+    }
+    const int64_t begin = summary.from;
+    const int64_t end = summary.to;
+    Columns totals{};
+    int64_t daysFrom = ceilTo(begin, day);
+    int64_t daysTo = floorTo(end, day);
+    if (daysFrom < daysTo) {
+        sumHours(*series, begin, daysFrom, totals, summary);
+        sumDays(*series, daysFrom, daysTo, totals, summary);
+        sumHours(*series, daysTo, end, totals, summary);
+    } else {
+        sumHours(*series, begin, end, totals, summary);
+    }
+
+    StatsSnapshot pending;
+    const std::set<int64_t> repeated = minutesOnDisk(*series, begin, end);
+    for (auto it = series->pending.lower_bound(begin); it != series->pending.end() && it->first < end; ++it) {
+        pending += it->second;
+        totals[ACTIVE_COLUMN] += repeated.count(it->first) ? 0 : 1;
+    }
+
+    summary.totals.keyboard_count = totals[0];
+    summary.totals.mouse_count = totals[1];
+    summary.totals.scroll_count = totals[2];
+    summary.totals.event_count = totals[3];
+    summary.totals.mouse_distance = static_cast<double>(totals[4]);
+    summary.totals += pending;
+    summary.activeMinutes = totals[ACTIVE_COLUMN];
+    return summary;
+}
+
+std::vector<RollupRow> RollupStore::rows(RollupTier tier, int64_t from, int64_t to, const std::string& key) const
+{
+    std::vector<RollupRow> result;
+    std::lock_guard<std::mutex> lock(mutex);
+    const Series* series = findSeries(key);
+    if (!series || from >= to) {
+        return result;
+    }
+    const std::size_t index = static_cast<std::size_t>(tier);
+    const int64_t span = ROLLUP_BLOCK_SECONDS[index];
+    const auto& blocks = series->blocks[index];
+    RowMap rows;
+    for (auto it = blocks.lower_bound(floorTo(from, span)); it != blocks.end() && it->first < to; ++it) {
+        readBlock(it->second, tier, it->first, rows);
+    }
+
+    std::map<int64_t, RollupRow> pending;
+    const std::set<int64_t> repeated = minutesOnDisk(*series, INT64_MIN, INT64_MAX);
+    for (const auto& minute : series->pending) {
+        RollupRow& row = pending[floorTo(minute.first, ROLLUP_PERIOD_SECONDS[index])];
+        row.counts += minute.second;
+        row.activeMinutes += repeated.count(minute.first) ? 0 : 1;
+    }
+
+    for (auto it = rows.lower_bound(from); it != rows.end() && it->first < to; ++it) {
+        RollupRow row;
+        row.period = it->first;
+        row.counts.keyboard_count = it->second[0];
+        row.counts.mouse_count = it->second[1];
+        row.counts.scroll_count = it->second[2];
+        row.counts.event_count = it->second[3];
+        row.counts.mouse_distance = static_cast<double>(it->second[4]);
+        row.activeMinutes = it->second[ACTIVE_COLUMN];
+        auto extra = pending.find(it->first);
+        if (extra != pending.end()) {
+            row.counts += extra->second.counts;
+            row.activeMinutes += extra->second.activeMinutes;
+            pending.erase(extra);
+        }
+        result.push_back(row);
+    }
+    for (auto& extra : pending) {
+        if (extra.first >= from && extra.first < to) {
+            extra.second.period = extra.first;
+            result.push_back(extra.second);
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const RollupRow& a, const RollupRow& b) { return a.period < b.period; });
+    return result;
+}
+
+std::vector<RollupSeries> RollupStore::series() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<RollupSeries> result;
+    for (const Series& series : seriesList) {
+        result.push_back(RollupSeries{series.key, series.name});
+    }
+    return result;
+}
+
+uint64_t RollupStore::fileBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return endOffset;
+}
+
+uint64_t RollupStore::deadBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return dead;
+}
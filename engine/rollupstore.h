@@ -0,0 +1,183 @@
+#ifndef ROLLUPSTORE_H
+#define ROLLUPSTORE_H
+
+#include "statistics.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Resolutions of the long-term history. Minute rows are written as they
+// come; hour and day rows are rolled up from them at the same time.
+enum class RollupTier : uint32_t {
+    Minutes = 0,
+    Hours = 1,
+    Days = 2
+};
+
+constexpr std::size_t ROLLUP_TIERS = 3;
+constexpr int64_t ROLLUP_PERIOD_SECONDS[ROLLUP_TIERS] = {60, 3600, 86400};
+// Each block holds the rows of one series in one aligned window of time:
+// a UTC day of minutes, a UTC day of hours, 32 days of days. An hour block
+// spans exactly one day row, so its totals answer whole days.
+constexpr int64_t ROLLUP_BLOCK_SECONDS[ROLLUP_TIERS] = {86400, 86400, 32 * 86400};
+
+constexpr const char* ROLLUP_FILE_NAME = "rollup.knmr";
+constexpr char ROLLUP_MAGIC[8] = {'K', 'N', 'M', 'R', 'O', 'L', 'L', '1'};
+constexpr uint32_t ROLLUP_VERSION = 3;
+
+// Series key of the all-devices totals; devices use DeviceLabel::key
+constexpr const char* ROLLUP_TOTAL_SERIES = "";
+
+// Key presses, clicks, scroll steps, events, distance, active minutes
+constexpr std::size_t ROLLUP_COLUMNS = 6;
+
+// One period of one series
+struct RollupRow {
+    int64_t period = 0;         // Unix seconds the period starts at
+    StatsSnapshot counts;
+    uint64_t activeMinutes = 0; // minutes with any input
+};
+
+// Totals and rates over a range
+struct RollupSummary {
+    int64_t from = 0;           // range covered, Unix seconds, whole minutes
+    int64_t to = 0;
+    StatsSnapshot totals;
+    uint64_t activeMinutes = 0;
+    // Blocks answered from their stored totals, and blocks read and decoded
+    std::size_t blocksSummed = 0;
+    std::size_t blocksDecoded = 0;
+
+    double perMinute(double value) const { return to > from ? value * 60.0 / (to - from) : 0.0; }
+    double perActiveMinute(double value) const { return activeMinutes ? value / activeMinutes : 0.0; }
+};
+
+struct RollupSeries {
+    std::string key;
+    std::string name;
+};
+
+struct RollupOptions {
+    std::string directory;
+    // Minute blocks older than this many days are dropped at the next
+    // flush; ranges reaching back further are answered by the hour tier.
+    // 0 keeps them forever.
+    int minuteRetentionDays = 0;
+    bool readOnly = false;
+};
+
+// On-disk history of per-minute aggregates per device, with hourly and
+// daily roll-ups. One append-only file holds series records (key and name)
+// and blocks; every block stores its rows column by column, each column
+// varint coded either plainly, as zigzag deltas or as one constant,
+// whichever is smallest, and carries its column totals in its header.
+// Opening reads the file once to index the blocks. A range query takes its
+// whole 32-day windows and whole days from block totals kept in the index
+// and decodes at most the hour and minute blocks of the two days its ends
+// fall in.
+//
+// Rewriting a block (new minutes for a day already on disk) appends the
+// merged block and leaves the old one dead; once dead bytes outweigh live
+// ones the file is rewritten in place of the old one. Each flush is
+// appended as one batch closed by a commit record; a record that fails its
+// checksum ends the file, and records after the last commit are dropped,
+// so a crash mid-flush loses that whole flush and the minute, hour and day
+// tiers always agree.
+//
+// One process writes; any number may open the file read-only. Calls on one
+// store are serialised by a mutex.
+class RollupStore
+{
+public:
+    explicit RollupStore(RollupOptions options);
+    ~RollupStore();
+
+    RollupStore(const RollupStore&) = delete;
+    RollupStore& operator=(const RollupStore&) = delete;
+
+    bool open();
+    // Flushes first unless read-only
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // Writer side. Adds one minute of one series; nothing reaches the disk
+    // before flush(). `minute` is any Unix second within the minute.
+    void add(const std::string& key, int64_t minute, const StatsSnapshot& counts);
+    void setSeriesName(const std::string& key, const std::string& name);
+    // Writes the pending minutes and their roll-ups, then compacts if due
+    bool flush();
+    // Rewrites the file with only live blocks
+    bool compact();
+
+    // Totals between two Unix times, rounded outward to whole minutes.
+    // Unflushed minutes are included.
+    RollupSummary query(int64_t from, int64_t to, const std::string& key = ROLLUP_TOTAL_SERIES) const;
+    // Non-empty rows of one tier whose period starts in [from, to)
+    std::vector<RollupRow> rows(RollupTier tier, int64_t from, int64_t to,
+                                const std::string& key = ROLLUP_TOTAL_SERIES) const;
+    std::vector<RollupSeries> series() const;
+
+    uint64_t fileBytes() const;
+    uint64_t deadBytes() const;
+
+private:
+    using Columns = std::array<uint64_t, ROLLUP_COLUMNS>;
+    using RowMap = std::map<int64_t, Columns>;
+
+    struct BlockRef {
+        uint64_t offset = 0;    // of the record header
+        uint32_t bytes = 0;     // header and body
+        uint32_t rows = 0;
+        Columns totals{};
+    };
+
+    struct Series {
+        uint32_t id = 0;
+        std::string key;
+        std::string name;
+        bool written = false;   // series record on disk with this name
+        std::map<int64_t, BlockRef> blocks[ROLLUP_TIERS];   // by window start
+        std::map<int64_t, StatsSnapshot> pending;           // minutes to flush
+    };
+
+    bool load();
+    Series& seriesFor(const std::string& key);
+    const Series* findSeries(const std::string& key) const;
+    void indexRecord(const std::string& data, uint64_t offset);
+    void writeSeries(Series& series);
+    void mergeBlock(Series& series, RollupTier tier, int64_t window, const RowMap& rows);
+    bool readBlock(const BlockRef& block, RollupTier tier, int64_t window, RowMap& rows) const;
+    // Pending minutes in [from, to) whose minute row is already on disk
+    std::set<int64_t> minutesOnDisk(const Series& series, int64_t from, int64_t to) const;
+    void appendRecord(const std::string& record, uint64_t* offset);
+    bool commitBatch();
+    void dropExpiredMinutes();
+    bool rewrite();
+
+    void sumRange(const Series& series, RollupTier tier, int64_t from, int64_t to, Columns& totals,
+                  RollupSummary& summary) const;
+    void sumMinutes(const Series& series, int64_t from, int64_t to, Columns& totals, RollupSummary& summary) const;
+    void sumDays(const Series& series, int64_t from, int64_t to, Columns& totals, RollupSummary& summary) const;
+    void sumHours(const Series& series, int64_t from, int64_t to, Columns& totals, RollupSummary& summary) const;
+
+    RollupOptions options;
+    std::string path;
+    int fd = -1;
+    uint64_t endOffset = 0;             // of the last commit
+    std::string batch;                  // records of the flush in progress
+    uint64_t dead = 0;
+    // Start of the oldest minute block kept (retention), 0 = all
+    int64_t minuteHorizon = 0;
+
+    mutable std::mutex mutex;
+    std::vector<Series> seriesList;     // by id
+    std::map<std::string, uint32_t> seriesIds;
+};
+
+#endif // ROLLUPSTORE_H
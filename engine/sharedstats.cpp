@@ -0,0 +1,316 @@
+#include "sharedstats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+constexpr unsigned READ_SPINS_BEFORE_YIELD = 64;
+
+namespace {
+
+int64_t clockMs(clockid_t clock)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+} // namespace
+
+SharedStatsSegment::~SharedStatsSegment()
+{
+    close();
+}
+
+bool SharedStatsSegment::create(const std::string& segmentName)
+{
+    close();
+    // Never reuse a segment of that name: whoever created it first would own
+    // it, could forge what readers see or shrink it under the writer. A
+    // stale one from a crashed run is removed; if another is created in
+    // between, O_EXCL fails rather than adopting it.
+    shm_unlink(segmentName.c_str());
+    int fd = shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot create shared memory " << segmentName << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    if (ftruncate(fd, sizeof(SharedStatsBlock)) < 0) {
+        std::cerr << "Cannot size shared memory " << segmentName << ": " << strerror(errno) << "\n";
+        ::close(fd);
+        return false;
+    }
+    void* memory = mmap(nullptr, sizeof(SharedStatsBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Cannot map shared memory " << segmentName << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    block = static_cast<SharedStatsBlock*>(memory);
+    name = segmentName;
+    owner = true;
+
+    // A fresh segment is all zeroes; publish the header under an odd
+    // sequence and start from an even one
+    block->sequence.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(block->magic, SHARED_STATS_MAGIC, sizeof(block->magic));
+    block->version = SHARED_STATS_VERSION;
+    block->words = SHARED_STATS_WORDS;
+    for (auto& word : block->values) {
+        word.store(0, std::memory_order_relaxed);
+    }
+    block->sequence.store(2, std::memory_order_release);
+    return true;
+}
+
+bool SharedStatsSegment::open(const std::string& segmentName)
+{
+    close();
+    int fd = shm_open(segmentName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<std::size_t>(info.st_size) < sizeof(SharedStatsBlock)) {
+        ::close(fd);
+        return false;
+    }
+    void* memory = mmap(nullptr, sizeof(SharedStatsBlock), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    block = static_cast<SharedStatsBlock*>(memory);
+    name = segmentName;
+    owner = false;
+    return true;
+}
+
+void SharedStatsSegment::close()
+{
+    if (!block) {
+        return;
+    }
+    munmap(block, sizeof(SharedStatsBlock));
+    block = nullptr;
+    if (owner) {
+        shm_unlink(name.c_str());
+        owner = false;
+    }
+}
+
+void SharedStatsSegment::publish(const SharedStatsValues& values)
+{
+    if (!block || !owner) {
+        return;
+    }
+    uint64_t words[SHARED_STATS_WORDS];
+    std::memcpy(words, &values, sizeof(words));
+
+    // Only the owning process publishes, so the sequence is bumped with
+    // plain stores
+    uint64_t seq = block->sequence.load(std::memory_order_relaxed);
+    block->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < SHARED_STATS_WORDS; ++i) {
+        block->values[i].store(words[i], std::memory_order_relaxed);
+    }
+    block->sequence.store(seq + 2, std::memory_order_release);
+}
+
+SharedStatsRead SharedStatsSegment::read(SharedStatsValues& values) const
+{
+    if (!block || std::memcmp(block->magic, SHARED_STATS_MAGIC, sizeof(block->magic)) != 0 ||
+        block->version != SHARED_STATS_VERSION || block->words != SHARED_STATS_WORDS) {
+        return SharedStatsRead::Incompatible;
+    }
+
+    uint64_t words[SHARED_STATS_WORDS];
+    int64_t deadline = 0;
+    for (unsigned attempt = 0;; ++attempt) {
+        if (attempt >= READ_SPINS_BEFORE_YIELD) {
+            // The writer is another process and may have been preempted
+            // mid-publish; let it run instead of spinning out our slice.
+            // If it died there, the sequence never turns even again.
+            int64_t now = clockMs(CLOCK_MONOTONIC);
+            if (deadline == 0) {
+                deadline = now + SHARED_STATS_READ_TIMEOUT_MS;
+            } else if (now >= deadline) {
+                return SharedStatsRead::Stalled;
+            }
+            sched_yield();
+        }
+        uint64_t before = block->sequence.load(std::memory_order_acquire);
+        if (before & 1u) {
+            continue;
+        }
+        for (std::size_t i = 0; i < SHARED_STATS_WORDS; ++i) {
+            words[i] = block->values[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block->sequence.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+    std::memcpy(&values, words, sizeof(words));
+    return SharedStatsRead::Ok;
+}
+
+uint64_t SharedStatsSegment::generation() const
+{
+    return block ? block->sequence.load(std::memory_order_acquire) / 2 : 0;
+}
+
+namespace {
+
+void appendMetric(std::string& out, const char* name, const char* type, const char* help, double value,
+                  const char* labels = nullptr)
+{
+    if (help) {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+    out += name;
+    if (labels) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    char number[32];
+    std::snprintf(number, sizeof(number), " %.17g\n", value);
+    out += number;
+}
+
+// id, name and bus/vendor/product of a device row as Prometheus labels
+std::string deviceLabels(const SharedDeviceValues& device)
+{
+    char ids[96];
+    std::snprintf(ids, sizeof(ids), "id=\"%llu\",bus=\"%04llx\",vendor=\"%04llx\",product=\"%04llx\",device=\"",
+                  static_cast<unsigned long long>(device.id), static_cast<unsigned long long>(device.bustype),
+                  static_cast<unsigned long long>(device.vendor), static_cast<unsigned long long>(device.product));
+    std::string labels = ids;
+    for (std::size_t i = 0; i < sizeof(device.name) && device.name[i]; ++i) {
+        char c = device.name[i];
+        if (c == '\\' || c == '"') {
+            labels += '\\';
+        } else if (c == '\n') {
+            labels += "\\n";
+            continue;
+        }
+        labels += c;
+    }
+    labels += '"';
+    return labels;
+}
+
+// One metric over every device row
+void appendDeviceMetric(std::string& out, const SharedStatsValues& values, const char* name, const char* type,
+                        const char* help, double (*field)(const SharedDeviceValues&))
+{
+    std::size_t rows = std::min<std::size_t>(values.breakdown_rows, SHARED_STATS_MAX_DEVICES);
+    for (std::size_t i = 0; i < rows; ++i) {
+        appendMetric(out, name, type, i == 0 ? help : nullptr, field(values.breakdown[i]),
+                     deviceLabels(values.breakdown[i]).c_str());
+    }
+}
+
+} // namespace
+
+std::string formatPrometheus(const SharedStatsValues& values)
+{
+    std::string out;
+    out.reserve(4096 + values.breakdown_rows * 2048);
+    appendMetric(out, "knm_running", "gauge", "Whether the tracker is monitoring.", values.running);
+    appendMetric(out, "knm_devices", "gauge", "Input devices attached.", values.devices);
+    appendMetric(out, "knm_elapsed_seconds", "gauge", "Time since monitoring started.", values.elapsed_seconds);
+    appendMetric(out, "knm_last_update_timestamp_seconds", "gauge", "Wall time of the last export.",
+                 values.update_time_ns / 1e9);
+
+    appendMetric(out, "knm_key_presses_total", "counter", "Key presses.", values.keyboard_count);
+    appendMetric(out, "knm_mouse_clicks_total", "counter", "Mouse button presses.", values.mouse_count);
+    appendMetric(out, "knm_scroll_steps_total", "counter", "Wheel and touchpad scroll steps.",
+                 values.scroll_count);
+    appendMetric(out, "knm_pen_strokes_total", "counter", "Tablet pen strokes.", values.stroke_count);
+    appendMetric(out, "knm_gamepad_presses_total", "counter", "Gamepad button and d-pad presses.",
+                 values.gamepad_count);
+    appendMetric(out, "knm_gamepad_axis_reports_total", "counter", "Gamepad reports moving a stick or trigger.",
+                 values.axis_count);
+    appendMetric(out, "knm_events_total", "counter", "Raw input events processed.", values.event_count);
+    appendMetric(out, "knm_mouse_distance_total", "counter", "Pointer travel in device units.",
+                 values.mouse_distance);
+
+    appendMetric(out, "knm_last_minute_key_presses", "gauge", "Key presses in the last 60 seconds.",
+                 values.minute_keyboard_count);
+    appendMetric(out, "knm_last_minute_mouse_clicks", "gauge", "Mouse button presses in the last 60 seconds.",
+                 values.minute_mouse_count);
+    appendMetric(out, "knm_last_minute_scroll_steps", "gauge",
+                 "Wheel and touchpad scroll steps in the last 60 seconds.",
+                 values.minute_scroll_count);
+    appendMetric(out, "knm_last_minute_events", "gauge", "Raw input events in the last 60 seconds.",
+                 values.minute_event_count);
+    appendMetric(out, "knm_last_minute_mouse_distance", "gauge", "Pointer travel in the last 60 seconds.",
+                 values.minute_mouse_distance);
+    appendMetric(out, "knm_words_per_minute", "gauge", "Typing speed over the last 60 seconds.",
+                 values.words_per_minute);
+
+    // Percentiles of the histogram, not a summary: there is no sum to go
+    // with them, so each is a gauge of its own
+    appendMetric(out, "knm_latency_p50_microseconds", "gauge",
+                 "Median kernel-to-processing latency of input reports.", values.latency_p50_us);
+    appendMetric(out, "knm_latency_p99_microseconds", "gauge",
+                 "99th percentile kernel-to-processing latency of input reports.", values.latency_p99_us);
+    appendMetric(out, "knm_latency_max_microseconds", "gauge",
+                 "Largest kernel-to-processing latency of input reports.", values.latency_max_us);
+
+    appendMetric(out, "knm_cpu_seconds_total", "counter", "Process CPU time since monitoring started.",
+                 values.cpu_seconds);
+    appendMetric(out, "knm_wakeups_per_second", "gauge", "Event engine wakeups per second since start.",
+                 values.wakeups_per_second);
+
+    appendDeviceMetric(out, values, "knm_device_attached", "gauge", "Whether the device is plugged in.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.attached); });
+    appendDeviceMetric(out, values, "knm_device_first_seen_timestamp_seconds", "gauge",
+                       "When the device was first attached this session.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.first_seen); });
+    appendDeviceMetric(out, values, "knm_device_last_seen_timestamp_seconds", "gauge",
+                       "When the device last produced input (0: never).",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.last_seen); });
+    appendDeviceMetric(out, values, "knm_device_key_presses_total", "counter", "Key presses per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.keyboard_count); });
+    appendDeviceMetric(out, values, "knm_device_mouse_clicks_total", "counter", "Mouse button presses per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.mouse_count); });
+    appendDeviceMetric(out, values, "knm_device_scroll_steps_total", "counter",
+                       "Wheel and touchpad scroll steps per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.scroll_count); });
+    appendDeviceMetric(out, values, "knm_device_pen_strokes_total", "counter", "Tablet pen strokes per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.stroke_count); });
+    appendDeviceMetric(out, values, "knm_device_gamepad_presses_total", "counter",
+                       "Gamepad button and d-pad presses per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.gamepad_count); });
+    appendDeviceMetric(out, values, "knm_device_gamepad_axis_reports_total", "counter",
+                       "Gamepad reports moving a stick or trigger per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.axis_count); });
+    appendDeviceMetric(out, values, "knm_device_events_total", "counter", "Raw input events per device.",
+                       [](const SharedDeviceValues& d) { return static_cast<double>(d.event_count); });
+    appendDeviceMetric(out, values, "knm_device_mouse_distance_total", "counter",
+                       "Pointer travel per device in device units.",
+                       [](const SharedDeviceValues& d) { return d.mouse_distance; });
+    return out;
+}
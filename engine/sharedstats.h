@@ -0,0 +1,143 @@
+#ifndef SHAREDSTATS_H
+#define SHAREDSTATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr const char* SHARED_STATS_DEFAULT_NAME = "/knm_tracker";
+constexpr char SHARED_STATS_MAGIC[8] = {'K', 'N', 'M', 'S', 'T', 'A', 'T', '1'};
+constexpr uint32_t SHARED_STATS_VERSION = 3;
+// Per-device rows in the segment; further devices only count in the totals
+constexpr std::size_t SHARED_STATS_MAX_DEVICES = 32;
+constexpr std::size_t SHARED_DEVICE_NAME_BYTES = 48;
+// A publish takes microseconds; a reader gives up after this long
+constexpr long SHARED_STATS_READ_TIMEOUT_MS = 100;
+
+// One row of the per-device breakdown (see DeviceStats)
+struct SharedDeviceValues {
+    uint64_t id = 0;
+    uint64_t bustype = 0;
+    uint64_t vendor = 0;
+    uint64_t product = 0;
+    uint64_t attached = 0;
+    uint64_t first_seen = 0;        // Unix seconds
+    uint64_t last_seen = 0;         // Unix seconds, 0 = no input yet
+    uint64_t keyboard_count = 0;
+    uint64_t mouse_count = 0;
+    uint64_t scroll_count = 0;
+    uint64_t stroke_count = 0;
+    uint64_t gamepad_count = 0;
+    uint64_t axis_count = 0;
+    uint64_t event_count = 0;
+    double mouse_distance = 0.0;
+    char name[SHARED_DEVICE_NAME_BYTES] = {};   // truncated, NUL-terminated
+};
+
+// What the tracker exports. Every member is a whole number of 8-byte words
+// so the block can be copied word by word through atomics; change the
+// layout only together with SHARED_STATS_VERSION.
+struct SharedStatsValues {
+    uint64_t update_time_ns = 0;    // CLOCK_REALTIME of the last publish
+    uint64_t pid = 0;
+    uint64_t running = 0;
+    uint64_t devices = 0;
+    double elapsed_seconds = 0.0;
+
+    uint64_t keyboard_count = 0;
+    uint64_t mouse_count = 0;
+    uint64_t scroll_count = 0;
+    uint64_t stroke_count = 0;
+    uint64_t gamepad_count = 0;
+    uint64_t axis_count = 0;
+    uint64_t event_count = 0;
+    double mouse_distance = 0.0;
+
+    // Last 60 seconds
+    uint64_t minute_keyboard_count = 0;
+    uint64_t minute_mouse_count = 0;
+    uint64_t minute_scroll_count = 0;
+    uint64_t minute_event_count = 0;
+    double minute_mouse_distance = 0.0;
+    double words_per_minute = 0.0;
+
+    // Kernel-to-processing latency over every device, microseconds
+    double latency_p50_us = 0.0;
+    double latency_p99_us = 0.0;
+    double latency_max_us = 0.0;
+
+    double cpu_seconds = 0.0;
+    double wakeups_per_second = 0.0;
+
+    uint64_t breakdown_rows = 0;    // valid entries of breakdown[]
+    SharedDeviceValues breakdown[SHARED_STATS_MAX_DEVICES];
+};
+
+static_assert(sizeof(SharedDeviceValues) % sizeof(uint64_t) == 0, "SharedDeviceValues must be whole words");
+static_assert(sizeof(SharedStatsValues) % sizeof(uint64_t) == 0, "SharedStatsValues must be whole words");
+constexpr std::size_t SHARED_STATS_WORDS = sizeof(SharedStatsValues) / sizeof(uint64_t);
+
+// The shared-memory layout. One writer (the tracker) publishes under a
+// seqlock exactly like StatsSlot: the sequence is odd while an update is
+// in progress and readers retry until they see the same even value before
+// and after copying. Readers never block the writer; a writer killed
+// mid-publish leaves the sequence odd, which readers report after a
+// timeout instead of retrying forever.
+struct SharedStatsBlock {
+    char magic[8];
+    uint32_t version;
+    uint32_t words;                  // SHARED_STATS_WORDS of the writer
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> values[SHARED_STATS_WORDS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be address-free");
+
+// Outcome of SharedStatsSegment::read
+enum class SharedStatsRead {
+    Ok,
+    Incompatible,       // not a stats segment of this version
+    Stalled             // a publish never finished; the writer likely died mid-update
+};
+
+// A mapping of the POSIX shared-memory segment, either created for
+// writing by the tracker or opened read-only by a reader.
+class SharedStatsSegment
+{
+public:
+    SharedStatsSegment() = default;
+    ~SharedStatsSegment();
+
+    SharedStatsSegment(const SharedStatsSegment&) = delete;
+    SharedStatsSegment& operator=(const SharedStatsSegment&) = delete;
+
+    // Writer side. Creates (or takes over) the segment; `unlink` on close.
+    bool create(const std::string& name);
+    // Reader side
+    bool open(const std::string& name);
+    void close();
+    bool isOpen() const { return block != nullptr; }
+
+    // Writer side. Only one process may publish.
+    void publish(const SharedStatsValues& values);
+
+    // Reader side. A consistent copy of the last publish, unless the
+    // segment is of another version or stays mid-update for
+    // SHARED_STATS_READ_TIMEOUT_MS.
+    SharedStatsRead read(SharedStatsValues& values) const;
+
+    // Number of publishes so far (sequence / 2)
+    uint64_t generation() const;
+
+private:
+    SharedStatsBlock* block = nullptr;
+    std::string name;
+    bool owner = false;
+};
+
+// Prometheus text exposition (format 0.0.4) of one set of values, shared by
+// the tracker's metrics socket and the reader tool.
+std::string formatPrometheus(const SharedStatsValues& values);
+
+#endif // SHAREDSTATS_H
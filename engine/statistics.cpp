@@ -0,0 +1,172 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <time.h>
+
+int64_t currentSecond()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return now.tv_sec;
+}
+
+void StatsSlot::publish(const StatsSnapshot& delta, int64_t nowSecond)
+{
+    if (delta.empty()) {
+        return;
+    }
+    StatsCore::Row& row = core->table[index];
+
+    uint32_t seq = row.sequence.load(std::memory_order_relaxed);
+    row.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    addRelaxed(row, delta);
+    row.last_seen.store(nowSecond, std::memory_order_relaxed);
+
+    row.sequence.store(seq + 2, std::memory_order_release);
+}
+
+StatsSnapshot StatsSlot::read() const
+{
+    return core->readRow(index, nullptr);
+}
+
+StatsCore::StatsCore(std::size_t capacity)
+    : capacity(capacity),
+    table(new Row[capacity]),
+    handles(new StatsSlot[capacity])
+{
+    for (std::size_t i = 0; i < capacity; ++i) {
+        handles[i].core = this;
+        handles[i].index = static_cast<uint32_t>(i);
+    }
+    rows.reserve(capacity);
+    reset();
+}
+
+StatsSnapshot StatsCore::readRow(std::size_t row, int64_t* lastSeen) const
+{
+    const Row& entry = table[row];
+    StatsSnapshot result;
+    for (;;) {
+        uint32_t before = entry.sequence.load(std::memory_order_acquire);
+        if (before & 1u) {
+            continue;
+        }
+
+        result = loadRelaxed(entry);
+        int64_t seen = entry.last_seen.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.sequence.load(std::memory_order_relaxed) == before) {
+            if (lastSeen) {
+                *lastSeen = seen;
+            }
+            return result;
+        }
+    }
+}
+
+StatsSlot* StatsCore::acquireSlot(const DeviceLabel& label)
+{
+    std::lock_guard<std::mutex> lock(rowsMutex);
+    // A device seen earlier in the session gets its row back; failing that,
+    // reuse a row that was handed back without ever counting anything
+    std::size_t spare = rows.size();
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (rows[i].attached) {
+            continue;
+        }
+        if (!rows[i].spare && rows[i].label.key == label.key) {
+            rows[i].attached = true;
+            rows[i].label = label;
+            return &handles[i];
+        }
+        if (rows[i].spare && spare == rows.size()) {
+            spare = i;
+        }
+    }
+    if (spare == rows.size()) {
+        if (rows.size() >= capacity) {
+            return nullptr;
+        }
+        rows.emplace_back();
+    }
+
+    RowInfo& info = rows[spare];
+    info.label = label;
+    info.attached = true;
+    info.spare = false;
+    info.firstSeen = currentSecond();
+    // Publish the new row count only once the row is set up
+    used.store(rows.size(), std::memory_order_release);
+    return &handles[spare];
+}
+
+void StatsCore::releaseSlot(StatsSlot* slot)
+{
+    if (slot) {
+        std::lock_guard<std::mutex> lock(rowsMutex);
+        RowInfo& info = rows[slot->index];
+        info.attached = false;
+        // Never published (e.g. a duplicate attach): keep it out of the
+        // breakdown and free for anyone
+        info.spare = table[slot->index].last_seen.load(std::memory_order_relaxed) == 0;
+    }
+}
+
+StatsSnapshot StatsCore::snapshot() const
+{
+    StatsSnapshot total;
+    std::size_t count = used.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < count; ++i) {
+        total += readRow(i, nullptr);
+    }
+    return total;
+}
+
+std::vector<DeviceStats> StatsCore::devices() const
+{
+    // Rows keep monotonic seconds; convert once for the whole table
+    const int64_t toUnix = static_cast<int64_t>(time(nullptr)) - currentSecond();
+
+    std::vector<DeviceStats> result;
+    std::lock_guard<std::mutex> lock(rowsMutex);
+    result.reserve(rows.size());
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        DeviceStats device;
+        int64_t lastSeen = 0;
+        device.counts = readRow(i, &lastSeen);
+        if (rows[i].spare) {
+            continue;
+        }
+        device.id = static_cast<uint32_t>(i);
+        device.label = rows[i].label;
+        device.attached = rows[i].attached;
+        device.firstSeen = rows[i].firstSeen + toUnix;
+        device.lastSeen = lastSeen != 0 ? lastSeen + toUnix : 0;
+        result.push_back(std::move(device));
+    }
+    return result;
+}
+
+void StatsCore::reset()
+{
+    for (std::size_t i = 0; i < capacity; ++i) {
+        Row& row = table[i];
+        row.sequence.store(0, std::memory_order_relaxed);
+        clearRelaxed(row);
+        row.last_seen.store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(rowsMutex);
+    rows.clear();
+    used.store(0, std::memory_order_release);
+}
+
+void ChangeSignal::setHandler(Handler newHandler)
+{
+    handler = std::move(newHandler);
+    pending.store(false, std::memory_order_release);
+}
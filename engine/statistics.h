@@ -0,0 +1,251 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Monotonic whole seconds, the time base producers and readers of the
+// windowed tables agree on. A coarse clock read, cheap enough per batch.
+int64_t currentSecond();
+
+// Plain counter values, used both for a producer's pending changes and for
+// the aggregated totals handed to readers.
+struct StatsSnapshot {
+    uint64_t keyboard_count = 0;
+    uint64_t mouse_count = 0;
+    uint64_t scroll_count = 0;
+    uint64_t stroke_count = 0;  // pen strokes on tablets
+    uint64_t gamepad_count = 0; // gamepad button and d-pad presses
+    uint64_t axis_count = 0;    // gamepad reports moving a stick or trigger
+    double mouse_distance = 0.0;
+    uint64_t event_count = 0;   // raw input_events, for activity charts
+
+    bool empty() const {
+        return keyboard_count == 0 && mouse_count == 0 && scroll_count == 0 && stroke_count == 0 &&
+               gamepad_count == 0 && axis_count == 0 && mouse_distance == 0.0 && event_count == 0;
+    }
+    StatsSnapshot& operator+=(const StatsSnapshot& other) {
+        keyboard_count += other.keyboard_count;
+        mouse_count += other.mouse_count;
+        scroll_count += other.scroll_count;
+        stroke_count += other.stroke_count;
+        gamepad_count += other.gamepad_count;
+        axis_count += other.axis_count;
+        mouse_distance += other.mouse_distance;
+        event_count += other.event_count;
+        return *this;
+    }
+    StatsSnapshot& operator-=(const StatsSnapshot& other) {
+        keyboard_count -= other.keyboard_count;
+        mouse_count -= other.mouse_count;
+        scroll_count -= other.scroll_count;
+        stroke_count -= other.stroke_count;
+        gamepad_count -= other.gamepad_count;
+        axis_count -= other.axis_count;
+        mouse_distance -= other.mouse_distance;
+        event_count -= other.event_count;
+        return *this;
+    }
+};
+
+// StatsSnapshot fields mirrored in std::atomic members of the same names,
+// as in StatsCore's rows and RateSlot's buckets. Each row or bucket has a
+// single writer, so adding is a plain relaxed load and store per field, no
+// read-modify-write; ordering against readers is left to the caller's
+// sequence or period tag.
+template <class Atomics>
+void addRelaxed(Atomics& target, const StatsSnapshot& delta)
+{
+    auto add = [](auto& field, auto value) {
+        field.store(field.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    };
+    add(target.keyboard_count, delta.keyboard_count);
+    add(target.mouse_count, delta.mouse_count);
+    add(target.scroll_count, delta.scroll_count);
+    add(target.stroke_count, delta.stroke_count);
+    add(target.gamepad_count, delta.gamepad_count);
+    add(target.axis_count, delta.axis_count);
+    add(target.mouse_distance, delta.mouse_distance);
+    add(target.event_count, delta.event_count);
+}
+
+template <class Atomics>
+void clearRelaxed(Atomics& target)
+{
+    target.keyboard_count.store(0, std::memory_order_relaxed);
+    target.mouse_count.store(0, std::memory_order_relaxed);
+    target.scroll_count.store(0, std::memory_order_relaxed);
+    target.stroke_count.store(0, std::memory_order_relaxed);
+    target.gamepad_count.store(0, std::memory_order_relaxed);
+    target.axis_count.store(0, std::memory_order_relaxed);
+    target.mouse_distance.store(0.0, std::memory_order_relaxed);
+    target.event_count.store(0, std::memory_order_relaxed);
+}
+
+template <class Atomics>
+StatsSnapshot loadRelaxed(const Atomics& source)
+{
+    StatsSnapshot values;
+    values.keyboard_count = source.keyboard_count.load(std::memory_order_relaxed);
+    values.mouse_count = source.mouse_count.load(std::memory_order_relaxed);
+    values.scroll_count = source.scroll_count.load(std::memory_order_relaxed);
+    values.stroke_count = source.stroke_count.load(std::memory_order_relaxed);
+    values.gamepad_count = source.gamepad_count.load(std::memory_order_relaxed);
+    values.axis_count = source.axis_count.load(std::memory_order_relaxed);
+    values.mouse_distance = source.mouse_distance.load(std::memory_order_relaxed);
+    values.event_count = source.event_count.load(std::memory_order_relaxed);
+    return values;
+}
+
+class StatsCore;
+
+// What a client shows about a device besides its counters
+struct DeviceLabel {
+    std::string key;        // DeviceIdentity::key(), stable across re-plugs
+    std::string name;
+    uint16_t bustype = 0;
+    uint16_t vendor = 0;
+    uint16_t product = 0;
+};
+
+// One device's counters and label as handed to readers. Times are Unix
+// seconds; lastSeen is 0 until the device produced input.
+struct DeviceStats {
+    uint32_t id = 0;        // dense index into StatsCore, stable for the session
+    DeviceLabel label;
+    bool attached = false;
+    int64_t firstSeen = 0;  // first attached
+    int64_t lastSeen = 0;   // last batch of events
+    StatsSnapshot counts;
+};
+
+// A producer's handle to its device's row in a StatsCore. Only the owning
+// producer may publish; the row's sequence number is a single-writer
+// seqlock: it is odd while an update is in progress, and readers retry
+// until they see the same even value before and after copying, so a
+// snapshot is never torn and writers never wait.
+class StatsSlot
+{
+public:
+    // Producer side. `nowSecond` is currentSecond(), recorded as last seen.
+    void publish(const StatsSnapshot& delta, int64_t nowSecond);
+
+    // Reader side. Safe from any thread.
+    StatsSnapshot read() const;
+
+    uint32_t id() const { return index; }
+
+private:
+    friend class StatsCore;
+
+    StatsCore* core = nullptr;
+    uint32_t index = 0;
+};
+
+// Per-device counters in a table indexed by a dense device id. Each row is
+// cache-line aligned, so workers publishing for different devices never
+// write to the same line; summing the totals walks two lines per device.
+// A device keeps its id for the whole session; when it is re-plugged it
+// gets its old row back (matched by DeviceLabel::key) and keeps counting.
+// Producers claim a row once and publish into it without locks; aggregate
+// totals are only computed on read.
+class StatsCore
+{
+public:
+    explicit StatsCore(std::size_t capacity = 256);
+
+    StatsCore(const StatsCore&) = delete;
+    StatsCore& operator=(const StatsCore&) = delete;
+
+    // Returns nullptr when every row is taken
+    StatsSlot* acquireSlot(const DeviceLabel& label = DeviceLabel());
+    // The caller must no longer publish into the slot. Its counters stay in
+    // the totals and the breakdown.
+    void releaseSlot(StatsSlot* slot);
+
+    // Sum over every device
+    StatsSnapshot snapshot() const;
+    // Every device attached in this session, in id order
+    std::vector<DeviceStats> devices() const;
+
+    // Zeroes every row and forgets every device. Only call while no
+    // producer runs.
+    void reset();
+
+private:
+    friend class StatsSlot;
+
+    StatsSnapshot readRow(std::size_t row, int64_t* lastSeen) const;
+
+    std::size_t capacity;
+
+    // One device's counters, guarded by its own seqlock word
+    struct alignas(CACHE_LINE_SIZE) Row {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint64_t> keyboard_count{0};
+        std::atomic<uint64_t> mouse_count{0};
+        std::atomic<uint64_t> scroll_count{0};
+        std::atomic<uint64_t> stroke_count{0};
+        std::atomic<uint64_t> gamepad_count{0};
+        std::atomic<uint64_t> axis_count{0};
+        std::atomic<double> mouse_distance{0.0};
+        std::atomic<uint64_t> event_count{0};
+        std::atomic<int64_t> last_seen{0};     // currentSecond(), 0 = never
+    };
+    static_assert(sizeof(Row) % CACHE_LINE_SIZE == 0, "rows must fill whole cache lines");
+
+    // The table: row i belongs to device id i
+    std::unique_ptr<Row[]> table;
+    std::unique_ptr<StatsSlot[]> handles;
+    std::atomic<std::size_t> used{0};
+
+    // Cold per-device data, only touched on attach, detach and read
+    struct RowInfo {
+        DeviceLabel label;
+        bool attached = false;
+        bool spare = false;      // released without ever publishing
+        int64_t firstSeen = 0;   // currentSecond()
+    };
+    mutable std::mutex rowsMutex;
+    std::vector<RowInfo> rows;
+};
+
+// Tells a reader that counters changed, without waking it more than once
+// per read. Producers raise() after publishing; only the first raise after
+// the reader's consume() calls the handler, every later one is a single
+// load of a flag that is already set. A reader that consumes, reads, and
+// waits for the next handler call is therefore never woken while idle and
+// at most once per read while busy.
+class ChangeSignal
+{
+public:
+    using Handler = std::function<void()>;
+
+    // Set before any producer runs. The handler runs on a producer thread
+    // and should only post a notification somewhere.
+    void setHandler(Handler handler);
+
+    void raise() {
+        if (!pending.load(std::memory_order_relaxed) && !pending.exchange(true, std::memory_order_acq_rel) &&
+            handler) {
+            handler();
+        }
+    }
+
+    // Reader side: re-arms the signal. Returns whether anything changed.
+    bool consume() { return pending.exchange(false, std::memory_order_acq_rel); }
+
+private:
+    std::atomic<bool> pending{false};
+    Handler handler;
+};
+
+#endif // STATISTICS_H
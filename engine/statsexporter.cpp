@@ -0,0 +1,345 @@
+#include "statsexporter.h"
+#include "trackerengine.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+int64_t clockMs(clockid_t clock)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+void drain(int fd)
+{
+    uint64_t value;
+    while (::read(fd, &value, sizeof(value)) == sizeof(value)) {
+    }
+}
+
+} // namespace
+
+StatsExporter::StatsExporter(const TrackerEngine& engine, std::string sharedName, std::string socketPath)
+    : engine(engine)
+    , sharedName(std::move(sharedName))
+    , socketPath(std::move(socketPath))
+{
+    changeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    // Runs on an engine worker: only wake the exporter thread
+    int fd = changeFd;
+    changed.setHandler([fd]() {
+        uint64_t one = 1;
+        if (::write(fd, &one, sizeof(one)) != sizeof(one)) {
+            // Counter saturated: the exporter is already due to wake
+        }
+    });
+}
+
+StatsExporter::~StatsExporter()
+{
+    stop();
+    if (changeFd >= 0) {
+        ::close(changeFd);
+    }
+    if (stopFd >= 0) {
+        ::close(stopFd);
+    }
+}
+
+bool StatsExporter::start()
+{
+    if (thread.joinable()) {
+        return true;
+    }
+    if (changeFd < 0 || stopFd < 0) {
+        std::cerr << "[export] eventfd failed: " << strerror(errno) << "\n";
+        return false;
+    }
+    if (!sharedName.empty() && !segment.create(sharedName)) {
+        return false;
+    }
+    if (!socketPath.empty() && !openSocket()) {
+        segment.close();
+        return false;
+    }
+    drain(stopFd);
+    publish();
+    thread = std::thread(&StatsExporter::run, this);
+    return true;
+}
+
+void StatsExporter::stop()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (::write(stopFd, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "[export] cannot wake exporter thread\n";
+    }
+    thread.join();
+    for (const PendingClient& client : clients) {
+        ::close(client.fd);
+    }
+    clients.clear();
+
+    publish();
+    segment.close();
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        removeSocket();
+    }
+}
+
+bool StatsExporter::openSocket()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "[export] Socket path too long: " << socketPath << "\n";
+        return false;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    // The tracker runs as root: never unlink what is not a socket, a typo in
+    // --metrics-socket must not delete a file
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << "[export] " << socketPath << " exists and is not a socket\n";
+            return false;
+        }
+        // A stale socket from a previous run would make bind() fail
+        unlink(socketPath.c_str());
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) {
+        std::cerr << "[export] socket failed: " << strerror(errno) << "\n";
+        return false;
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 8) < 0) {
+        std::cerr << "[export] Cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    struct stat created;
+    if (lstat(socketPath.c_str(), &created) == 0) {
+        socketDev = created.st_dev;
+        socketIno = created.st_ino;
+    }
+    return true;
+}
+
+void StatsExporter::removeSocket()
+{
+    // Only the socket bind() created; the path may have been replaced since
+    struct stat current;
+    if (lstat(socketPath.c_str(), &current) == 0 && S_ISSOCK(current.st_mode) && current.st_dev == socketDev &&
+        current.st_ino == socketIno) {
+        unlink(socketPath.c_str());
+    }
+}
+
+// Sleeps until the engine reports a change, a scrape arrives or stop() is
+// called. After a publish the change fd is left out of the poll set until
+// EXPORT_INTERVAL_MS has passed, so a busy device costs at most ten
+// publishes a second. Accepted scrapes are answered once their request
+// arrives or EXPORT_CLIENT_WAIT_MS passes, whichever is first.
+void StatsExporter::run()
+{
+    int64_t nextPublishMs = 0;
+    bool dirty = false;
+    for (;;) {
+        pollfd fds[3 + EXPORT_MAX_CLIENTS];
+        nfds_t count = 0;
+        fds[count++] = pollfd{stopFd, POLLIN, 0};
+        const nfds_t listenIndex = count;
+        const bool accepting = listenFd >= 0 && clients.size() < EXPORT_MAX_CLIENTS;
+        if (accepting) {
+            fds[count++] = pollfd{listenFd, POLLIN, 0};
+        }
+        const nfds_t changeIndex = count;
+        if (!dirty) {
+            fds[count++] = pollfd{changeFd, POLLIN, 0};
+        }
+        const nfds_t clientIndex = count;
+        for (const PendingClient& client : clients) {
+            fds[count++] = pollfd{client.fd, POLLIN, 0};
+        }
+
+        int64_t wakeMs = dirty ? nextPublishMs : INT64_MAX;
+        for (const PendingClient& client : clients) {
+            wakeMs = std::min(wakeMs, client.deadlineMs);
+        }
+        int timeout = -1;
+        if (wakeMs != INT64_MAX) {
+            timeout = static_cast<int>(std::max<int64_t>(0, wakeMs - clockMs(CLOCK_MONOTONIC)));
+        }
+        int ready = poll(fds, count, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "[export] poll failed: " << strerror(errno) << "\n";
+            return;
+        }
+        if (fds[0].revents) {
+            return;
+        }
+
+        // Clients first: their pollfd indices are only valid until the
+        // list changes
+        const int64_t now = clockMs(CLOCK_MONOTONIC);
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < clients.size(); ++i) {
+            if (fds[clientIndex + i].revents || now >= clients[i].deadlineMs) {
+                serveClient(clients[i].fd);
+            } else {
+                clients[kept++] = clients[i];
+            }
+        }
+        clients.resize(kept);
+        if (accepting && fds[listenIndex].revents) {
+            acceptClients();
+        }
+        if (!dirty && fds[changeIndex].revents) {
+            drain(changeFd);
+            dirty = true;
+        }
+        if (dirty && clockMs(CLOCK_MONOTONIC) >= nextPublishMs) {
+            dirty = false;
+            publish();
+            nextPublishMs = clockMs(CLOCK_MONOTONIC) + EXPORT_INTERVAL_MS;
+        }
+    }
+}
+
+void StatsExporter::publish()
+{
+    // Re-arm first so changes made while collecting wake us again
+    changed.consume();
+    if (segment.isOpen()) {
+        segment.publish(collect());
+    }
+}
+
+SharedStatsValues StatsExporter::collect() const
+{
+    EngineSnapshot snapshot = engine.snapshot();
+    StatsSnapshot minute = engine.rates().lastMinute();
+    EngineDiagnostics diagnostics = engine.diagnostics();
+
+    SharedStatsValues values;
+    values.update_time_ns = static_cast<uint64_t>(clockMs(CLOCK_REALTIME)) * 1000000ULL;
+    values.pid = static_cast<uint64_t>(getpid());
+    values.running = snapshot.running && !snapshot.paused;
+    values.devices = snapshot.devices;
+    values.elapsed_seconds = snapshot.elapsedSeconds;
+    values.keyboard_count = snapshot.totals.keyboard_count;
+    values.mouse_count = snapshot.totals.mouse_count;
+    values.scroll_count = snapshot.totals.scroll_count;
+    values.stroke_count = snapshot.totals.stroke_count;
+    values.gamepad_count = snapshot.totals.gamepad_count;
+    values.axis_count = snapshot.totals.axis_count;
+    values.event_count = snapshot.totals.event_count;
+    values.mouse_distance = snapshot.totals.mouse_distance;
+    values.minute_keyboard_count = minute.keyboard_count;
+    values.minute_mouse_count = minute.mouse_count;
+    values.minute_scroll_count = minute.scroll_count;
+    values.minute_event_count = minute.event_count;
+    values.minute_mouse_distance = minute.mouse_distance;
+    values.words_per_minute = engine.wordsPerMinute();
+    values.latency_p50_us = diagnostics.latency.p50;
+    values.latency_p99_us = diagnostics.latency.p99;
+    values.latency_max_us = diagnostics.latency.max;
+    values.cpu_seconds = diagnostics.cpuSeconds;
+    values.wakeups_per_second = diagnostics.wakeupsPerSecond;
+
+    std::vector<DeviceStats> devices = engine.deviceStats();
+    values.breakdown_rows = std::min(devices.size(), SHARED_STATS_MAX_DEVICES);
+    for (std::size_t i = 0; i < values.breakdown_rows; ++i) {
+        const DeviceStats& device = devices[i];
+        SharedDeviceValues& row = values.breakdown[i];
+        row.id = device.id;
+        row.bustype = device.label.bustype;
+        row.vendor = device.label.vendor;
+        row.product = device.label.product;
+        row.attached = device.attached;
+        row.first_seen = static_cast<uint64_t>(device.firstSeen);
+        row.last_seen = static_cast<uint64_t>(device.lastSeen);
+        row.keyboard_count = device.counts.keyboard_count;
+        row.mouse_count = device.counts.mouse_count;
+        row.scroll_count = device.counts.scroll_count;
+        row.stroke_count = device.counts.stroke_count;
+        row.gamepad_count = device.counts.gamepad_count;
+        row.axis_count = device.counts.axis_count;
+        row.event_count = device.counts.event_count;
+        row.mouse_distance = device.counts.mouse_distance;
+        std::strncpy(row.name, device.label.name.c_str(), sizeof(row.name) - 1);
+    }
+    return values;
+}
+
+void StatsExporter::acceptClients()
+{
+    while (clients.size() < EXPORT_MAX_CLIENTS) {
+        int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (client < 0) {
+            return;
+        }
+        clients.push_back(PendingClient{client, clockMs(CLOCK_MONOTONIC) + EXPORT_CLIENT_WAIT_MS});
+    }
+}
+
+// One scrape: the request (if the client sends one, e.g. curl
+// --unix-socket) is read and ignored, the metrics are written with a
+// minimal HTTP header and the connection is closed. Clients that sent
+// nothing get the bare text. Nothing here blocks: a client that does not
+// take the whole response at once is dropped.
+void StatsExporter::serveClient(int client)
+{
+    char request[1024];
+    ssize_t received = recv(client, request, sizeof(request), MSG_DONTWAIT);
+    bool http = received >= 4 && std::memcmp(request, "GET ", 4) == 0;
+
+    std::string body = formatPrometheus(collect());
+    std::string response;
+    if (http) {
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    }
+    response += body;
+
+    const char* data = response.data();
+    std::size_t left = response.size();
+    while (left > 0) {
+        ssize_t sent = send(client, data, left, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            Logger::log(LogLevel::Info, "[export] Scrape client went away");
+            break;
+        }
+        data += sent;
+        left -= static_cast<std::size_t>(sent);
+    }
+    ::close(client);
+}
@@ -0,0 +1,78 @@
+#ifndef STATSEXPORTER_H
+#define STATSEXPORTER_H
+
+#include "sharedstats.h"
+#include "statistics.h"
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+class TrackerEngine;
+
+// Minimum time between two shared-memory publishes
+constexpr int EXPORT_INTERVAL_MS = 100;
+// Scrape connections waiting for their request; more stay in the backlog
+constexpr std::size_t EXPORT_MAX_CLIENTS = 8;
+// A client that sends no request gets the bare text after this long
+constexpr int EXPORT_CLIENT_WAIT_MS = 200;
+
+// Publishes the engine's counters to other processes: a POSIX shared-memory
+// segment (SharedStatsSegment) that readers map and copy without any
+// syscall, and optionally a Unix socket answering each connection with the
+// Prometheus text format. A single thread sleeps in poll() on an eventfd
+// raised by the engine's change signal, so an idle tracker causes no
+// exporter wakeups; while input flows the segment is rewritten at most
+// every EXPORT_INTERVAL_MS. Scrape connections are non-blocking and polled
+// alongside, so a client that never sends or reads cannot hold up
+// publishing.
+class StatsExporter
+{
+public:
+    // Empty names disable that output
+    StatsExporter(const TrackerEngine& engine, std::string sharedName, std::string socketPath);
+    ~StatsExporter();
+
+    StatsExporter(const StatsExporter&) = delete;
+    StatsExporter& operator=(const StatsExporter&) = delete;
+
+    // Register with every device's processor before start()
+    ChangeSignal* changeSignal() { return &changed; }
+
+    bool start();
+    // Publishes a last time (running = 0), then joins the thread
+    void stop();
+
+private:
+    void run();
+    void publish();
+    void acceptClients();
+    void serveClient(int client);
+    SharedStatsValues collect() const;
+    bool openSocket();
+    void removeSocket();
+
+    const TrackerEngine& engine;
+    std::string sharedName;
+    std::string socketPath;
+
+    SharedStatsSegment segment;
+    ChangeSignal changed;
+    int changeFd = -1;
+    int stopFd = -1;
+    int listenFd = -1;
+    // Identity of the socket file bind() created, so stop() removes only it
+    dev_t socketDev = 0;
+    ino_t socketIno = 0;
+    std::thread thread;
+
+    struct PendingClient {
+        int fd;
+        int64_t deadlineMs;     // CLOCK_MONOTONIC
+    };
+    std::vector<PendingClient> clients;     // exporter thread only
+};
+
+#endif // STATSEXPORTER_H
@@ -0,0 +1,598 @@
+#include "trackerengine.h"
+#include "statsexporter.h"
+#include "historyrecorder.h"
+#include "eventmask.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <iostream>
+#include <thread>
+#include <sys/ioctl.h>
+#include <time.h>
+
+constexpr int DEVICES_PER_WORKER = 16;
+
+namespace {
+
+int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t processCpuNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// The logger keeps message pointers, so one literal per class
+const char* monitoringMessage(DeviceType type)
+{
+    switch (type) {
+    case DeviceType::Keyboard:
+        return "[engine] Monitoring keyboard";
+    case DeviceType::Mouse:
+        return "[engine] Monitoring mouse";
+    case DeviceType::Touchpad:
+        return "[engine] Monitoring touchpad";
+    case DeviceType::Tablet:
+        return "[engine] Monitoring tablet";
+    case DeviceType::Gamepad:
+        return "[engine] Monitoring gamepad";
+    }
+    return "[engine] Monitoring device";
+}
+
+} // namespace
+
+TrackerEngine::TrackerEngine(EngineOptions options)
+    : options(std::move(options))
+{
+}
+
+TrackerEngine::~TrackerEngine()
+{
+    stop();
+}
+
+void TrackerEngine::setOptions(const EngineOptions& newOptions)
+{
+    if (newOptions.historyDirectory != options.historyDirectory && !running.load()) {
+        historyStore.reset();
+    }
+    options = newOptions;
+}
+
+bool TrackerEngine::start()
+{
+    if (running.load()) {
+        return true;
+    }
+    std::cout << "=== Starting Input Device Monitor ===\n";
+
+    // Reset counters
+    stats.reset();
+    typing.reset();
+    activity.reset();
+    heatmaps.reset();
+
+    std::vector<std::string> paths = listDeviceNodes();
+    if (paths.empty()) {
+        std::cout << "No input devices found. Try running with sudo.\n";
+        return false;
+    }
+
+    if (!options.journalDirectory.empty()) {
+        JournalOptions journalOptions;
+        journalOptions.directory = options.journalDirectory;
+        journal.reset(new EventJournal(journalOptions));
+        if (!journal->open()) {
+            std::cerr << "Recording disabled: cannot open journal in " << options.journalDirectory << "\n";
+            journal.reset();
+        }
+    }
+
+    if (!options.sharedStatsName.empty() || !options.metricsSocket.empty()) {
+        // Created before any device is attached so every processor raises
+        // its change signal; the thread starts once monitoring is up
+        exporter.reset(new StatsExporter(*this, options.sharedStatsName, options.metricsSocket));
+    }
+
+    if (!options.historyDirectory.empty()) {
+        if (!historyStore) {
+            RollupOptions historyOptions;
+            historyOptions.directory = options.historyDirectory;
+            historyStore.reset(new RollupStore(historyOptions));
+            if (!historyStore->open()) {
+                std::cerr << "History disabled: cannot open " << options.historyDirectory << "\n";
+                historyStore.reset();
+            }
+        }
+        if (historyStore) {
+            recorder.reset(new HistoryRecorder(*this, *historyStore));
+        }
+    }
+
+    // One worker handles many devices; only spread out on hosts with lots of nodes
+    unsigned workers = static_cast<unsigned>((paths.size() + DEVICES_PER_WORKER - 1) / DEVICES_PER_WORKER);
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::max(1u, std::min(workers, std::min(std::max(1u, options.maxWorkers), cores)));
+    {
+        std::lock_guard<std::mutex> lock(engineMutex);
+        engine.reset(new EventEngine(workers));
+    }
+    running = true;
+    if (engine->start()) {
+        // Watch before enumerating so a device plugged in meanwhile is not missed
+        watcher.reset(new DeviceWatcher(options.deviceDirectory,
+                                        [this](const std::string& path) { attachDevice(path); }));
+        if (!watcher->start(*engine)) {
+            std::cerr << "Hotplug disabled: devices plugged in later will be ignored.\n";
+            watcher.reset();
+        }
+
+        ProbeReport report;
+        std::vector<std::unique_ptr<InputDevice>> probed = registry.probe(paths, &report);
+        std::cout << "Probed " << report.nodes << " node(s) in " << report.milliseconds << " ms: "
+                  << report.cached << " from cache, " << report.probed << " probed, "
+                  << report.monitored << " keyboard/mouse.\n";
+        registry.save();
+
+        for (auto& input : probed) {
+            attachDevice(std::move(input));
+        }
+    }
+
+    std::size_t attached;
+    std::size_t masked = 0;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        attached = devices.size();
+        for (const auto& device : devices) {
+            masked += device->masked;
+        }
+    }
+
+    if (attached == 0) {
+        std::cout << "No input devices found. Try running with sudo.\n";
+        running = false;
+        engine->stop();
+        watcher.reset();
+        journal.reset();
+        exporter.reset();
+        recorder.reset();
+        return false;
+    }
+
+    std::cout << "Monitoring " << attached << " device(s) with " << workers << " worker thread(s).\n";
+    std::cout << "Counting " << formatMetrics(options.metrics) << "; kernel event masks on " << masked << " of "
+              << attached << " device(s).\n";
+    startNs = steadyNs();
+    stopNs = 0;
+    pausedAtNs = 0;
+    pausedNs = 0;
+    startCpuNs = processCpuNs();
+    {
+        std::lock_guard<std::mutex> lock(lapsMutex);
+        finishedLaps.clear();
+        lapStartTotals = StatsSnapshot();
+        lapStartSeconds = 0.0;
+    }
+    if (exporter && !exporter->start()) {
+        std::cerr << "Statistics export disabled.\n";
+        // Still registered with the processors; it just never wakes up
+    }
+    if (recorder && !recorder->start()) {
+        std::cerr << "History recording disabled.\n";
+    }
+    notify(EngineEvent::Kind::Started);
+    return true;
+}
+
+void TrackerEngine::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+    std::cout << "=== Stopping Monitor ===\n";
+    stopNs = steadyNs();
+    stopCpuNs = processCpuNs();
+    if (paused.exchange(false)) {
+        pausedNs += stopNs.load() - pausedAtNs.load();
+    }
+
+    // Wake and join the workers, then release the devices they were reading
+    double elapsed = (stopNs.load() - startNs.load()) / 1e9;
+    uint64_t wakeups = engine->wakeups();
+    engine->stop();
+    std::cout << "Engine wakeups: " << wakeups << " ("
+              << (elapsed > 0 ? wakeups / elapsed : 0.0) << "/s)\n";
+    watcher.reset();
+    // Last export while the per-device latency is still there
+    if (exporter) {
+        exporter->stop();
+    }
+    // Records the minute in progress while the device rows are still there
+    if (recorder) {
+        recorder->stop();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        devices.clear();
+    }
+    exporter.reset();
+    recorder.reset();
+    journal.reset();
+    registry.save();
+
+    std::cout << "All monitoring threads stopped.\n";
+    notify(EngineEvent::Kind::Stopped);
+}
+
+void TrackerEngine::pause()
+{
+    if (!running.load() || paused.exchange(true)) {
+        return;
+    }
+    pausedAtNs = steadyNs();
+    {
+        std::lock_guard<std::mutex> lock(engineMutex);
+        engine->pause();
+    }
+    std::cout << "Monitoring paused.\n";
+    notify(EngineEvent::Kind::Paused);
+}
+
+void TrackerEngine::resume()
+{
+    if (!running.load() || !paused.load()) {
+        return;
+    }
+    {
+        // Drains what queued up while paused and re-arms the devices
+        std::lock_guard<std::mutex> lock(engineMutex);
+        engine->resume();
+    }
+    pausedNs += steadyNs() - pausedAtNs.load();
+    paused = false;
+    std::cout << "Monitoring resumed.\n";
+    notify(EngineEvent::Kind::Resumed);
+}
+
+unsigned TrackerEngine::markLap()
+{
+    unsigned next;
+    {
+        std::lock_guard<std::mutex> lock(lapsMutex);
+        StatsSnapshot totals = stats.snapshot();
+        double now = activeSeconds();
+
+        LapRecord lap;
+        lap.number = static_cast<unsigned>(finishedLaps.size()) + 1;
+        lap.startSeconds = lapStartSeconds;
+        lap.seconds = now - lapStartSeconds;
+        lap.counts = totals;
+        lap.counts -= lapStartTotals;
+        finishedLaps.push_back(lap);
+
+        lapStartTotals = totals;
+        lapStartSeconds = now;
+        next = lap.number + 1;
+    }
+    notify(EngineEvent::Kind::Lap);
+    return next;
+}
+
+std::vector<LapRecord> TrackerEngine::laps() const
+{
+    std::lock_guard<std::mutex> lock(lapsMutex);
+    std::vector<LapRecord> result = finishedLaps;
+
+    LapRecord current;
+    current.number = static_cast<unsigned>(finishedLaps.size()) + 1;
+    current.startSeconds = lapStartSeconds;
+    current.seconds = activeSeconds() - lapStartSeconds;
+    current.counts = stats.snapshot();
+    current.counts -= lapStartTotals;
+    current.current = running.load();
+    result.push_back(current);
+    return result;
+}
+
+// Time spent monitoring in this session, pauses excluded
+double TrackerEngine::activeSeconds() const
+{
+    int64_t begin = startNs.load();
+    if (begin == 0) {
+        return 0.0;
+    }
+    int64_t end = running.load() ? steadyNs() : stopNs.load();
+    int64_t idle = pausedNs.load();
+    if (paused.load()) {
+        idle += end - pausedAtNs.load();
+    }
+    int64_t active = end - begin - idle;
+    return active > 0 ? active / 1e9 : 0.0;
+}
+
+EngineSnapshot TrackerEngine::snapshot() const
+{
+    EngineSnapshot result;
+    result.running = running.load();
+    result.paused = paused.load();
+    result.totals = stats.snapshot();
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        result.devices = devices.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(engineMutex);
+        result.wakeups = engine ? engine->wakeups() : 0;
+    }
+    result.elapsedSeconds = activeSeconds();
+    return result;
+}
+
+std::vector<DeviceStats> TrackerEngine::deviceStats() const
+{
+    return stats.devices();
+}
+
+TypingSnapshot TrackerEngine::typingSnapshot() const
+{
+    return typing.snapshot();
+}
+
+double TrackerEngine::wordsPerMinute() const
+{
+    return typing.wordsPerMinute();
+}
+
+RollupSummary TrackerEngine::history(int64_t from, int64_t to, const std::string& deviceKey) const
+{
+    return historyStore ? historyStore->query(from, to, deviceKey) : RollupSummary();
+}
+
+std::vector<RollupRow> TrackerEngine::historyRows(RollupTier tier, int64_t from, int64_t to,
+                                                  const std::string& deviceKey) const
+{
+    return historyStore ? historyStore->rows(tier, from, to, deviceKey) : std::vector<RollupRow>();
+}
+
+RateSnapshot TrackerEngine::rates() const
+{
+    return activity.snapshot();
+}
+
+HeatmapGrid TrackerEngine::heatmap(HeatmapKind kind, std::size_t level) const
+{
+    return heatmaps.snapshot(kind, level);
+}
+
+EngineDiagnostics TrackerEngine::diagnostics() const
+{
+    EngineDiagnostics result;
+    LatencyCounts merged;
+    {
+        LatencyCounts counts;
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        for (const auto& device : devices) {
+            if (!device->latency) {
+                continue;
+            }
+            device->latency->copyTo(counts);
+            merged.merge(counts);
+            result.devices.push_back(DeviceDiagnostics{device->processor->name(), counts.percentiles()});
+        }
+    }
+    result.latency = merged.percentiles();
+
+    EngineSnapshot current = snapshot();
+    if (current.elapsedSeconds > 0) {
+        int64_t cpuNs = current.running ? processCpuNs() : stopCpuNs.load();
+        result.cpuSeconds = (cpuNs - startCpuNs.load()) / 1e9;
+        result.cpuPercent = 100.0 * result.cpuSeconds / current.elapsedSeconds;
+        result.wakeupsPerSecond = current.wakeups / current.elapsedSeconds;
+    }
+    return result;
+}
+
+void TrackerEngine::setChangeHandler(ChangeSignal::Handler handler)
+{
+    changed.setHandler(std::move(handler));
+}
+
+int TrackerEngine::subscribe(Listener listener)
+{
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    int id = nextListenerId++;
+    listeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void TrackerEngine::unsubscribe(int id)
+{
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                   [id](const std::pair<int, Listener>& entry) { return entry.first == id; }),
+                    listeners.end());
+}
+
+void TrackerEngine::notify(EngineEvent::Kind kind, const std::string& device)
+{
+    EngineEvent event{kind, device};
+    std::lock_guard<std::mutex> lock(listenersMutex);
+    for (const auto& entry : listeners) {
+        entry.second(event);
+    }
+}
+
+// The event* nodes of the device directory, in name order
+std::vector<std::string> TrackerEngine::listDeviceNodes() const
+{
+    std::vector<std::string> paths;
+    DIR* dir = opendir(options.deviceDirectory.c_str());
+    if (!dir) {
+        return paths;
+    }
+    std::string prefix = options.deviceDirectory;
+    if (!prefix.empty() && prefix.back() != '/') {
+        prefix += '/';
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "event", 5) == 0) {
+            paths.push_back(prefix + entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Probes a node and, if it is of a class we count, attaches it. Called by the
+// hotplug watcher, possibly more than once for the same node.
+bool TrackerEngine::attachDevice(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        for (const auto& device : devices) {
+            if (device->input->path == path) {
+                return true;
+            }
+        }
+    }
+
+    std::unique_ptr<InputDevice> input = registry.probe(path);
+    if (!input) {
+        return false;
+    }
+    return attachDevice(std::move(input));
+}
+
+// Registers an opened device with the engine, reusing the fd the registry
+// opened while probing.
+bool TrackerEngine::attachDevice(std::unique_ptr<InputDevice> input) {
+    std::unique_ptr<MonitoredDevice> device(new MonitoredDevice);
+    device->input = std::move(input);
+    const DeviceIdentity& identity = device->input->identity;
+    DeviceLabel label;
+    label.key = identity.key();
+    label.name = identity.name.empty() ? "(unknown)" : identity.name;
+    label.bustype = identity.bustype;
+    label.vendor = identity.vendor;
+    label.product = identity.product;
+    device->slot = stats.acquireSlot(label);
+    if (!device->slot) {
+        std::cerr << "No statistics slot left for " << device->input->path << "\n";
+        return false;
+    }
+    const std::string& name = device->input->identity.name;
+    device->processor.reset(new EventProcessor(device->input->type, device->slot, name.empty() ? "(unknown)" : name));
+    device->rates = activity.acquireSlot();
+    device->processor->setRateSlot(device->rates);
+    device->processor->addChangeSignal(&changed);
+    if (exporter) {
+        device->processor->addChangeSignal(exporter->changeSignal());
+    }
+    if (recorder) {
+        device->processor->addChangeSignal(recorder->changeSignal());
+    }
+    // Switch the device to the monotonic clock so event timestamps can be
+    // compared with our own clock reads; the latency histogram exists only
+    // for devices that accepted it
+    int clock = CLOCK_MONOTONIC;
+    if (ioctl(device->input->fd, EVIOCSCLOCKID, &clock) >= 0) {
+        device->latency.reset(new LatencyHistogram);
+        device->processor->setLatencyHistogram(device->latency.get());
+    } else {
+        Logger::log(LogLevel::Info, "[engine] No monotonic clock, latency not recorded for", name.c_str());
+    }
+    if (device->input->type == DeviceType::Keyboard) {
+        device->typing = typing.acquireSlot();
+        device->processor->setTypingSlot(device->typing);
+    } else if (device->input->type == DeviceType::Mouse || device->input->type == DeviceType::Touchpad) {
+        device->heatmap = heatmaps.acquireSlot(options.screenWidth, options.screenHeight);
+        device->processor->setHeatmapSlot(device->heatmap);
+    }
+    if (device->input->type == DeviceType::Touchpad) {
+        input_absinfo axis{};
+        if (ioctl(device->input->fd, EVIOCGABS(ABS_MT_POSITION_Y), &axis) >= 0) {
+            device->processor->setTouchResolution(axis.resolution);
+        }
+    }
+    // Only the events the enabled metrics need should reach this process
+    device->processor->setMetrics(options.metrics);
+    device->masked = applyEventMask(device->input->fd,
+                                    compileEventMask(options.metrics, device->input->type, journal != nullptr));
+    if (!device->masked) {
+        Logger::log(LogLevel::Info, "[engine] No kernel event mask, filtering in user space for", name.c_str());
+    }
+
+    MonitoredDevice* raw = device.get();
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        for (const auto& existing : devices) {
+            if (existing->input->path == raw->input->path) {
+                // Attached by someone else while we were probing
+                stats.releaseSlot(raw->slot);
+                typing.releaseSlot(raw->typing);
+                heatmaps.releaseSlot(raw->heatmap);
+                activity.releaseSlot(raw->rates);
+                return true;
+            }
+        }
+        devices.push_back(std::move(device));
+    }
+    // Journal names are a fixed table; a duplicate attach must not use one up
+    if (journal) {
+        raw->processor->setJournal(journal.get(), journal->registerDevice(raw->processor->name(), !raw->latency));
+    }
+
+    Logger::log(LogLevel::Info, monitoringMessage(raw->input->type), raw->processor->name().c_str());
+    if (!engine->addSource(raw->input->fd,
+                           [this, raw](int) { return handleDeviceEvents(*raw); },
+                           [this, raw](int) { detachDevice(raw); },
+                           [raw](int fd) { discardDeviceEvents(fd, *raw->processor); })) {
+        detachDevice(raw);
+        return false;
+    }
+    notify(EngineEvent::Kind::DeviceAttached, raw->processor->name());
+    return true;
+}
+
+// Called on the worker that saw the device fail (usually unplugged). Its
+// counters stay in the totals; the slot is recycled for the next device.
+void TrackerEngine::detachDevice(MonitoredDevice* device) {
+    std::unique_ptr<MonitoredDevice> owned;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        for (auto it = devices.begin(); it != devices.end(); ++it) {
+            if (it->get() == device) {
+                owned = std::move(*it);
+                devices.erase(it);
+                break;
+            }
+        }
+    }
+    if (!owned) {
+        return;
+    }
+
+    Logger::log(LogLevel::Info, "[hotplug] Device removed:", owned->processor->name().c_str());
+    stats.releaseSlot(owned->slot);
+    typing.releaseSlot(owned->typing);
+    heatmaps.releaseSlot(owned->heatmap);
+    activity.releaseSlot(owned->rates);
+    notify(EngineEvent::Kind::DeviceDetached, owned->processor->name());
+}
+
+// Runs on an engine worker whenever the device fd is readable. Reads whole
+// batches of events until the fd is drained; returning false tells the
+// engine to drop the device.
+bool TrackerEngine::handleDeviceEvents(MonitoredDevice& device) {
+    return readDeviceEvents(device.input->fd, *device.processor) == ReadStatus::Drained;
+}
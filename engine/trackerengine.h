@@ -0,0 +1,248 @@
+#ifndef TRACKERENGINE_H
+#define TRACKERENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "eventengine.h"
+#include "statistics.h"
+#include "typingstats.h"
+#include "activityrates.h"
+#include "heatmap.h"
+#include "latencyhistogram.h"
+#include "eventprocessor.h"
+#include "devicewatcher.h"
+#include "deviceregistry.h"
+#include "eventjournal.h"
+#include "rollupstore.h"
+
+class StatsExporter;
+class HistoryRecorder;
+
+struct EngineOptions {
+    std::string deviceDirectory = "/dev/input/";
+    // Record raw events into this directory while running (empty: off)
+    std::string journalDirectory;
+    unsigned maxWorkers = 4;
+    // Virtual screen the heatmaps' cursor is clamped to, in device units
+    int screenWidth = HEATMAP_DEFAULT_WIDTH;
+    int screenHeight = HEATMAP_DEFAULT_HEIGHT;
+    // Export counters to this POSIX shared-memory name, e.g. "/knm_tracker"
+    // (empty: off)
+    std::string sharedStatsName;
+    // Serve Prometheus text on this Unix socket path (empty: off)
+    std::string metricsSocket;
+    // Keep per-minute history in this directory across sessions (empty: off)
+    std::string historyDirectory;
+    // What to count; events no enabled metric needs are masked in the kernel
+    MetricSet metrics = ALL_METRICS;
+};
+
+// Everything a client shows, read without stopping the producers
+struct EngineSnapshot {
+    bool running = false;
+    bool paused = false;
+    StatsSnapshot totals;
+    std::size_t devices = 0;
+    double elapsedSeconds = 0.0;    // monitoring time, pauses excluded
+    uint64_t wakeups = 0;
+};
+
+// One segment of a session between two markLap() calls
+struct LapRecord {
+    unsigned number = 0;            // from 1
+    double startSeconds = 0.0;      // session time the lap began
+    double seconds = 0.0;           // monitoring time in the lap
+    StatsSnapshot counts;
+    bool current = false;           // still running
+};
+
+// Delivery-to-processing latency of one device, in microseconds
+struct DeviceDiagnostics {
+    std::string name;
+    LatencyPercentiles latency;
+};
+
+// How the tracker itself is doing
+struct EngineDiagnostics {
+    std::vector<DeviceDiagnostics> devices;
+    LatencyPercentiles latency;     // every device merged
+    double cpuSeconds = 0.0;        // process CPU time since start()
+    double cpuPercent = 0.0;        // of one core, averaged since start()
+    double wakeupsPerSecond = 0.0;
+};
+
+// Lifecycle notifications handed to subscribers
+struct EngineEvent {
+    enum class Kind {
+        Started,
+        Stopped,
+        Paused,
+        Resumed,
+        Lap,
+        DeviceAttached,
+        DeviceDetached
+    };
+    Kind kind;
+    std::string device;   // device name for the Device* kinds
+};
+
+// The tracker without any UI: discovers input devices, reads them on
+// the event engine, follows hotplug and keeps the counters. The GUI and
+// the headless daemon are both thin clients of this class.
+class TrackerEngine
+{
+public:
+    // Called on the thread that caused the event: the caller of start() and
+    // stop(), or an engine worker for hotplug. Keep it short and do not
+    // subscribe or unsubscribe from inside it.
+    using Listener = std::function<void(const EngineEvent& event)>;
+
+    explicit TrackerEngine(EngineOptions options = EngineOptions());
+    ~TrackerEngine();
+
+    TrackerEngine(const TrackerEngine&) = delete;
+    TrackerEngine& operator=(const TrackerEngine&) = delete;
+
+    void setOptions(const EngineOptions& options);
+
+    // Returns false, with nothing left running, when no input device could
+    // be opened (usually missing permissions).
+    bool start();
+    void stop();
+    bool isRunning() const { return running.load(); }
+
+    // Pausing keeps the session: devices stay open and registered, counters
+    // and laps are kept, and nothing is read until resume(). Input made
+    // while paused is discarded. Both return at once and can be called from
+    // a UI thread.
+    void pause();
+    void resume();
+    bool isPaused() const { return paused.load(); }
+
+    // Closes the current lap and starts the next one; returns its number.
+    // Every lap keeps its own counters; the session totals are unaffected.
+    unsigned markLap();
+    // Finished laps followed by the current one
+    std::vector<LapRecord> laps() const;
+
+    // Safe from any thread, at any time
+    EngineSnapshot snapshot() const;
+    // Monitoring time alone, pauses excluded; what snapshot() reports
+    double activeSeconds() const;
+    // Counters per device with name, bus/vendor/product and first/last
+    // seen, including devices unplugged during this session
+    std::vector<DeviceStats> deviceStats() const;
+    // Per-key tables of every keyboard; larger, so fetched separately
+    TypingSnapshot typingSnapshot() const;
+    // Words per minute of every keyboard, without the tables
+    double wordsPerMinute() const;
+    // Activity of the last minute by second, hour by minute, day by hour
+    RateSnapshot rates() const;
+    // Cursor or click map of every mouse at one pyramid level
+    // (heatmapLevelFor() picks one for a view size)
+    HeatmapGrid heatmap(HeatmapKind kind, std::size_t level) const;
+    // Per-device latency percentiles plus the tracker's CPU time and wakeups
+    EngineDiagnostics diagnostics() const;
+    // Totals from the history store (all devices, or one DeviceLabel::key)
+    // between two Unix times, including this session up to the last minute.
+    // Empty without EngineOptions::historyDirectory. Call from the thread
+    // that calls start().
+    bool hasHistory() const { return historyStore != nullptr; }
+    RollupSummary history(int64_t from, int64_t to, const std::string& deviceKey = ROLLUP_TOTAL_SERIES) const;
+    std::vector<RollupRow> historyRows(RollupTier tier, int64_t from, int64_t to,
+                                       const std::string& deviceKey = ROLLUP_TOTAL_SERIES) const;
+
+    // Push-style change notification for clients that redraw on change.
+    // `handler` runs on an engine worker the first time counters change
+    // after consumeChanges(), and not again until the next consumeChanges().
+    // Set it while the engine is stopped.
+    void setChangeHandler(ChangeSignal::Handler handler);
+    bool consumeChanges() { return changed.consume(); }
+
+    int subscribe(Listener listener);
+    void unsubscribe(int id);
+
+private:
+    // An opened device registered with the engine
+    struct MonitoredDevice {
+        std::unique_ptr<InputDevice> input;
+
+        // Owned by whichever worker is handling the device
+        StatsSlot* slot = nullptr;
+        TypingSlot* typing = nullptr;   // keyboards only
+        HeatmapSlot* heatmap = nullptr; // mice and touchpads
+        RateSlot* rates = nullptr;
+        // Null when the device refused a monotonic clock
+        std::unique_ptr<LatencyHistogram> latency;
+        std::unique_ptr<EventProcessor> processor;
+        bool masked = false;            // kernel filters its events
+    };
+
+    std::vector<std::string> listDeviceNodes() const;
+    bool attachDevice(const std::string& path);
+    bool attachDevice(std::unique_ptr<InputDevice> input);
+    void detachDevice(MonitoredDevice* device);
+    bool handleDeviceEvents(MonitoredDevice& device);
+    void notify(EngineEvent::Kind kind, const std::string& device = std::string());
+
+    EngineOptions options;
+    std::atomic<bool> running{false};
+    std::atomic<bool> paused{false};
+
+    // Event engine waiting on all device fds, and the hotplug watcher feeding
+    // it. The engine is kept after stop() so its wakeup count stays readable;
+    // engineMutex only guards replacing it against snapshot().
+    std::unique_ptr<EventEngine> engine;
+    mutable std::mutex engineMutex;
+    std::unique_ptr<DeviceWatcher> watcher;
+
+    // Shared data, one slot per device
+    StatsCore stats;
+    TypingStats typing;
+    ActivityRates activity;
+    HeatmapStats heatmaps;
+    ChangeSignal changed;
+    std::atomic<int64_t> startNs{0};
+    std::atomic<int64_t> stopNs{0};
+    std::atomic<int64_t> startCpuNs{0};
+    std::atomic<int64_t> stopCpuNs{0};
+    std::atomic<int64_t> pausedAtNs{0};
+    std::atomic<int64_t> pausedNs{0};     // total of finished pauses
+
+    // Laps of the current session
+    mutable std::mutex lapsMutex;
+    std::vector<LapRecord> finishedLaps;
+    StatsSnapshot lapStartTotals;
+    double lapStartSeconds = 0.0;
+
+    // Optional raw event recording
+    std::unique_ptr<EventJournal> journal;
+
+    // Optional shared-memory / metrics socket export
+    std::unique_ptr<StatsExporter> exporter;
+
+    // Optional long-term history; the store stays open between sessions
+    std::unique_ptr<RollupStore> historyStore;
+    std::unique_ptr<HistoryRecorder> recorder;
+
+    // Probes nodes once and caches their capabilities across sessions
+    DeviceRegistry registry;
+
+    // Attached from the starting thread and from workers on hotplug
+    std::vector<std::unique_ptr<MonitoredDevice>> devices;
+    mutable std::mutex devicesMutex;
+
+    std::mutex listenersMutex;
+    std::vector<std::pair<int, Listener>> listeners;
+    int nextListenerId = 1;
+};
+
+#endif // TRACKERENGINE_H
@@ -0,0 +1,245 @@
+#include "typingstats.h"
+#include "statistics.h"
+
+#include <libevdev/libevdev.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Keys that produce a character on a standard layout
+bool isCharacterKey(uint16_t code)
+{
+    return (code >= KEY_1 && code <= KEY_EQUAL) ||
+           (code >= KEY_Q && code <= KEY_RIGHTBRACE) ||
+           (code >= KEY_A && code <= KEY_GRAVE) ||
+           (code >= KEY_BACKSLASH && code <= KEY_SLASH) ||
+           code == KEY_SPACE;
+}
+
+} // namespace
+
+std::vector<KeyCount> TypingSnapshot::topKeys(std::size_t count) const
+{
+    std::vector<KeyCount> keys;
+    for (uint16_t code = 0; code < KEY_CNT; ++code) {
+        if (presses[code] != 0) {
+            keys.push_back(KeyCount{code, presses[code]});
+        }
+    }
+    count = std::min(count, keys.size());
+    std::partial_sort(keys.begin(), keys.begin() + count, keys.end(),
+                      [](const KeyCount& a, const KeyCount& b) { return a.count > b.count; });
+    keys.resize(count);
+    return keys;
+}
+
+std::vector<BigramCount> TypingSnapshot::topBigrams(std::size_t count) const
+{
+    std::vector<BigramCount> pairs;
+    for (std::size_t i = 0; i < bigrams.size(); ++i) {
+        if (bigrams[i] != 0) {
+            pairs.push_back(BigramCount{static_cast<uint16_t>(i / BIGRAM_KEYS),
+                                        static_cast<uint16_t>(i % BIGRAM_KEYS), bigrams[i]});
+        }
+    }
+    count = std::min(count, pairs.size());
+    std::partial_sort(pairs.begin(), pairs.begin() + count, pairs.end(),
+                      [](const BigramCount& a, const BigramCount& b) { return a.count > b.count; });
+    pairs.resize(count);
+    return pairs;
+}
+
+double TypingSnapshot::medianIntervalMs() const
+{
+    uint64_t total = 0;
+    for (uint64_t bucket : intervals) {
+        total += bucket;
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < INTERVAL_BUCKETS; ++i) {
+        seen += intervals[i];
+        if (seen * 2 >= total) {
+            // Middle of the bucket
+            return (i + 0.5) * INTERVAL_BUCKET_US / 1000.0;
+        }
+    }
+    return INTERVAL_BUCKETS * INTERVAL_BUCKET_US / 1000.0;
+}
+
+TypingSlot::TypingSlot()
+    : bigrams(new std::atomic<uint32_t>[BIGRAM_KEYS * BIGRAM_KEYS])
+{
+    reset();
+}
+
+void TypingSlot::recordPress(uint16_t code, int64_t eventUs, int64_t nowSecond)
+{
+    if (code >= KEY_CNT) {
+        return;
+    }
+    bump(presses[code]);
+
+    if (lastCode != KEY_RESERVED) {
+        int64_t gap = eventUs - lastPressUs;
+        if (gap >= 0) {
+            std::size_t bucket = std::min<int64_t>(gap / INTERVAL_BUCKET_US, INTERVAL_BUCKETS - 1);
+            bump(intervals[bucket]);
+        }
+        if (gap >= 0 && gap <= BIGRAM_MAX_GAP_US && lastCode < BIGRAM_KEYS && code < BIGRAM_KEYS) {
+            bump(bigrams[lastCode * BIGRAM_KEYS + code]);
+        }
+    }
+    lastCode = code;
+    lastPressUs = eventUs;
+
+    if (isCharacterKey(code)) {
+        std::size_t index = static_cast<std::size_t>(nowSecond) % WPM_WINDOW_SECONDS;
+        if (windowSecond[index].load(std::memory_order_relaxed) != nowSecond) {
+            // Invalidate the bucket while it is recycled for a new second
+            windowSecond[index].store(-1, std::memory_order_relaxed);
+            windowChars[index].store(0, std::memory_order_relaxed);
+            windowSecond[index].store(nowSecond, std::memory_order_release);
+        }
+        bump(windowChars[index]);
+    }
+}
+
+void TypingSlot::addTo(TypingSnapshot& snapshot, int64_t nowSecond) const
+{
+    for (std::size_t code = 0; code < KEY_CNT; ++code) {
+        uint32_t count = presses[code].load(std::memory_order_relaxed);
+        snapshot.presses[code] += count;
+        snapshot.totalPresses += count;
+    }
+    for (std::size_t i = 0; i < INTERVAL_BUCKETS; ++i) {
+        snapshot.intervals[i] += intervals[i].load(std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < BIGRAM_KEYS * BIGRAM_KEYS; ++i) {
+        snapshot.bigrams[i] += bigrams[i].load(std::memory_order_relaxed);
+    }
+    snapshot.recentChars += recentChars(nowSecond);
+}
+
+uint64_t TypingSlot::recentChars(int64_t nowSecond) const
+{
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < WPM_WINDOW_SECONDS; ++i) {
+        int64_t second = windowSecond[i].load(std::memory_order_acquire);
+        if (second < 0 || nowSecond - second >= static_cast<int64_t>(WPM_WINDOW_SECONDS)) {
+            continue;
+        }
+        uint32_t chars = windowChars[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (windowSecond[i].load(std::memory_order_relaxed) == second) {
+            total += chars;
+        }
+    }
+    return total;
+}
+
+void TypingSlot::reset()
+{
+    for (auto& counter : presses) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& counter : intervals) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < BIGRAM_KEYS * BIGRAM_KEYS; ++i) {
+        bigrams[i].store(0, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < WPM_WINDOW_SECONDS; ++i) {
+        windowSecond[i].store(-1, std::memory_order_relaxed);
+        windowChars[i].store(0, std::memory_order_relaxed);
+    }
+    forgetLastPress();
+}
+
+void TypingSlot::forgetLastPress()
+{
+    lastCode = KEY_RESERVED;
+    lastPressUs = 0;
+}
+
+TypingStats::TypingStats(std::size_t capacity)
+    : capacity(capacity)
+{
+}
+
+TypingSlot* TypingStats::acquireSlot()
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    if (!freeSlots.empty()) {
+        TypingSlot* slot = freeSlots.back();
+        freeSlots.pop_back();
+        slot->forgetLastPress();
+        return slot;
+    }
+    if (allSlots.size() >= capacity) {
+        return nullptr;
+    }
+    allSlots.emplace_back(new TypingSlot);
+    return allSlots.back().get();
+}
+
+void TypingStats::releaseSlot(TypingSlot* slot)
+{
+    if (slot) {
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        freeSlots.push_back(slot);
+    }
+}
+
+TypingSnapshot TypingStats::snapshot() const
+{
+    TypingSnapshot result;
+    result.bigrams.assign(BIGRAM_KEYS * BIGRAM_KEYS, 0);
+    int64_t now = currentSecond();
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        slot->addTo(result, now);
+    }
+    return result;
+}
+
+double TypingStats::wordsPerMinute() const
+{
+    uint64_t chars = 0;
+    int64_t now = currentSecond();
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        chars += slot->recentChars(now);
+    }
+    return static_cast<double>(chars) / CHARS_PER_WORD;
+}
+
+void TypingStats::reset()
+{
+    std::lock_guard<std::mutex> lock(slotsMutex);
+    for (const auto& slot : allSlots) {
+        slot->reset();
+    }
+    freeSlots.clear();
+    for (const auto& slot : allSlots) {
+        freeSlots.push_back(slot.get());
+    }
+}
+
+std::string keyName(uint16_t code)
+{
+    const char* name = libevdev_event_code_get_name(EV_KEY, code);
+    if (!name) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "0x%03x", code);
+        return buffer;
+    }
+    if (std::strncmp(name, "KEY_", 4) == 0) {
+        name += 4;
+    }
+    return name;
+}
@@ -0,0 +1,132 @@
+#ifndef TYPINGSTATS_H
+#define TYPINGSTATS_H
+
+#include <linux/input.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bigrams are tracked between the first BIGRAM_KEYS codes, which cover the
+// whole main block, the keypad and the usual modifiers: a dense table of
+// 128 x 128 counters, so a transition is one indexed increment.
+constexpr std::size_t BIGRAM_KEYS = 128;
+// A press more than this long after the previous one starts a new run
+constexpr int64_t BIGRAM_MAX_GAP_US = 2000000;
+
+// Press-to-press intervals in 20 ms buckets; the last one collects pauses
+constexpr std::size_t INTERVAL_BUCKETS = 32;
+constexpr int64_t INTERVAL_BUCKET_US = 20000;
+
+// WPM counts character keys over the last minute, five characters a word
+constexpr std::size_t WPM_WINDOW_SECONDS = 60;
+constexpr unsigned CHARS_PER_WORD = 5;
+
+struct KeyCount {
+    uint16_t code;
+    uint64_t count;
+};
+
+struct BigramCount {
+    uint16_t first;
+    uint16_t second;
+    uint64_t count;
+};
+
+// Aggregated copy of every keyboard's tables, built on the reader side
+struct TypingSnapshot {
+    std::array<uint64_t, KEY_CNT> presses{};
+    std::array<uint64_t, INTERVAL_BUCKETS> intervals{};
+    std::vector<uint32_t> bigrams;   // BIGRAM_KEYS * BIGRAM_KEYS, row = first key
+    uint64_t totalPresses = 0;
+    uint64_t recentChars = 0;        // character keys in the last minute
+
+    double wordsPerMinute() const { return static_cast<double>(recentChars) / CHARS_PER_WORD; }
+    std::vector<KeyCount> topKeys(std::size_t count) const;
+    std::vector<BigramCount> topBigrams(std::size_t count) const;
+    // Interval below which half of the presses followed, in milliseconds
+    double medianIntervalMs() const;
+};
+
+// Per-keyboard tables, written by exactly one producer. Each counter is an
+// atomic updated with a plain load/store pair, so readers never see a torn
+// value; unlike StatsSlot there is no seqlock across the whole table, which
+// would make a 70 KB copy retry under load. A snapshot can therefore be a
+// few presses behind in one table relative to another.
+class TypingSlot
+{
+public:
+    TypingSlot();
+
+    TypingSlot(const TypingSlot&) = delete;
+    TypingSlot& operator=(const TypingSlot&) = delete;
+
+    // Producer side. `eventUs` is the event timestamp, `nowSecond` the
+    // currentSecond() sampled once per batch by the caller.
+    void recordPress(uint16_t code, int64_t eventUs, int64_t nowSecond);
+
+    // Reader side. Adds this slot's counts to `snapshot`.
+    void addTo(TypingSnapshot& snapshot, int64_t nowSecond) const;
+    // Reader side. Character keys in the WPM window ending at `nowSecond`.
+    uint64_t recentChars(int64_t nowSecond) const;
+
+    void reset();
+    // Forgets the previous press, so a slot handed to another keyboard
+    // records no bigram or interval across the two devices
+    void forgetLastPress();
+
+private:
+    static void bump(std::atomic<uint32_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint32_t> presses[KEY_CNT];
+    std::atomic<uint32_t> intervals[INTERVAL_BUCKETS];
+    std::unique_ptr<std::atomic<uint32_t>[]> bigrams;
+
+    // One bucket per second of the WPM window, tagged with its second
+    std::atomic<int64_t> windowSecond[WPM_WINDOW_SECONDS];
+    std::atomic<uint32_t> windowChars[WPM_WINDOW_SECONDS];
+
+    // Producer-only state
+    uint16_t lastCode = KEY_RESERVED;
+    int64_t lastPressUs = 0;
+};
+
+// Pool of typing slots, one per keyboard. Slots are only allocated when a
+// keyboard attaches, so mouse-only hosts pay nothing; released slots keep
+// their counts and are handed out again, like StatsCore.
+class TypingStats
+{
+public:
+    explicit TypingStats(std::size_t capacity = 32);
+
+    TypingStats(const TypingStats&) = delete;
+    TypingStats& operator=(const TypingStats&) = delete;
+
+    // Returns nullptr when every slot is taken
+    TypingSlot* acquireSlot();
+    void releaseSlot(TypingSlot* slot);
+
+    TypingSnapshot snapshot() const;
+    // Just the WPM of every keyboard, without copying the tables
+    double wordsPerMinute() const;
+
+    // Zeroes every slot and releases them. Only call while no producer runs.
+    void reset();
+
+private:
+    std::size_t capacity;
+    mutable std::mutex slotsMutex;
+    std::vector<std::unique_ptr<TypingSlot>> allSlots;
+    std::vector<TypingSlot*> freeSlots;
+};
+
+// "A", "SPACE", "LEFTSHIFT", ...; the code in hex for unnamed keys
+std::string keyName(uint16_t code);
+
+#endif // TYPINGSTATS_H
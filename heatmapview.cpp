@@ -0,0 +1,72 @@
+#include "heatmapview.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const QColor BACKGROUND(0x2c, 0x3e, 0x50);
+
+// Dark blue through red to yellow as `t` goes from 0 to 1
+QRgb heatColor(double t)
+{
+    int r = static_cast<int>(255 * std::min(1.0, t * 2.0));
+    int g = static_cast<int>(255 * std::max(0.0, t * 2.0 - 1.0));
+    int b = static_cast<int>(80 * (1.0 - t));
+    return qRgb(std::max(r, BACKGROUND.red()), std::max(g, BACKGROUND.green()), std::max(b, BACKGROUND.blue()));
+}
+
+} // namespace
+
+HeatmapView::HeatmapView(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(160, 90);
+}
+
+std::size_t HeatmapView::preferredCells() const
+{
+    return static_cast<std::size_t>(std::max(width(), height()));
+}
+
+void HeatmapView::setGrid(const HeatmapGrid &grid)
+{
+    const int size = static_cast<int>(grid.size);
+    if (image.width() != size) {
+        image = QImage(size, size, QImage::Format_RGB32);
+    }
+    peak = grid.peak();
+
+    // Log scale, so a few hot cells do not wash out the rest
+    const double scale = 1.0 / std::log1p(static_cast<double>(std::max<uint64_t>(peak, 1)));
+    for (int y = 0; y < size; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size; ++x) {
+            uint64_t count = grid.at(x, y);
+            line[x] = count ? heatColor(std::log1p(static_cast<double>(count)) * scale) : BACKGROUND.rgb();
+        }
+    }
+    update();
+}
+
+void HeatmapView::clear()
+{
+    image = QImage();
+    peak = 0;
+    update();
+}
+
+void HeatmapView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    if (image.isNull()) {
+        painter.fillRect(event->rect(), BACKGROUND);
+        return;
+    }
+    // Nearest-neighbour: cells stay crisp squares at every level
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.drawImage(rect(), image);
+}
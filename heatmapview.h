@@ -0,0 +1,33 @@
+#ifndef HEATMAPVIEW_H
+#define HEATMAPVIEW_H
+
+#include <QWidget>
+#include <QImage>
+
+#include "heatmap.h"
+
+// Draws one heatmap grid, stretched to the widget. The caller picks the
+// pyramid level with heatmapLevelFor(preferredCells()), so a small view
+// reads a small level and nothing is rescanned or downsampled here.
+class HeatmapView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit HeatmapView(QWidget *parent = nullptr);
+
+    void setGrid(const HeatmapGrid &grid);
+    void clear();
+
+    // Cells per side worth reading for the current size
+    std::size_t preferredCells() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QImage image;
+    uint64_t peak = 0;
+};
+
+#endif // HEATMAPVIEW_H
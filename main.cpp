@@ -1,15 +1,64 @@
 #include "mainwindow.h"
+#include "eventmask.h"
+#include "logger.h"
+#include "sharedstats.h"
 #include <QApplication>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 int main(int argc, char *argv[])
 {
     std::cout << "=== Input Device Monitor (Qt GUI) ===\n";
     std::cout << "Run with sudo if you get permission errors.\n";
 
+    // Log level: --log-level=<off|info|debug|trace>, or TRACKER_LOG_LEVEL
+    // Raw event recording: --record=<directory>
+    // Shared-memory export: --shm[=<name>]; Prometheus socket: --metrics-socket=<path>
+    // Heatmap virtual screen: --screen=<width>x<height>
+    // Long-term per-minute history: --history=<dir>
+    // What to count: --metrics=<keys,clicks,scroll,movement,strokes,gamepad|all>
+    LogLevel level = LogLevel::Info;
+    const char* requested = std::getenv("TRACKER_LOG_LEVEL");
+    EngineOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--log-level=", 12) == 0) {
+            requested = argv[i] + 12;
+        } else if (std::strncmp(argv[i], "--record=", 9) == 0) {
+            options.journalDirectory = argv[i] + 9;
+        } else if (std::strcmp(argv[i], "--shm") == 0) {
+            options.sharedStatsName = SHARED_STATS_DEFAULT_NAME;
+        } else if (std::strncmp(argv[i], "--shm=", 6) == 0) {
+            options.sharedStatsName = argv[i] + 6;
+        } else if (std::strncmp(argv[i], "--metrics-socket=", 17) == 0) {
+            options.metricsSocket = argv[i] + 17;
+        } else if (std::strncmp(argv[i], "--history=", 10) == 0) {
+            options.historyDirectory = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--metrics=", 10) == 0) {
+            if (!parseMetrics(argv[i] + 10, options.metrics)) {
+                std::cerr << "Unknown metrics '" << argv[i] + 10 << "', counting all.\n";
+            }
+        } else if (std::strncmp(argv[i], "--screen=", 9) == 0) {
+            std::sscanf(argv[i] + 9, "%dx%d", &options.screenWidth, &options.screenHeight);
+        }
+    }
+    if (requested && !parseLogLevel(requested, level)) {
+        std::cerr << "Unknown log level '" << requested << "', using info.\n";
+    }
+    Logger::setLevel(level);
+    Logger::instance().start();
+
     QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
+    int rc;
+    {
+        MainWindow w;
+        w.setEngineOptions(options);
+        w.show();
+        rc = a.exec();
+    }
 
-    return a.exec();
+    Logger::instance().stop();
+    return rc;
 }
@@ -7,36 +7,34 @@
 #include <QPushButton>
 #include <QTimer>
 #include <QMessageBox>
-#include <QDir>
 #include <QFrame>
 #include <QIcon>
 #include <QMessageBox>
 #include <QDebug>
 #include <QFile>
+#include <QStringList>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QEvent>
+#include <QDateTime>
+#include <QHeaderView>
+#include <QTableWidgetItem>
 
 #include <iostream>
-#include <string>
-#include <dirent.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <linux/input.h>
-#include <libevdev/libevdev.h>
-#include <cmath>
-#include <cstring>
-#include <cerrno>
-#include <chrono>
-#include <thread>
-
-constexpr const char* DEVICE_DIR = "/dev/input/";
-constexpr useconds_t SLEEP_MICROSECONDS = 10000;
+#include <algorithm>
+
+constexpr std::size_t TOP_KEYS_SHOWN = 8;
+constexpr std::size_t TOP_BIGRAMS_SHOWN = 5;
+
+const QStringList DEVICE_COLUMNS = {"#", "Device", "Bus:Vendor:Product", "Keys", "Clicks",
+                                    "Scroll", "Distance", "First seen", "Last seen"};
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent),
-    monitoring(false)
+    : QMainWindow(parent)
 {
     // Set window properties
     setWindowTitle("KnM_Tracker");
-    setFixedSize(800, 500);
+    setFixedSize(800, 920);
 
     // Main central widget
     QWidget *centralWidget = new QWidget(this);
@@ -54,7 +52,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     QVBoxLayout *leftPanelLayout = new QVBoxLayout(leftPanel);
     leftPanelLayout->setAlignment(Qt::AlignCenter);
-    leftPanelLayout->setSpacing(20);
+    leftPanelLayout->setSpacing(8);
 
     // Keyboard Press
     QLabel *keyboardLabel = new QLabel("Keyboard Press", this);
@@ -67,6 +65,11 @@ MainWindow::MainWindow(QWidget *parent)
     keyboardCountLabel->setStyleSheet("font-size: 36px; font-weight: bold; color: black;");
     leftPanelLayout->addWidget(keyboardCountLabel);
 
+    keyboardRateLabel = new QLabel("0 /min", this);
+    keyboardRateLabel->setAlignment(Qt::AlignCenter);
+    keyboardRateLabel->setStyleSheet("font-size: 14px; color: #555555;");
+    leftPanelLayout->addWidget(keyboardRateLabel);
+
     // Mouse Click
     QLabel *mouseClickLabel = new QLabel("Mouse Click", this);
     mouseClickLabel->setAlignment(Qt::AlignCenter);
@@ -78,6 +81,11 @@ MainWindow::MainWindow(QWidget *parent)
     mouseCountLabel->setStyleSheet("font-size: 36px; font-weight: bold; color: black;");
     leftPanelLayout->addWidget(mouseCountLabel);
 
+    mouseRateLabel = new QLabel("0 /min", this);
+    mouseRateLabel->setAlignment(Qt::AlignCenter);
+    mouseRateLabel->setStyleSheet("font-size: 14px; color: #555555;");
+    leftPanelLayout->addWidget(mouseRateLabel);
+
     // Mouse Scroll
     QLabel *mouseScrollLabel = new QLabel("Mouse Scroll", this);
     mouseScrollLabel->setAlignment(Qt::AlignCenter);
@@ -89,6 +97,11 @@ MainWindow::MainWindow(QWidget *parent)
     scrollCountLabel->setStyleSheet("font-size: 36px; font-weight: bold; color: black;");
     leftPanelLayout->addWidget(scrollCountLabel);
 
+    scrollRateLabel = new QLabel("0 /min", this);
+    scrollRateLabel->setAlignment(Qt::AlignCenter);
+    scrollRateLabel->setStyleSheet("font-size: 14px; color: #555555;");
+    leftPanelLayout->addWidget(scrollRateLabel);
+
     // Mouse Movement
     QLabel *mouseMovementLabel = new QLabel("Mouse Movement", this);
     mouseMovementLabel->setAlignment(Qt::AlignCenter);
@@ -100,6 +113,11 @@ MainWindow::MainWindow(QWidget *parent)
     mouseDistanceLabel->setStyleSheet("font-size: 36px; font-weight: bold; color: black;");
     leftPanelLayout->addWidget(mouseDistanceLabel);
 
+    distanceRateLabel = new QLabel("0 /min", this);
+    distanceRateLabel->setAlignment(Qt::AlignCenter);
+    distanceRateLabel->setStyleSheet("font-size: 14px; color: #555555;");
+    leftPanelLayout->addWidget(distanceRateLabel);
+
     // --- Right Panel (Timer and Controls) ---
     QFrame *rightPanel = new QFrame(centralWidget);
     rightPanel->setStyleSheet("background-color: #E0E0E0;"); // Light grey background
@@ -133,13 +151,115 @@ MainWindow::MainWindow(QWidget *parent)
     connect(toggleMonitoringButton, &QPushButton::clicked, this, &MainWindow::onToggleMonitoring);
     rightPanelLayout->addWidget(toggleMonitoringButton, 0, Qt::AlignHCenter);rightPanelLayout->addWidget(toggleMonitoringButton, 0, Qt::AlignHCenter);
 
-
-
-
-
-    // Set up update timer (updates UI every second)
+    // Heatmap Button
+    heatmapButton = new QPushButton("Heatmaps", this);
+    heatmapButton->setFixedSize(160, 32);
+    heatmapButton->setStyleSheet("font-size: 14px;");
+    connect(heatmapButton, &QPushButton::clicked, this, &MainWindow::onShowHeatmaps);
+    rightPanelLayout->addWidget(heatmapButton, 0, Qt::AlignHCenter);
+
+    // Laps: counters of the session split at each press
+    lapButton = new QPushButton("Lap", this);
+    lapButton->setFixedSize(160, 32);
+    lapButton->setStyleSheet("font-size: 14px;");
+    connect(lapButton, &QPushButton::clicked, this, &MainWindow::onMarkLap);
+    rightPanelLayout->addWidget(lapButton, 0, Qt::AlignHCenter);
+
+    lapsLabel = new QLabel("No laps", this);
+    lapsLabel->setAlignment(Qt::AlignCenter);
+    lapsLabel->setStyleSheet("font-family: monospace; font-size: 12px; color: black;");
+    rightPanelLayout->addWidget(lapsLabel);
+
+    // --- Bottom Panel (Typing) ---
+    QFrame *typingPanel = new QFrame(centralWidget);
+    typingPanel->setStyleSheet("background-color: #F5F5F5;");
+    mainLayout->addWidget(typingPanel, 1, 0, 1, 2);
+
+    QHBoxLayout *typingPanelLayout = new QHBoxLayout(typingPanel);
+    typingPanelLayout->setContentsMargins(20, 10, 20, 10);
+    typingPanelLayout->setSpacing(30);
+
+    wpmLabel = new QLabel("0 WPM", this);
+    wpmLabel->setStyleSheet("font-size: 28px; font-weight: bold; color: black;");
+    typingPanelLayout->addWidget(wpmLabel);
+
+    topKeysLabel = new QLabel("Top keys: -", this);
+    topKeysLabel->setStyleSheet("font-size: 16px; color: black;");
+    topKeysLabel->setWordWrap(true);
+    typingPanelLayout->addWidget(topKeysLabel, 1);
+
+    // --- Diagnostics Panel ---
+    QFrame *diagnosticsPanel = new QFrame(centralWidget);
+    diagnosticsPanel->setStyleSheet("background-color: #2c3e50;");
+    mainLayout->addWidget(diagnosticsPanel, 2, 0, 1, 2);
+
+    QVBoxLayout *diagnosticsPanelLayout = new QVBoxLayout(diagnosticsPanel);
+    diagnosticsPanelLayout->setContentsMargins(20, 8, 20, 8);
+
+    diagnosticsLabel = new QLabel("Diagnostics: not running", this);
+    diagnosticsLabel->setStyleSheet("font-family: monospace; font-size: 12px; color: #ecf0f1;");
+    diagnosticsPanelLayout->addWidget(diagnosticsLabel);
+
+    // --- Activity Chart ---
+    QFrame *chartPanel = new QFrame(centralWidget);
+    chartPanel->setStyleSheet("background-color: #F5F5F5;");
+    mainLayout->addWidget(chartPanel, 3, 0, 1, 2);
+
+    QVBoxLayout *chartPanelLayout = new QVBoxLayout(chartPanel);
+    chartPanelLayout->setContentsMargins(20, 6, 20, 10);
+    chartPanelLayout->setSpacing(4);
+
+    activityChartLabel = new QLabel("Events per second", this);
+    activityChartLabel->setStyleSheet("font-size: 12px; color: #555555;");
+    chartPanelLayout->addWidget(activityChartLabel);
+
+    activityChart = new ActivityChart(this);
+    activityChart->setFixedHeight(80);
+    chartPanelLayout->addWidget(activityChart);
+
+    // --- Per-device Breakdown ---
+    QFrame *devicesPanel = new QFrame(centralWidget);
+    devicesPanel->setStyleSheet("background-color: #F5F5F5;");
+    mainLayout->addWidget(devicesPanel, 4, 0, 1, 2);
+
+    QVBoxLayout *devicesPanelLayout = new QVBoxLayout(devicesPanel);
+    devicesPanelLayout->setContentsMargins(20, 0, 20, 10);
+
+    devicesTable = new QTableWidget(0, DEVICE_COLUMNS.size(), this);
+    devicesTable->setHorizontalHeaderLabels(DEVICE_COLUMNS);
+    devicesTable->verticalHeader()->setVisible(false);
+    devicesTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    devicesTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    devicesTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    devicesTable->setSelectionMode(QAbstractItemView::NoSelection);
+    devicesTable->setStyleSheet("font-size: 12px; background-color: white;");
+    devicesTable->setFixedHeight(150);
+    devicesPanelLayout->addWidget(devicesTable);
+
+    // Totals kept across sessions (--history)
+    historyLabel = new QLabel("History: off", this);
+    historyLabel->setStyleSheet("font-size: 12px; color: #555555;");
+    devicesPanelLayout->addWidget(historyLabel);
+
+
+
+
+
+    // Set up update timer (the session clock every second)
     updateTimer = new QTimer(this);
-    connect(updateTimer, &QTimer::timeout, this, &MainWindow::updateDashboard);
+    connect(updateTimer, &QTimer::timeout, this, &MainWindow::onClockTick);
+
+    // Counter redraws are coalesced to the display's refresh rate
+    qreal refreshRate = QGuiApplication::primaryScreen() ? QGuiApplication::primaryScreen()->refreshRate() : 60.0;
+    frameTimer = new QTimer(this);
+    frameTimer->setSingleShot(true);
+    frameTimer->setInterval(std::max(1, static_cast<int>(1000.0 / std::max<qreal>(refreshRate, 1.0))));
+    connect(frameTimer, &QTimer::timeout, this, &MainWindow::refreshCounters);
+
+    // Runs on an engine worker, once per change burst; just post to the GUI thread
+    engine.setChangeHandler([this]() {
+        QMetaObject::invokeMethod(this, "onEngineChanged", Qt::QueuedConnection);
+    });
 }
 
 MainWindow::~MainWindow()
@@ -147,12 +267,31 @@ MainWindow::~MainWindow()
     stopMonitoring();
 }
 
+void MainWindow::setEngineOptions(const EngineOptions& options)
+{
+    engine.setOptions(options);
+}
+
 void MainWindow::onToggleMonitoring()
 {
-    if (monitoring.load()) {
-        std::cout << "Stopping monitoring...\n";
-        stopMonitoring();
-        toggleMonitoringButton->setText("Start");
+    // Devices stay open from the first Start until the window closes;
+    // the button only pauses and resumes the session
+    if (!engine.isRunning()) {
+        std::cout << "Starting monitoring...\n";
+        startMonitoring();
+        if (!engine.isRunning()) {
+            return;
+        }
+        setPauseButtonStyle();
+    } else if (!engine.isPaused()) {
+        std::cout << "Pausing monitoring...\n";
+        engine.pause();
+        updateTimer->stop();
+        frameTimer->stop();
+        refreshCounters();
+        refreshPanels();
+        updateClock();
+        toggleMonitoringButton->setText("Resume");
         toggleMonitoringButton->setStyleSheet(
             "QPushButton {"
             "background-color: #2ecc71;"
@@ -166,277 +305,394 @@ void MainWindow::onToggleMonitoring()
             "}"
             );
     } else {
-        std::cout << "Starting monitoring...\n";
-        startMonitoring();
-        toggleMonitoringButton->setText("Stop");
-        toggleMonitoringButton->setStyleSheet(
-            "QPushButton {"
-            "background-color: #e74c3c;" // Red background for Stop
-            "color: white;"
-            "border-radius: 6px;"
-            "font-size: 20px;"
-            "font-weight: bold;"
-            "}"
-            "QPushButton:pressed {"
-            "background-color: #c0392b;" // Darker red when pressed
-            "}"
-            );
+        std::cout << "Resuming monitoring...\n";
+        engine.resume();
+        updateTimer->start(1000);
+        setPauseButtonStyle();
     }
 }
 
-void MainWindow::updateDashboard()
+void MainWindow::onMarkLap()
 {
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-
-    double distance_copy;
-    {
-        std::lock_guard<std::mutex> lock(mouse_distance_mutex);
-        distance_copy = mouse_distance;
+    if (!engine.isRunning()) {
+        return;
     }
-
-    keyboardCountLabel->setText(QString::number(keyboard_count.load()));
-    mouseCountLabel->setText(QString::number(mouse_count.load()));
-    scrollCountLabel->setText(QString::number(scroll_count.load()));
-    mouseDistanceLabel->setText(QString::number(static_cast<int>(distance_copy)));
-
-    long long hours = elapsed / 3600;
-    long long minutes = (elapsed % 3600) / 60;
-    long long seconds = elapsed % 60;
-    elapsedTimeLabel->setText(QString("%1 : %2 : %3")
-                                  .arg(hours, 2, 10, QChar('0'))
-                                  .arg(minutes, 2, 10, QChar('0'))
-                                  .arg(seconds, 2, 10, QChar('0')));
+    unsigned lap = engine.markLap();
+    std::cout << "Lap " << lap << " started\n";
+    updateLapsView();
+    updateHistoryView();
 }
 
-void MainWindow::startMonitoring()
+// The history only changes once a minute; query it no more often
+void MainWindow::updateHistoryView()
 {
-    std::cout << "=== Starting Input Device Monitor ===\n";
-
-    // Reset counters
-    keyboard_count = 0;
-    mouse_count = 0;
-    scroll_count = 0;
-    mouse_distance = 0.0;
-
-    // Set monitoring flag BEFORE starting threads
-    monitoring = true;
-    std::cout << "Monitoring flag set to: " << monitoring.load() << "\n";
-
-    QDir inputDir(DEVICE_DIR);
-    QStringList filters;
-    filters << "event*";
-    QStringList eventFiles = inputDir.entryList(filters, QDir::System | QDir::Files);
-
-    if (eventFiles.isEmpty()) {
-        std::cout << "No input devices found. Try running with sudo.\n";
-        monitoring = false;
-        QMessageBox::warning(this, "Warning", "No input devices found. Try running with sudo.");
-        toggleMonitoringButton->setText("Start");
-        toggleMonitoringButton->setStyleSheet(
-            "QPushButton {"
-            "background-color: #2ecc71;"
-            "color: white;"
-            "border-radius: 6px;"
-            "font-size: 20px;"
-            "font-weight: bold;"
-            "}"
-            "QPushButton:pressed {"
-            "background-color: #27ae60;"
-            "}"
-            );
+    int64_t now = QDateTime::currentSecsSinceEpoch();
+    if (!engine.hasHistory() || now / 60 == historyMinute) {
         return;
     }
-
-    int device_count = 0;
-    for (const QString &file : eventFiles) {
-        QString devicePath = inputDir.absoluteFilePath(file);
-        if (isKeyboardDevice(devicePath)) {
-            std::cout << "Starting thread for keyboard device: " << devicePath.toStdString() << "\n";
-            monitorThreads.emplace_back(&MainWindow::monitorDevice, this, devicePath.toStdString(), DeviceType::Keyboard);
-            device_count++;
-        } else if (isMouseDevice(devicePath)) {
-            std::cout << "Starting thread for mouse device: " << devicePath.toStdString() << "\n";
-            monitorThreads.emplace_back(&MainWindow::monitorDevice, this, devicePath.toStdString(), DeviceType::Mouse);
-            device_count++;
-        }
+    historyMinute = now / 60;
+
+    struct Window {
+        const char* name;
+        int64_t days;   // 0: since local midnight
+    };
+    const Window windows[] = {{"today", 0}, {"7 days", 7}, {"30 days", 30}};
+    QStringList parts;
+    for (const Window& window : windows) {
+        int64_t from = window.days ? now - window.days * 86400
+                                   : QDateTime(QDate::currentDate(), QTime(0, 0)).toSecsSinceEpoch();
+        RollupSummary summary = engine.history(from, now);
+        parts << QString("%1: %2 keys, %3 clicks, %4 active min")
+                     .arg(window.name)
+                     .arg(summary.totals.keyboard_count)
+                     .arg(summary.totals.mouse_count)
+                     .arg(summary.activeMinutes);
     }
+    setLabelText(historyLabel, "History  " + parts.join("  |  "));
+}
 
-    if (monitorThreads.empty()) {
-        std::cout << "No input devices found. Try running with sudo.\n";
-        monitoring = false;
-        QMessageBox::warning(this, "Warning", "No input devices found. Try running with sudo.");
-        toggleMonitoringButton->setText("Start");
-        toggleMonitoringButton->setStyleSheet(
-            "QPushButton {"
-            "background-color: #2ecc71;"
-            "color: white;"
-            "border-radius: 6px;"
-            "font-size: 20px;"
-            "font-weight: bold;"
-            "}"
-            "QPushButton:pressed {"
-            "background-color: #27ae60;"
-            "}"
-            );
+void MainWindow::onEngineChanged()
+{
+    // The first change of a burst arms one frame; later ones ride along.
+    // While minimized the change stays unconsumed, so producers stop
+    // posting until the window is restored.
+    if (isMinimized()) {
         return;
     }
-
-    std::cout << "Started " << device_count << " monitoring thread(s).\n";
-
-    // Start timer
-    start_time = std::chrono::steady_clock::now();
-    updateTimer->start(1000); // Update UI every second
+    if (!frameTimer->isActive()) {
+        frameTimer->start();
+    }
 }
 
-void MainWindow::stopMonitoring()
+void MainWindow::refreshCounters()
 {
-    std::cout << "=== Stopping Monitor ===\n";
+    // Re-arm before reading so a change made meanwhile is not lost
+    engine.consumeChanges();
+    StatsSnapshot totals = engine.snapshot().totals;
 
-    // Set the flag to stop monitoring threads
-    monitoring = false;
-    std::cout << "Monitoring flag set to: " << monitoring.load() << "\n";
+    if (totals.keyboard_count != shownTotals.keyboard_count) {
+        keyboardCountLabel->setText(QString::number(totals.keyboard_count));
+    }
+    if (totals.mouse_count != shownTotals.mouse_count) {
+        mouseCountLabel->setText(QString::number(totals.mouse_count));
+    }
+    if (totals.scroll_count != shownTotals.scroll_count) {
+        scrollCountLabel->setText(QString::number(totals.scroll_count));
+    }
+    if (static_cast<qulonglong>(totals.mouse_distance) != static_cast<qulonglong>(shownTotals.mouse_distance)) {
+        mouseDistanceLabel->setText(QString::number(static_cast<qulonglong>(totals.mouse_distance)));
+    }
+    shownTotals = totals;
 
-    // Stop update timer
-    updateTimer->stop();
+    // The panels hold per-second figures; a busy second refreshes them once
+    // and the clock tick picks up whatever came after
+    if (currentSecond() != panelSecond) {
+        refreshPanels();
+    } else {
+        panelsStale = true;
+    }
+}
 
-    // Join threads
-    for (auto& t : monitorThreads) {
-        if (t.joinable()) {
-            t.join();
-        }
+void MainWindow::onClockTick()
+{
+    updateClock();
+    // Input that arrived after this second's refresh, and the last minute's
+    // rates running down to zero once input stops
+    if (panelsStale || !shownMinute.empty()) {
+        refreshPanels();
     }
-    monitorThreads.clear();
+}
 
-    // Final update and reset UI
-    updateDashboard();
-    elapsedTimeLabel->setText("00 : 00 : 00");
+void MainWindow::updateClock()
+{
+    long long elapsed = static_cast<long long>(engine.activeSeconds());
 
-    std::cout << "All monitoring threads stopped.\n";
+    long long hours = elapsed / 3600;
+    long long minutes = (elapsed % 3600) / 60;
+    long long seconds = elapsed % 60;
+    setLabelText(elapsedTimeLabel, QString("%1 : %2 : %3")
+                                       .arg(hours, 2, 10, QChar('0'))
+                                       .arg(minutes, 2, 10, QChar('0'))
+                                       .arg(seconds, 2, 10, QChar('0')));
 }
 
-bool MainWindow::isKeyboardDevice(const QString& devicePath) {
-    QFile file(devicePath);
-    int fd = open(devicePath.toStdString().c_str(), O_RDONLY | O_NONBLOCK);
-    if (fd < 0) {
-        std::cerr << "Failed to open device for keyboard check: " << devicePath.toStdString() << " - " << strerror(errno) << "\n";
-        return false;
+// Everything below the counters. Called on change, so an idle session costs
+// the clock label alone.
+void MainWindow::refreshPanels()
+{
+    panelSecond = currentSecond();
+    panelsStale = false;
+
+    updateRatesView();
+    // The per-key tables are large; only copied when keys were pressed or
+    // the words per minute are still falling
+    if (shownTotals.keyboard_count != typingKeys || shownMinute.keyboard_count != 0) {
+        typingKeys = shownTotals.keyboard_count;
+        updateTypingView();
     }
+    updateDiagnosticsView();
+    updateActivityChart();
+    updateDevicesView();
+    updateHeatmapView();
+    updateLapsView();
+    updateHistoryView();
+}
 
-    libevdev* dev = nullptr;
-    int rc = libevdev_new_from_fd(fd, &dev);
-    if (rc < 0) {
-        std::cerr << "libevdev init failed for keyboard check: " << devicePath.toStdString() << " - " << strerror(-rc) << "\n";
-        ::close(fd);
-        return false;
-    }
+// Activity over the last 60 seconds, and the last hour for context
+void MainWindow::updateRatesView()
+{
+    RateSnapshot rates = engine.rates();
+    StatsSnapshot minute = rates.lastMinute();
+    StatsSnapshot hour = rates.lastHour();
+    setLabelText(keyboardRateLabel, QString("%1 /min | %2 /h").arg(minute.keyboard_count).arg(hour.keyboard_count));
+    setLabelText(mouseRateLabel, QString("%1 /min | %2 /h").arg(minute.mouse_count).arg(hour.mouse_count));
+    setLabelText(scrollRateLabel, QString("%1 /min | %2 /h").arg(minute.scroll_count).arg(hour.scroll_count));
+    setLabelText(distanceRateLabel, QString("%1 /min | %2 /h")
+                                        .arg(static_cast<qulonglong>(minute.mouse_distance))
+                                        .arg(static_cast<qulonglong>(hour.mouse_distance)));
+    shownMinute = minute;
+}
 
-    bool is_keyboard = libevdev_has_event_type(dev, EV_KEY) &&
-                       (libevdev_has_event_code(dev, EV_KEY, KEY_A) ||
-                        libevdev_has_event_code(dev, EV_KEY, KEY_SPACE) ||
-                        libevdev_has_event_code(dev, EV_KEY, KEY_ENTER));
+// Labels are only touched when their text differs, so an unchanged panel
+// neither relayouts nor repaints
+void MainWindow::setLabelText(QLabel *label, const QString& text)
+{
+    if (label->text() != text) {
+        label->setText(text);
+    }
+}
 
-    libevdev_free(dev);
-    ::close(fd);
+// The last few laps, newest at the bottom
+void MainWindow::updateLapsView()
+{
+    std::vector<LapRecord> laps = engine.laps();
+    if (laps.size() <= 1) {
+        setLabelText(lapsLabel, "No laps");
+        return;
+    }
+    constexpr std::size_t SHOWN_LAPS = 3;
+    QStringList lines;
+    for (std::size_t i = laps.size() > SHOWN_LAPS ? laps.size() - SHOWN_LAPS : 0; i < laps.size(); ++i) {
+        const LapRecord& lap = laps[i];
+        long long seconds = static_cast<long long>(lap.seconds);
+        lines << QString("%1 Lap %2  %3:%4:%5  %6 keys  %7 clicks")
+                     .arg(lap.current ? ">" : " ")
+                     .arg(lap.number)
+                     .arg(seconds / 3600, 2, 10, QChar('0'))
+                     .arg((seconds % 3600) / 60, 2, 10, QChar('0'))
+                     .arg(seconds % 60, 2, 10, QChar('0'))
+                     .arg(lap.counts.keyboard_count)
+                     .arg(lap.counts.mouse_count);
+    }
+    setLabelText(lapsLabel, lines.join("\n"));
+}
 
-    return is_keyboard;
+// Adds one column per second completed since the last call. Seconds missed
+// while the window was minimized are taken from the engine's rate ring.
+void MainWindow::updateActivityChart()
+{
+    int64_t now = currentSecond();
+    if (now <= chartSecond + 1) {
+        return;
+    }
+    RateSnapshot rates = engine.rates();
+    int64_t first = std::max(chartSecond + 1, now - static_cast<int64_t>(SECOND_BUCKETS) + 1);
+    for (int64_t second = first; second < now; ++second) {
+        activityChart->appendSample(static_cast<double>(rates.seconds[now - second].event_count));
+    }
+    chartSecond = now - 1;
+    setLabelText(activityChartLabel,
+                 QString("Events per second (scale %1)").arg(activityChart->scale(), 0, 'f', 0));
 }
 
-bool MainWindow::isMouseDevice(const QString& devicePath) {
-    QFile file(devicePath);
-    int fd = open(devicePath.toStdString().c_str(), O_RDONLY | O_NONBLOCK);
-    if (fd < 0) {
-        std::cerr << "Failed to open device for mouse check: " << devicePath.toStdString() << " - " << strerror(errno) << "\n";
-        return false;
+// No ticks at all while minimized; the chart catches up when shown again
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange && engine.isRunning() && !engine.isPaused()) {
+        if (isMinimized()) {
+            updateTimer->stop();
+        } else if (!updateTimer->isActive()) {
+            updateClock();
+            refreshCounters();
+            refreshPanels();
+            updateTimer->start(1000);
+        }
     }
+}
 
-    libevdev* dev = nullptr;
-    int rc = libevdev_new_from_fd(fd, &dev);
-    if (rc < 0) {
-        std::cerr << "libevdev init failed for mouse check: " << devicePath.toStdString() << " - " << strerror(-rc) << "\n";
-        ::close(fd);
-        return false;
+void MainWindow::updateDiagnosticsView()
+{
+    EngineDiagnostics diagnostics = engine.diagnostics();
+
+    QStringList lines;
+    lines << QString("Tracker CPU %1 s (%2%)   wakeups %3/s   latency p50 %4 us  p99 %5 us  max %6 us")
+                 .arg(diagnostics.cpuSeconds, 0, 'f', 2)
+                 .arg(diagnostics.cpuPercent, 0, 'f', 3)
+                 .arg(diagnostics.wakeupsPerSecond, 0, 'f', 1)
+                 .arg(diagnostics.latency.p50, 0, 'f', 0)
+                 .arg(diagnostics.latency.p99, 0, 'f', 0)
+                 .arg(diagnostics.latency.max, 0, 'f', 0);
+    for (const DeviceDiagnostics& device : diagnostics.devices) {
+        lines << QString("  %1  p50 %2 us  p99 %3 us  max %4 us")
+                     .arg(QString::fromStdString(device.name).left(36), -36)
+                     .arg(device.latency.p50, 6, 'f', 0)
+                     .arg(device.latency.p99, 6, 'f', 0)
+                     .arg(device.latency.max, 6, 'f', 0);
     }
+    setLabelText(diagnosticsLabel, lines.join("\n"));
+}
 
-    bool has_mouse_buttons = libevdev_has_event_type(dev, EV_KEY) &&
-                             (libevdev_has_event_code(dev, EV_KEY, BTN_LEFT) ||
-                              libevdev_has_event_code(dev, EV_KEY, BTN_RIGHT) ||
-                              libevdev_has_event_code(dev, EV_KEY, BTN_MIDDLE));
+// One row per device seen this session; unplugged ones are greyed out
+void MainWindow::updateDevicesView()
+{
+    std::vector<DeviceStats> devices = engine.deviceStats();
+    devicesTable->setRowCount(static_cast<int>(devices.size()));
+
+    auto seen = [](int64_t when) {
+        return when != 0 ? QDateTime::fromSecsSinceEpoch(when).toString("HH:mm:ss") : QString("-");
+    };
+    for (int row = 0; row < static_cast<int>(devices.size()); ++row) {
+        const DeviceStats& device = devices[row];
+        const QStringList cells = {
+            QString::number(device.id),
+            QString::fromStdString(device.label.name),
+            QString("%1:%2:%3")
+                .arg(device.label.bustype, 4, 16, QChar('0'))
+                .arg(device.label.vendor, 4, 16, QChar('0'))
+                .arg(device.label.product, 4, 16, QChar('0')),
+            QString::number(device.counts.keyboard_count),
+            QString::number(device.counts.mouse_count),
+            QString::number(device.counts.scroll_count),
+            QString::number(static_cast<qulonglong>(device.counts.mouse_distance)),
+            seen(device.firstSeen),
+            seen(device.lastSeen),
+        };
+        for (int column = 0; column < cells.size(); ++column) {
+            QTableWidgetItem *item = devicesTable->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem;
+                devicesTable->setItem(row, column, item);
+            }
+            if (item->text() != cells[column]) {
+                item->setText(cells[column]);
+            }
+            item->setForeground(device.attached ? QColor(Qt::black) : QColor(Qt::gray));
+        }
+    }
+}
 
-    bool has_scroll = libevdev_has_event_type(dev, EV_REL) &&
-                      libevdev_has_event_code(dev, EV_REL, REL_WHEEL);
+void MainWindow::onShowHeatmaps()
+{
+    if (!heatmapWindow) {
+        heatmapWindow = new QWidget(this, Qt::Window);
+        heatmapWindow->setWindowTitle("KnM_Tracker - Heatmaps");
+        QVBoxLayout *layout = new QVBoxLayout(heatmapWindow);
+
+        QLabel *movesLabel = new QLabel("Cursor position", heatmapWindow);
+        layout->addWidget(movesLabel);
+        movesView = new HeatmapView(heatmapWindow);
+        movesView->setMinimumSize(480, 270);
+        layout->addWidget(movesView, 1);
+
+        QLabel *clicksLabel = new QLabel("Clicks", heatmapWindow);
+        layout->addWidget(clicksLabel);
+        clicksView = new HeatmapView(heatmapWindow);
+        clicksView->setMinimumSize(480, 270);
+        layout->addWidget(clicksView, 1);
+    }
+    heatmapWindow->show();
+    heatmapWindow->raise();
+    updateHeatmapView();
+}
 
-    bool has_motion = libevdev_has_event_type(dev, EV_REL) &&
-                      (libevdev_has_event_code(dev, EV_REL, REL_X) ||
-                       libevdev_has_event_code(dev, EV_REL, REL_Y));
+// Only while the heatmap window is open; each view reads the pyramid level
+// that matches its size
+void MainWindow::updateHeatmapView()
+{
+    if (!heatmapWindow || !heatmapWindow->isVisible()) {
+        return;
+    }
+    movesView->setGrid(engine.heatmap(HeatmapKind::Movement, heatmapLevelFor(movesView->preferredCells())));
+    clicksView->setGrid(engine.heatmap(HeatmapKind::Clicks, heatmapLevelFor(clicksView->preferredCells())));
+}
 
-    libevdev_free(dev);
-    ::close(fd);
+void MainWindow::updateTypingView()
+{
+    TypingSnapshot typing = engine.typingSnapshot();
 
-    bool is_mouse = has_mouse_buttons || has_scroll || has_motion;
+    setLabelText(wpmLabel, QString("%1 WPM").arg(typing.wordsPerMinute(), 0, 'f', 0));
 
-    return is_mouse;
+    QStringList keys;
+    for (const KeyCount& key : typing.topKeys(TOP_KEYS_SHOWN)) {
+        keys << QString("%1 %2").arg(QString::fromStdString(keyName(key.code))).arg(key.count);
+    }
+    QStringList pairs;
+    for (const BigramCount& pair : typing.topBigrams(TOP_BIGRAMS_SHOWN)) {
+        pairs << QString("%1-%2 %3")
+                     .arg(QString::fromStdString(keyName(pair.first)))
+                     .arg(QString::fromStdString(keyName(pair.second)))
+                     .arg(pair.count);
+    }
+    setLabelText(topKeysLabel, QString("Top keys: %1\nTop pairs: %2\nMedian interval: %3 ms")
+                                   .arg(keys.isEmpty() ? QString("-") : keys.join("  "))
+                                   .arg(pairs.isEmpty() ? QString("-") : pairs.join("  "))
+                                   .arg(typing.medianIntervalMs(), 0, 'f', 0));
 }
 
-void MainWindow::monitorDevice(const std::string& path, DeviceType type) {
-    std::cout << "[thread] Attempting to open: " << path << "\n";
+void MainWindow::setPauseButtonStyle()
+{
+    toggleMonitoringButton->setText("Pause");
+    toggleMonitoringButton->setStyleSheet(
+        "QPushButton {"
+        "background-color: #e67e22;" // Orange background for Pause
+        "color: white;"
+        "border-radius: 6px;"
+        "font-size: 20px;"
+        "font-weight: bold;"
+        "}"
+        "QPushButton:pressed {"
+        "background-color: #d35400;"
+        "}"
+        );
+}
 
-    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
-    if (fd < 0) {
-        std::cerr << "[thread] Failed to open " << path << ": " << strerror(errno) << "\n";
+void MainWindow::startMonitoring()
+{
+    if (!engine.start()) {
+        QMessageBox::warning(this, "Warning", "No input devices found. Try running with sudo.");
         return;
     }
 
-    libevdev* dev = nullptr;
-    int rc = libevdev_new_from_fd(fd, &dev);
-    if (rc < 0) {
-        std::cerr << "[thread] libevdev init failed for " << path << ": " << strerror(-rc) << "\n";
-        ::close(fd);
-        return;
-    }
+    // Counters restart from zero
+    shownTotals = StatsSnapshot();
+    keyboardCountLabel->setText("0");
+    mouseCountLabel->setText("0");
+    scrollCountLabel->setText("0");
+    mouseDistanceLabel->setText("0");
+    chartSecond = currentSecond();
+    activityChart->clear();
+    panelSecond = 0;
+    typingKeys = 0;
+    shownMinute = StatsSnapshot();
+    refreshCounters();
+    historyMinute = 0;
+    updateHistoryView();
 
-    const char* name = libevdev_get_name(dev) ? libevdev_get_name(dev) : "(unknown)";
-    std::cout << "[thread] Successfully monitoring " << path << " -> " << name << "\n";
+    // Start timer
+    updateTimer->start(1000); // Update UI every second
+}
 
-    while (monitoring.load()) {
-        input_event ev;
-        rc = libevdev_next_event(dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
-        if (rc == LIBEVDEV_READ_STATUS_SUCCESS) {
-            if (type == DeviceType::Keyboard && ev.type == EV_KEY && ev.value == 1) {
-                keyboard_count.fetch_add(1);
-                std::cout << "[keyboard] Key press detected on " << name << "\n";
-            }
-            if (type == DeviceType::Mouse && ev.type == EV_KEY && ev.value == 1) {
-                if (ev.code == BTN_LEFT || ev.code == BTN_RIGHT || ev.code == BTN_MIDDLE) {
-                    mouse_count.fetch_add(1);
-                    std::cout << "[mouse] Button click detected on " << name << "\n";
-                }
-            }
-            if (type == DeviceType::Mouse && ev.type == EV_REL) {
-                if (ev.code == REL_WHEEL || ev.code == REL_HWHEEL) {
-                    scroll_count.fetch_add(std::abs(ev.value));
-                    std::cout << "[mouse] Scroll detected on " << name << ": " << ev.value << "\n";
-                } else if (ev.code == REL_X) {
-                    std::lock_guard<std::mutex> lock(mouse_distance_mutex);
-                    mouse_distance += std::abs(static_cast<double>(ev.value));
-                    std::cout << "[mouse] Movement X detected on " << name << ": " << ev.value << "\n";
-                } else if (ev.code == REL_Y) {
-                    std::lock_guard<std::mutex> lock(mouse_distance_mutex);
-                    mouse_distance += std::abs(static_cast<double>(ev.value));
-                    std::cout << "[mouse] Movement Y detected on " << name << ": " << ev.value << "\n";
-                }
-            }
-        } else if (rc == -EAGAIN) {
-            usleep(SLEEP_MICROSECONDS);
-        } else if (rc == LIBEVDEV_READ_STATUS_SYNC) {
-            continue;
-        } else if (rc != LIBEVDEV_READ_STATUS_SUCCESS) {
-            std::cerr << "[thread] Read error on " << path << ": " << strerror(-rc) << "\n";
-            break;
-        }
-    }
+void MainWindow::stopMonitoring()
+{
+    // Stop update timers
+    updateTimer->stop();
+    frameTimer->stop();
 
-    std::cout << "[thread] Exiting monitor for " << name << "\n";
-    libevdev_free(dev);
-    ::close(fd);
+    engine.stop();
+
+    // Final update and reset UI
+    refreshCounters();
+    refreshPanels();
+    setLabelText(elapsedTimeLabel, "00 : 00 : 00");
 }
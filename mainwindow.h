@@ -5,13 +5,13 @@
 #include <QTimer>
 #include <QLabel>
 #include <QPushButton>
-#include <atomic>
-#include <mutex>
-#include <vector>
-#include <thread>
-#include <chrono>
+#include <QTableWidget>
 #include <string>
 
+#include "trackerengine.h"
+#include "activitychart.h"
+#include "heatmapview.h"
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -20,9 +20,19 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Recording and export settings used by the next start
+    void setEngineOptions(const EngineOptions& options);
+
+protected:
+    void changeEvent(QEvent *event) override;
+
 private slots:
     void onToggleMonitoring();
-    void updateDashboard();
+    void onShowHeatmaps();
+    void onMarkLap();
+    void onEngineChanged();
+    void refreshCounters();
+    void onClockTick();
 
 private:
     // UI Elements
@@ -30,35 +40,57 @@ private:
     QLabel *mouseCountLabel;
     QLabel *scrollCountLabel;
     QLabel *mouseDistanceLabel;
+    QLabel *keyboardRateLabel;
+    QLabel *mouseRateLabel;
+    QLabel *scrollRateLabel;
+    QLabel *distanceRateLabel;
     QLabel *elapsedTimeLabel;
+    QLabel *wpmLabel;
+    QLabel *topKeysLabel;
+    QLabel *diagnosticsLabel;
     QPushButton *toggleMonitoringButton;
-    QTimer *updateTimer;
+    ActivityChart *activityChart;
+    QLabel *activityChartLabel;
+    QTableWidget *devicesTable;
+    QLabel *historyLabel;
+    QPushButton *heatmapButton;
+    QPushButton *lapButton;
+    QLabel *lapsLabel;
+    QWidget *heatmapWindow = nullptr;   // created on first use
+    HeatmapView *movesView = nullptr;
+    HeatmapView *clicksView = nullptr;
 
-    // Monitoring state
-    std::atomic<bool> monitoring{false};
-
-    // Monitoring threads
-    std::vector<std::thread> monitorThreads;
-
-    // Shared data
-    std::atomic<int> keyboard_count{0};
-    std::atomic<int> mouse_count{0};
-    std::atomic<int> scroll_count{0};
-    double mouse_distance = 0.0;
-    std::mutex mouse_distance_mutex;
-    std::chrono::steady_clock::time_point start_time;
+    // Counters are redrawn when the engine reports a change, at most once
+    // per display frame, and the panels with them at most once a second.
+    // Only the clock ticks on its own, once a second while visible.
+    QTimer *frameTimer;
+    QTimer *updateTimer;
+    StatsSnapshot shownTotals;
+    StatsSnapshot shownMinute;  // last minute's rates as shown
+    int64_t panelSecond = 0;   // second the panels were last refreshed in
+    bool panelsStale = false;  // changed since, within that second
+    uint64_t typingKeys = 0;   // key count the typing panel was drawn at
+    int64_t chartSecond = 0;   // last second drawn into the chart
+    int64_t historyMinute = 0; // minute the history line was queried in
 
-    enum class DeviceType {
-        Keyboard,
-        Mouse
-    };
+    // Device discovery, reading and counting; the window only displays it
+    TrackerEngine engine;
 
     // Monitoring functions
     void startMonitoring();
     void stopMonitoring();
-    bool isKeyboardDevice(const QString& devicePath);
-    bool isMouseDevice(const QString& devicePath);
-    void monitorDevice(const std::string& path, DeviceType type);
+    void setPauseButtonStyle();
+    void updateClock();
+    void refreshPanels();
+    void updateRatesView();
+    static void setLabelText(QLabel *label, const QString& text);
+    void updateTypingView();
+    void updateDiagnosticsView();
+    void updateActivityChart();
+    void updateDevicesView();
+    void updateHeatmapView();
+    void updateLapsView();
+    void updateHistoryView();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,224 @@
+// Reads a running tracker's exported counters without touching the tracker:
+// from its shared-memory segment (TrackerDaemon/InputMonitor --shm) or from
+// its metrics socket (--metrics-socket). Also summarises the long-term
+// history a tracker keeps with --history.
+
+#include "rollupstore.h"
+#include "sharedstats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Local HH:MM:SS of a Unix time, "-" for 0
+std::string clockTime(uint64_t seconds)
+{
+    if (seconds == 0) {
+        return "-";
+    }
+    time_t when = static_cast<time_t>(seconds);
+    char text[32];
+    std::strftime(text, sizeof(text), "%H:%M:%S", std::localtime(&when));
+    return text;
+}
+
+void printValues(const SharedStatsValues& values)
+{
+    std::string when = clockTime(values.update_time_ns / 1000000000ULL);
+    std::printf("%s  pid %llu  %s  elapsed %.0f s  devices %llu\n", when.c_str(),
+                static_cast<unsigned long long>(values.pid), values.running ? "running" : "stopped",
+                values.elapsed_seconds, static_cast<unsigned long long>(values.devices));
+    std::printf("  total:       keys %llu  clicks %llu  scroll %llu  distance %.0f  events %llu\n",
+                static_cast<unsigned long long>(values.keyboard_count),
+                static_cast<unsigned long long>(values.mouse_count),
+                static_cast<unsigned long long>(values.scroll_count), values.mouse_distance,
+                static_cast<unsigned long long>(values.event_count));
+    if (values.stroke_count != 0 || values.gamepad_count != 0 || values.axis_count != 0) {
+        std::printf("               pen strokes %llu  gamepad presses %llu  axis reports %llu\n",
+                    static_cast<unsigned long long>(values.stroke_count),
+                    static_cast<unsigned long long>(values.gamepad_count),
+                    static_cast<unsigned long long>(values.axis_count));
+    }
+    std::printf("  last minute: keys %llu  clicks %llu  scroll %llu  distance %.0f  wpm %.0f\n",
+                static_cast<unsigned long long>(values.minute_keyboard_count),
+                static_cast<unsigned long long>(values.minute_mouse_count),
+                static_cast<unsigned long long>(values.minute_scroll_count), values.minute_mouse_distance,
+                values.words_per_minute);
+    std::printf("  tracker:     cpu %.2f s  wakeups %.1f/s  latency p50 %.0f us  p99 %.0f us  max %.0f us\n",
+                values.cpu_seconds, values.wakeups_per_second, values.latency_p50_us, values.latency_p99_us,
+                values.latency_max_us);
+    std::size_t rows = std::min<std::size_t>(values.breakdown_rows, SHARED_STATS_MAX_DEVICES);
+    for (std::size_t i = 0; i < rows; ++i) {
+        const SharedDeviceValues& device = values.breakdown[i];
+        std::printf("  [%2llu] %-32.*s %04llx:%04llx:%04llx  %s  first %s  last %s\n"
+                    "       keys %llu  clicks %llu  scroll %llu  distance %.0f  events %llu\n",
+                    static_cast<unsigned long long>(device.id), static_cast<int>(sizeof(device.name)), device.name,
+                    static_cast<unsigned long long>(device.bustype), static_cast<unsigned long long>(device.vendor),
+                    static_cast<unsigned long long>(device.product), device.attached ? "attached" : "gone    ",
+                    clockTime(device.first_seen).c_str(), clockTime(device.last_seen).c_str(),
+                    static_cast<unsigned long long>(device.keyboard_count),
+                    static_cast<unsigned long long>(device.mouse_count),
+                    static_cast<unsigned long long>(device.scroll_count), device.mouse_distance,
+                    static_cast<unsigned long long>(device.event_count));
+    }
+    std::fflush(stdout);
+}
+
+// Sends a plain HTTP request so the tracker answers at once, then prints
+// the body
+int fetchSocket(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return 1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Cannot connect to " << path << ": " << strerror(errno) << "\n";
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+    const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    if (send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) < 0) {
+        std::cerr << "Cannot send to " << path << ": " << strerror(errno) << "\n";
+        close(fd);
+        return 1;
+    }
+
+    std::string response;
+    char buffer[4096];
+    for (ssize_t n = recv(fd, buffer, sizeof(buffer), 0); n > 0; n = recv(fd, buffer, sizeof(buffer), 0)) {
+        response.append(buffer, static_cast<std::size_t>(n));
+    }
+    close(fd);
+
+    std::size_t body = response.find("\r\n\r\n");
+    std::fputs(body == std::string::npos ? response.c_str() : response.c_str() + body + 4, stdout);
+    return 0;
+}
+
+// Totals and rates of every series over the last day, week, month and year
+int printHistory(const std::string& directory)
+{
+    RollupOptions options;
+    options.directory = directory;
+    options.readOnly = true;
+    RollupStore store(options);
+    if (!store.open()) {
+        std::cerr << "No history in " << directory << " (start the tracker with --history).\n";
+        return 1;
+    }
+    struct Window {
+        const char* name;
+        int64_t days;
+    };
+    const Window windows[] = {{"day", 1}, {"week", 7}, {"month", 30}, {"year", 365}};
+    const int64_t now = static_cast<int64_t>(time(nullptr));
+    for (const RollupSeries& series : store.series()) {
+        std::printf("%s%s%s\n", series.name.c_str(), series.key.empty() ? "" : "  ", series.key.c_str());
+        for (const Window& window : windows) {
+            RollupSummary summary = store.query(now - window.days * 86400, now, series.key);
+            std::printf("  last %-5s  keys %llu  clicks %llu  scroll %llu  distance %.0f  active %llu min"
+                        "  keys/active min %.1f\n",
+                        window.name, static_cast<unsigned long long>(summary.totals.keyboard_count),
+                        static_cast<unsigned long long>(summary.totals.mouse_count),
+                        static_cast<unsigned long long>(summary.totals.scroll_count), summary.totals.mouse_distance,
+                        static_cast<unsigned long long>(summary.activeMinutes),
+                        summary.perActiveMinute(static_cast<double>(summary.totals.keyboard_count)));
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Segment: --name=<shm name> (default /knm_tracker)
+    // Output: human summary, or --prometheus for the metrics text
+    // Follow: --watch[=<ms>] prints again whenever the tracker publishes
+    // Socket instead of shared memory: --socket=<path>
+    // Long-term history instead: --history=<dir>
+    std::string name = SHARED_STATS_DEFAULT_NAME;
+    std::string socketPath;
+    std::string historyDirectory;
+    bool prometheus = false;
+    long watchMs = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--name=", 7) == 0) {
+            name = argv[i] + 7;
+        } else if (std::strcmp(argv[i], "--prometheus") == 0) {
+            prometheus = true;
+        } else if (std::strcmp(argv[i], "--watch") == 0) {
+            watchMs = 1000;
+        } else if (std::strncmp(argv[i], "--watch=", 8) == 0) {
+            watchMs = std::max(10L, std::strtol(argv[i] + 8, nullptr, 10));
+        } else if (std::strncmp(argv[i], "--socket=", 9) == 0) {
+            socketPath = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--history=", 10) == 0) {
+            historyDirectory = argv[i] + 10;
+        } else {
+            std::cerr << "usage: TrackerStat [--name=<shm name>] [--prometheus] [--watch[=<ms>]]\n"
+                         "       TrackerStat --socket=<path>\n"
+                         "       TrackerStat --history=<dir>\n";
+            return 2;
+        }
+    }
+
+    if (!socketPath.empty()) {
+        return fetchSocket(socketPath);
+    }
+    if (!historyDirectory.empty()) {
+        return printHistory(historyDirectory);
+    }
+
+    SharedStatsSegment segment;
+    if (!segment.open(name)) {
+        std::cerr << "No tracker statistics at " << name << " (start the tracker with --shm).\n";
+        return 1;
+    }
+    SharedStatsValues values;
+    uint64_t shown = 0;
+    for (;;) {
+        // Reading is a memory copy; only print publishes not yet shown
+        uint64_t generation = segment.generation();
+        if (generation != shown) {
+            SharedStatsRead result = segment.read(values);
+            if (result == SharedStatsRead::Incompatible) {
+                std::cerr << name << " is not a tracker statistics segment of this version.\n";
+                return 1;
+            }
+            if (result == SharedStatsRead::Stalled) {
+                std::cerr << "The tracker stopped in the middle of updating " << name
+                          << "; it has probably died.\n";
+                return 1;
+            }
+            if (prometheus) {
+                std::fputs(formatPrometheus(values).c_str(), stdout);
+                std::fflush(stdout);
+            } else {
+                printValues(values);
+            }
+            shown = generation;
+        }
+        if (watchMs == 0) {
+            return 0;
+        }
+        usleep(static_cast<useconds_t>(watchMs) * 1000);
+    }
+}